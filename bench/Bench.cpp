@@ -0,0 +1,446 @@
+#include "../src/Raytracer/Raytracer.h"
+#include "../src/Sampling/Random.h"
+#include "SphereSimd.h"
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Micro-benchmarks of the renderer's per-ray kernels on fixed-seed scenes and rays, written as JSON
+// so runs can be diffed across commits. Every kernel runs BENCH_REPETITIONS times over the same
+// inputs after one warm-up run, and the fastest run is reported.
+
+const int BENCH_RAYS = 1 << 16;
+const int BENCH_REPETITIONS = 7;
+const int BENCH_CANVAS_SIZE = 640;
+const int BENCH_RANDOM_SPHERES = 64;
+// Extra spheres and lights of the larger benchmark scenes
+const int BENCH_SCENE_SPHERES = 10000;
+const int BENCH_SCENE_LIGHTS = 200;
+// Squared length of a primary direction on the circle inscribed in the default 1 x 1 viewport at depth 1
+const float BENCH_INSCRIBED_LENGTH2 = 1.25f;
+
+struct BenchRay {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+struct ShadingInput {
+    glm::vec3 P;
+    glm::vec3 N;
+    glm::vec3 V;
+    float s;
+};
+
+// What a kernel run computed, summed so the work can't be optimized away and variants can be compared
+struct BenchTally {
+    double checksum = 0.0;
+    Uint64 hits = 0;
+};
+
+struct BenchResult {
+    std::string kernel;
+    std::string variant;
+    std::string scene;
+    std::string input;
+    Uint64 ops = 0;
+    Uint64 rays = 0;
+    double seconds = 0.0;
+    BenchTally tally;
+};
+
+struct BenchOptions {
+    std::string outputPath = "bench.json";
+    std::string filter;
+    int rays = BENCH_RAYS;
+};
+
+class BenchSuite {
+    private:
+        BenchOptions options;
+        std::vector<BenchResult> results;
+
+    public:
+        explicit BenchSuite(const BenchOptions& options) : options(options) {}
+
+        int RayCount() const { return options.rays; }
+        const std::vector<BenchResult>& Results() const { return results; }
+
+        // Times kernel(), which processes rays rays and performs ops operations per call
+        template <typename Kernel>
+        void Run(const char* kernel, const char* variant, const char* scene, const char* input, Uint64 ops, Uint64 rays, Kernel&& run) {
+            std::string name = std::string(kernel) + "/" + variant + "/" + scene + "/" + input;
+            if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+                return;
+            }
+
+            BenchResult result;
+            result.kernel = kernel;
+            result.variant = variant;
+            result.scene = scene;
+            result.input = input;
+            result.ops = ops;
+            result.rays = rays;
+            result.tally = run();
+            result.seconds = DBL_MAX;
+            for (int repetition = 0; repetition < BENCH_REPETITIONS; repetition++) {
+                auto start = FramePacer::Now();
+                BenchTally tally = run();
+                result.seconds = glm::min(result.seconds, FramePacer::SecondsSince(start));
+                if (tally.hits != result.tally.hits) {
+                    std::cout << "Warning: " << name << " is not deterministic" << std::endl;
+                }
+            }
+
+            std::cout << std::fixed << std::setprecision(2) << std::left << std::setw(58) << name << std::right
+                      << std::setw(10) << result.seconds * 1e9 / ops << " ns/op"
+                      << std::setw(10) << rays / result.seconds / 1e6 << " M rays/s"
+                      << std::setw(8) << 100.0 * result.tally.hits / rays << "% hit" << std::endl;
+            results.push_back(result);
+        }
+
+        bool WriteJson() const;
+};
+
+bool BenchSuite::WriteJson() const {
+    FILE* file = std::fopen(options.outputPath.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    std::fprintf(file, "{\n  \"repetitions\": %d,\n  \"rays\": %d,\n  \"benchmarks\": [\n", BENCH_REPETITIONS, options.rays);
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        std::fprintf(file,
+            "    {\"kernel\": \"%s\", \"variant\": \"%s\", \"scene\": \"%s\", \"input\": \"%s\", "
+            "\"ops\": %llu, \"ns_per_op\": %.3f, \"rays_per_sec\": %.0f, \"hit_rate\": %.4f, \"checksum\": %.6g}%s\n",
+            result.kernel.c_str(), result.variant.c_str(), result.scene.c_str(), result.input.c_str(),
+            (unsigned long long)result.ops, result.seconds * 1e9 / result.ops, result.rays / result.seconds,
+            (double)result.tally.hits / result.rays, result.tally.checksum, i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+    return std::fclose(file) == 0;
+}
+
+// A renderer set up headless with the default scene plus extra spheres and lights
+static std::unique_ptr<Raytracer> CreateScene(int extraSpheres, int extraLights, int lightSamples) {
+    Settings settings;
+    settings.headless = true;
+    settings.windowWidth = 64;
+    settings.windowHeight = 64;
+    settings.extraSpheres = extraSpheres;
+    settings.extraLights = extraLights;
+    settings.lightSamples = lightSamples;
+    auto raytracer = std::make_unique<Raytracer>();
+    raytracer->Initialize(settings);
+    raytracer->Setup();
+    return raytracer;
+}
+
+// Camera rays through random points of the canvas. filter 1 keeps only rays that hit the scene,
+// -1 only rays that miss it, 0 keeps every ray. Gives up (returning fewer rays) if the scene has
+// too few of the wanted kind.
+static std::vector<BenchRay> CameraRays(Raytracer& raytracer, int count, int filter, Uint32 seed) {
+    std::vector<BenchRay> rays;
+    rays.reserve(count);
+    Camera camera;
+    camera.Prepare(BENCH_CANVAS_SIZE, BENCH_CANVAS_SIZE);
+    Uint32 rngState = seed;
+    for (int attempt = 0; (int)rays.size() < count && attempt < count * 64; attempt++) {
+        float sX = RandomFloat(rngState) * BENCH_CANVAS_SIZE;
+        float sY = RandomFloat(rngState) * BENCH_CANVAS_SIZE;
+        BenchRay ray = {camera.Position(), camera.PrimaryDirection(sX, sY)};
+        if (filter != 0) {
+            float t;
+            bool hit = raytracer.ClosestSphere(ray.origin, ray.direction, 1.0f, FLT_MAX, t) >= 0;
+            if (hit != (filter > 0)) {
+                continue;
+            }
+        }
+        rays.push_back(ray);
+    }
+    return rays;
+}
+
+static std::vector<ShadingInput> ShadingInputs(Raytracer& raytracer, const std::vector<BenchRay>& rays) {
+    std::vector<ShadingInput> inputs;
+    inputs.reserve(rays.size());
+    for (const BenchRay& ray : rays) {
+        float t;
+        std::optional<Sphere> sphere;
+        raytracer.ClosestIntersection(ray.origin, ray.direction, 1.0f, FLT_MAX, t, sphere);
+        if (sphere) {
+            glm::vec3 P = ray.origin + t * ray.direction;
+            inputs.push_back({P, glm::normalize(P - sphere->center), -ray.direction, sphere->specular});
+        }
+    }
+    return inputs;
+}
+
+// Spheres scattered in front of the camera, apart from the scenes, for the single sphere kernels
+static std::vector<Sphere> RandomSpheres(int count, Uint32 seed) {
+    std::vector<Sphere> spheres;
+    Uint32 rngState = seed;
+    SDL_Color white = {255, 255, 255, 255};
+    for (int i = 0; i < count; i++) {
+        glm::vec3 center = glm::vec3(-4.0f + 8.0f * RandomFloat(rngState), -4.0f + 8.0f * RandomFloat(rngState), 4.0f + 8.0f * RandomFloat(rngState));
+        spheres.push_back(Sphere(center, 0.1f + 0.4f * RandomFloat(rngState), white));
+    }
+    return spheres;
+}
+
+// Rays from around the origin, aimed at a random sphere's center when aimed is set and in a random
+// forward direction otherwise
+static std::vector<BenchRay> RandomRays(const std::vector<Sphere>& spheres, int count, bool aimed, Uint32 seed) {
+    std::vector<BenchRay> rays(count);
+    Uint32 rngState = seed;
+    for (BenchRay& ray : rays) {
+        ray.origin = glm::vec3(RandomFloat(rngState), RandomFloat(rngState), RandomFloat(rngState)) - 0.5f;
+        glm::vec3 target = aimed
+            ? spheres[(size_t)(RandomFloat(rngState) * spheres.size())].center
+            : glm::vec3(-40.0f + 80.0f * RandomFloat(rngState), -40.0f + 80.0f * RandomFloat(rngState), 10.0f);
+        ray.direction = target - ray.origin;
+    }
+    return rays;
+}
+
+static void BenchIntersectRaySphere(BenchSuite& suite, Raytracer& raytracer) {
+    std::vector<Sphere> spheres = RandomSpheres(BENCH_RANDOM_SPHERES, 1);
+    std::vector<SpherePack> packs = PackSpheres(spheres);
+    const char* inputs[] = {"aimed", "random"};
+    for (int aimed = 1; aimed >= 0; aimed--) {
+        std::vector<BenchRay> rays = RandomRays(spheres, suite.RayCount(), aimed == 1, 2);
+        Uint64 ops = (Uint64)rays.size() * spheres.size();
+        suite.Run("intersect_ray_sphere", "scalar", "random64", inputs[1 - aimed], ops, rays.size(), [&] {
+            BenchTally tally;
+            for (const BenchRay& ray : rays) {
+                float closest = FLT_MAX;
+                for (const Sphere& sphere : spheres) {
+                    float t1, t2;
+                    raytracer.IntersectRaySphere(ray.origin, ray.direction, sphere, t1, t2);
+                    if (t1 > 0.0f && t1 < closest) {
+                        closest = t1;
+                    }
+                    if (t2 > 0.0f && t2 < closest) {
+                        closest = t2;
+                    }
+                }
+                if (closest < FLT_MAX) {
+                    tally.hits++;
+                    tally.checksum += closest;
+                }
+            }
+            return tally;
+        });
+        if (SPHERE_SIMD_AVAILABLE) {
+            suite.Run("intersect_ray_sphere", "sse2_x4", "random64", inputs[1 - aimed], ops, rays.size(), [&] {
+                BenchTally tally;
+                for (const BenchRay& ray : rays) {
+                    float closest = ClosestPacked(packs, ray.origin, ray.direction, 0.0f, FLT_MAX);
+                    if (closest < FLT_MAX) {
+                        tally.hits++;
+                        tally.checksum += closest;
+                    }
+                }
+                return tally;
+            });
+        }
+    }
+}
+
+static void BenchClosestIntersection(BenchSuite& suite, Raytracer& raytracer, const char* scene) {
+    const char* inputs[] = {"hits", "misses", "camera"};
+    int filters[] = {1, -1, 0};
+    for (int i = 0; i < 3; i++) {
+        std::vector<BenchRay> rays = CameraRays(raytracer, suite.RayCount(), filters[i], 3);
+        if (rays.empty()) {
+            continue;
+        }
+        suite.Run("closest_intersection", "scalar", scene, inputs[i], rays.size(), rays.size(), [&] {
+            BenchTally tally;
+            for (const BenchRay& ray : rays) {
+                float t;
+                std::optional<Sphere> sphere;
+                raytracer.ClosestIntersection(ray.origin, ray.direction, 1.0f, FLT_MAX, t, sphere);
+                if (sphere) {
+                    tally.hits++;
+                    tally.checksum += t;
+                }
+            }
+            return tally;
+        });
+    }
+}
+
+// Shadow rays from visible points toward random points of the region the scene's lights occupy
+static void BenchOccluded(BenchSuite& suite, Raytracer& raytracer, const char* scene) {
+    std::vector<ShadingInput> points = ShadingInputs(raytracer, CameraRays(raytracer, suite.RayCount(), 1, 4));
+    std::vector<BenchRay> rays(points.size());
+    Uint32 rngState = 5;
+    for (size_t i = 0; i < points.size(); i++) {
+        glm::vec3 target = glm::vec3(-6.0f + 12.0f * RandomFloat(rngState), 0.2f + 4.0f * RandomFloat(rngState), 10.0f * RandomFloat(rngState));
+        rays[i] = {points[i].P, target - points[i].P};
+    }
+    suite.Run("occluded", "scalar", scene, "shadow", rays.size(), rays.size(), [&] {
+        BenchTally tally;
+        for (const BenchRay& ray : rays) {
+            tally.hits += raytracer.Occluded(ray.origin, ray.direction, 0.001f, 1.0f);
+        }
+        return tally;
+    });
+}
+
+// The per-light reference loop against the batched kernels split by light type
+static void BenchComputeLighting(BenchSuite& suite, Raytracer& raytracer, const char* scene, bool reference) {
+    std::vector<ShadingInput> points = ShadingInputs(raytracer, CameraRays(raytracer, suite.RayCount(), 1, 6));
+    if (reference) {
+        suite.Run("compute_lighting", "reference", scene, "camera_hits", points.size(), points.size(), [&] {
+            BenchTally tally;
+            for (const ShadingInput& point : points) {
+                float intensity = raytracer.ComputeLightingReference(point.P, point.N, point.V, point.s);
+                tally.checksum += intensity;
+                tally.hits += intensity > 0.0f;
+            }
+            return tally;
+        });
+    }
+    suite.Run("compute_lighting", "batched", scene, "camera_hits", points.size(), points.size(), [&] {
+        BenchTally tally;
+        for (size_t k = 0; k < points.size(); k++) {
+            RayContext context = {(Uint32)k, -1};
+            float intensity = raytracer.ComputeLighting(points[k].P, points[k].N, points[k].V, points[k].s, context);
+            tally.checksum += intensity;
+            tally.hits += intensity > 0.0f;
+        }
+        return tally;
+    });
+}
+
+// Primary ray directions of every pixel of the canvas: the per-pixel divisions the renderer used
+// before it had a camera, the camera's precomputed steps, and its packets for whole tiles. Hits are
+// the directions outside the circle inscribed in the viewport, which needs all three components, and
+// there is no checksum, whose serial sum would take longer than generating the rays.
+static void BenchPrimaryRays(BenchSuite& suite) {
+    const int size = BENCH_CANVAS_SIZE;
+    const Uint64 pixels = (Uint64)size * size;
+    Camera camera;
+    camera.Prepare(size, size);
+    suite.Run("primary_rays", "divide", "none", "canvas640", pixels, pixels, [&] {
+        BenchTally tally;
+        for (int sY = 0; sY < size; sY++) {
+            for (int sX = 0; sX < size; sX++) {
+                glm::vec3 direction((float)(sX - size / 2) * 1.0f / (float)size, (float)(size / 2 - sY) * 1.0f / (float)size, 1.0f);
+                tally.hits += glm::dot(direction, direction) > BENCH_INSCRIBED_LENGTH2;
+            }
+        }
+        return tally;
+    });
+    suite.Run("primary_rays", "camera", "none", "canvas640", pixels, pixels, [&] {
+        BenchTally tally;
+        for (int sY = 0; sY < size; sY++) {
+            for (int sX = 0; sX < size; sX++) {
+                glm::vec3 direction = camera.PrimaryDirection((float)sX, (float)sY);
+                tally.hits += glm::dot(direction, direction) > BENCH_INSCRIBED_LENGTH2;
+            }
+        }
+        return tally;
+    });
+    suite.Run("primary_rays", "camera_tile_x4", "none", "canvas640", pixels, pixels, [&] {
+        BenchTally tally;
+        RayPacket packets[TILE_SIZE * TILE_SIZE / RAY_PACKET_WIDTH];
+        for (int y0 = 0; y0 < size; y0 += TILE_SIZE) {
+            for (int x0 = 0; x0 < size; x0 += TILE_SIZE) {
+                int count = camera.GenerateTile(x0, y0, TILE_SIZE, TILE_SIZE, packets) * TILE_SIZE;
+                for (int i = 0; i < count; i++) {
+                    for (int lane = 0; lane < RAY_PACKET_WIDTH; lane++) {
+                        glm::vec3 direction = packets[i].Direction(lane);
+                        tally.hits += glm::dot(direction, direction) > BENCH_INSCRIBED_LENGTH2;
+                    }
+                }
+            }
+        }
+        return tally;
+    });
+}
+
+static void BenchReflectRay(BenchSuite& suite, Raytracer& raytracer) {
+    std::vector<BenchRay> pairs(suite.RayCount());
+    Uint32 rngState = 7;
+    for (BenchRay& pair : pairs) {
+        pair.origin = glm::normalize(glm::vec3(RandomFloat(rngState), RandomFloat(rngState), RandomFloat(rngState)) - 0.5f);
+        pair.direction = glm::vec3(RandomFloat(rngState), RandomFloat(rngState), RandomFloat(rngState)) - 0.5f;
+    }
+    suite.Run("reflect_ray", "scalar", "none", "random", pairs.size(), pairs.size(), [&] {
+        BenchTally tally;
+        for (const BenchRay& pair : pairs) {
+            glm::vec3 reflected = raytracer.ReflectRay(pair.direction, pair.origin);
+            tally.checksum += reflected.x + reflected.y + reflected.z;
+        }
+        tally.hits = pairs.size();
+        return tally;
+    });
+}
+
+static void PrintUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl
+              << "  --out FILE      JSON results file (default bench.json)" << std::endl
+              << "  --rays N        Rays or shading points per kernel run (default " << BENCH_RAYS << ")" << std::endl
+              << "  --filter TEXT   Only run benchmarks whose kernel/variant/scene/input name contains TEXT" << std::endl;
+}
+
+int main(int argc, char const* argv[]) {
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = value != nullptr;
+        if (ok && std::strcmp(argv[i], "--out") == 0) {
+            options.outputPath = value;
+        } else if (ok && std::strcmp(argv[i], "--rays") == 0) {
+            options.rays = std::atoi(value);
+            ok = options.rays > 0;
+        } else if (ok && std::strcmp(argv[i], "--filter") == 0) {
+            options.filter = value;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cout << "Invalid argument: " << argv[i] << std::endl;
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    BenchSuite suite(options);
+    std::unique_ptr<Raytracer> defaultScene = CreateScene(0, 0, 0);
+    BenchIntersectRaySphere(suite, *defaultScene);
+    BenchClosestIntersection(suite, *defaultScene, "default");
+    BenchOccluded(suite, *defaultScene, "default");
+    BenchComputeLighting(suite, *defaultScene, "default", true);
+    BenchReflectRay(suite, *defaultScene);
+    BenchPrimaryRays(suite);
+    defaultScene->Destroy();
+
+    std::unique_ptr<Raytracer> sphereScene = CreateScene(BENCH_SCENE_SPHERES, 0, 0);
+    BenchClosestIntersection(suite, *sphereScene, "spheres10k");
+    BenchOccluded(suite, *sphereScene, "spheres10k");
+    sphereScene->Destroy();
+
+    // Every light evaluated, so the reference loop computes the same sum, then sampled through the light tree
+    std::unique_ptr<Raytracer> lightScene = CreateScene(0, BENCH_SCENE_LIGHTS, 0);
+    BenchComputeLighting(suite, *lightScene, "lights200", true);
+    lightScene->Destroy();
+    std::unique_ptr<Raytracer> sampledScene = CreateScene(0, BENCH_SCENE_LIGHTS, 4);
+    BenchComputeLighting(suite, *sampledScene, "lights200_sampled", false);
+    sampledScene->Destroy();
+
+    if (!suite.WriteJson()) {
+        std::cout << "Failed to write " << options.outputPath << std::endl;
+        return 1;
+    }
+    std::cout << suite.Results().size() << " results written to " << options.outputPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef SPHERESIMD_H
+#define SPHERESIMD_H
+
+#include "../src/Scene/Sphere.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Candidate SIMD kernel measured against Sphere::Intersect: one ray against four spheres at a time,
+// stored as structure of arrays. The arithmetic mirrors Sphere::Intersect operation for operation,
+// so both find exactly the same hits.
+struct SpherePack {
+    float centerX[4];
+    float centerY[4];
+    float centerZ[4];
+    float radiusSquared[4];
+};
+
+// Packs spheres four at a time, padding the last pack with spheres no ray can hit
+inline std::vector<SpherePack> PackSpheres(const std::vector<Sphere>& spheres) {
+    std::vector<SpherePack> packs((spheres.size() + 3) / 4);
+    for (size_t i = 0; i < packs.size() * 4; i++) {
+        SpherePack& pack = packs[i / 4];
+        int lane = (int)(i % 4);
+        bool used = i < spheres.size();
+        pack.centerX[lane] = used ? spheres[i].center.x : 0.0f;
+        pack.centerY[lane] = used ? spheres[i].center.y : 0.0f;
+        pack.centerZ[lane] = used ? spheres[i].center.z : 0.0f;
+        pack.radiusSquared[lane] = used ? spheres[i].radius * spheres[i].radius : -1.0f;
+    }
+    return packs;
+}
+
+#if defined(__SSE2__)
+const bool SPHERE_SIMD_AVAILABLE = true;
+
+// Closest intersection distance within (tMin, tMax) over all packs, tMax if nothing is hit
+inline float ClosestPacked(const std::vector<SpherePack>& packs, glm::vec3 O, glm::vec3 D, float tMin, float tMax) {
+    __m128 ox = _mm_set1_ps(O.x);
+    __m128 oy = _mm_set1_ps(O.y);
+    __m128 oz = _mm_set1_ps(O.z);
+    __m128 dx = _mm_set1_ps(D.x);
+    __m128 dy = _mm_set1_ps(D.y);
+    __m128 dz = _mm_set1_ps(D.z);
+    float a = glm::dot(D, D);
+    __m128 fourA = _mm_set1_ps(4.0f * a);
+    __m128 twoA = _mm_set1_ps(2.0f * a);
+    __m128 lower = _mm_set1_ps(tMin);
+    __m128 closest = _mm_set1_ps(tMax);
+    __m128 zero = _mm_setzero_ps();
+    __m128 two = _mm_set1_ps(2.0f);
+
+    for (const SpherePack& pack : packs) {
+        __m128 cox = _mm_sub_ps(ox, _mm_loadu_ps(pack.centerX));
+        __m128 coy = _mm_sub_ps(oy, _mm_loadu_ps(pack.centerY));
+        __m128 coz = _mm_sub_ps(oz, _mm_loadu_ps(pack.centerZ));
+        __m128 b = _mm_mul_ps(two, _mm_add_ps(_mm_add_ps(_mm_mul_ps(cox, dx), _mm_mul_ps(coy, dy)), _mm_mul_ps(coz, dz)));
+        __m128 coco = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cox, cox), _mm_mul_ps(coy, coy)), _mm_mul_ps(coz, coz));
+        __m128 c = _mm_sub_ps(coco, _mm_loadu_ps(pack.radiusSquared));
+        __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(fourA, c));
+        __m128 hit = _mm_cmpge_ps(discriminant, zero);
+        __m128 root = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+        __m128 minusB = _mm_sub_ps(zero, b);
+        __m128 t1 = _mm_div_ps(_mm_add_ps(minusB, root), twoA);
+        __m128 t2 = _mm_div_ps(_mm_sub_ps(minusB, root), twoA);
+        // A root counts when it lies within (tMin, closest), like the scalar loop's comparisons
+        __m128 valid1 = _mm_and_ps(hit, _mm_and_ps(_mm_cmpgt_ps(t1, lower), _mm_cmplt_ps(t1, closest)));
+        closest = _mm_or_ps(_mm_and_ps(valid1, t1), _mm_andnot_ps(valid1, closest));
+        __m128 valid2 = _mm_and_ps(hit, _mm_and_ps(_mm_cmpgt_ps(t2, lower), _mm_cmplt_ps(t2, closest)));
+        closest = _mm_or_ps(_mm_and_ps(valid2, t2), _mm_andnot_ps(valid2, closest));
+    }
+
+    closest = _mm_min_ps(closest, _mm_shuffle_ps(closest, closest, _MM_SHUFFLE(2, 3, 0, 1)));
+    closest = _mm_min_ps(closest, _mm_shuffle_ps(closest, closest, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(closest);
+}
+#else
+const bool SPHERE_SIMD_AVAILABLE = false;
+
+inline float ClosestPacked(const std::vector<SpherePack>&, glm::vec3, glm::vec3, float, float tMax) {
+    return tMax;
+}
+#endif
+
+#endif
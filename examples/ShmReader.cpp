@@ -0,0 +1,127 @@
+#include "../src/Output/SharedFrameRing.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal consumer of the renderer's --shm frames: waits for the segment, then reads the newest frame
+// in place whenever there is one, as a compositor would, and reports how long frames took to arrive.
+// Build with make shm-reader, then run ./raytracer --shm raytracer and ./raytracer_shm_reader raytracer.
+
+const int READER_FRAMES = 300;
+const int READER_POLL_US = 100;
+const int READER_OPEN_TIMEOUT_S = 10;
+
+static double Percentile(std::vector<double> values, double percentile) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = (size_t)(percentile / 100.0 * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// Stands in for real work on the frame: the average of its R, G and B bytes, read straight from the mapping
+static double MeanBrightness(const SharedFrameView& view) {
+    uint64_t sum = 0;
+    size_t count = (size_t)view.width * view.height;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t pixel = view.pixels[i];
+        sum += ((pixel >> 16) & 0xFF) + ((pixel >> 8) & 0xFF) + (pixel & 0xFF);
+    }
+    return (double)sum / (3.0 * count);
+}
+
+int main(int argc, char const* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " NAME [--frames N] [--poll-us N]" << std::endl
+                  << "  --frames N   Frames to read before exiting, or until the renderer exits (default " << READER_FRAMES << ")" << std::endl
+                  << "  --poll-us N  Sleep between checks for a new frame, 0 to spin (default " << READER_POLL_US << ")" << std::endl;
+        return 1;
+    }
+    std::string name = argv[1];
+    int frameLimit = READER_FRAMES;
+    int pollMicroseconds = READER_POLL_US;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--frames") == 0) {
+            frameLimit = std::atoi(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--poll-us") == 0) {
+            pollMicroseconds = std::atoi(argv[i + 1]);
+        } else {
+            std::cout << "Invalid argument: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    SharedFrameReader reader;
+    std::string error;
+    auto openStart = std::chrono::steady_clock::now();
+    while (!reader.Open(name, error)) {
+        if (std::chrono::steady_clock::now() - openStart > std::chrono::seconds(READER_OPEN_TIMEOUT_S)) {
+            std::cout << error << std::endl;
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::cout << "Reading " << reader.Width() << "x" << reader.Height() << " frames from a ring of "
+              << reader.SlotCount() << std::endl;
+
+    std::vector<double> latencies;
+    std::vector<double> readTimes;
+    uint64_t lastSeen = 0;
+    uint64_t skipped = 0;
+    int torn = 0;
+    double brightness = 0.0;
+    uint64_t lastFrame = 0;
+    while ((int)latencies.size() < frameLimit) {
+        SharedFrameView view;
+        if (!reader.Acquire(lastSeen, view)) {
+            if (reader.Closed()) {
+                break;
+            }
+            if (pollMicroseconds > 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(pollMicroseconds));
+            } else {
+                std::this_thread::yield();
+            }
+            continue;
+        }
+        uint64_t seenNanos = SharedClockNanos();
+        double value = MeanBrightness(view);
+        double readMs = (SharedClockNanos() - seenNanos) / 1e6;
+        if (!reader.StillValid(view)) {
+            // Overwritten while being read, the next newest frame will do
+            torn++;
+            continue;
+        }
+        if (lastSeen > 0) {
+            skipped += view.ringSequence - lastSeen - 1;
+        }
+        lastSeen = view.ringSequence;
+        latencies.push_back((seenNanos - view.publishNanos) / 1e6);
+        readTimes.push_back(readMs);
+        brightness = value;
+        lastFrame = view.frame;
+    }
+
+    double latencySum = 0.0;
+    double readSum = 0.0;
+    for (size_t i = 0; i < latencies.size(); i++) {
+        latencySum += latencies[i];
+        readSum += readTimes[i];
+    }
+    size_t count = latencies.empty() ? 1 : latencies.size();
+    std::cout << std::fixed << std::setprecision(3)
+              << "Read " << latencies.size() << " frames, skipped " << skipped << " newer ones had replaced, "
+              << torn << " overwritten while reading" << std::endl
+              << "  publish to read latency ms avg " << latencySum / count << "  p50 " << Percentile(latencies, 50)
+              << "  p99 " << Percentile(latencies, 99) << "  max " << Percentile(latencies, 100) << std::endl
+              << "  in place read " << readSum / count << " ms per frame, frame " << lastFrame
+              << " mean brightness " << brightness << std::endl;
+    return 0;
+}
@@ -0,0 +1,274 @@
+#include "SphereBvh.h"
+#include "../Statistics/RayCounters.h"
+#include <algorithm>
+#include <cfloat>
+
+static float SurfaceArea(glm::vec3 boundsMin, glm::vec3 boundsMax) {
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(0));
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+void SphereBvh::Build(std::vector<Sphere>& spheres) {
+    nodes.clear();
+    int count = (int)spheres.size();
+    if (count == 0) {
+        return;
+    }
+
+    buildOrder.resize(count);
+    centroids.resize(count);
+    for (int i = 0; i < count; i++) {
+        buildOrder[i] = i;
+        centroids[i] = spheres[i].center;
+    }
+
+    // Children are appended as the tree is built, reserving keeps node references valid
+    nodes.reserve(count * 2);
+    nodes.emplace_back();
+    BuildNode(0, 0, count, 0, spheres);
+
+    std::vector<Sphere> ordered(count);
+    for (int i = 0; i < count; i++) {
+        ordered[i] = spheres[buildOrder[i]];
+    }
+    spheres.swap(ordered);
+    buildOrder.clear();
+    buildOrder.shrink_to_fit();
+    centroids.clear();
+    centroids.shrink_to_fit();
+}
+
+void SphereBvh::Refit(const std::vector<Sphere>& spheres) {
+    // Children are always appended after their parent, so walking backwards visits them first
+    for (int nodeIndex = (int)nodes.size() - 1; nodeIndex >= 0; nodeIndex--) {
+        Node& node = nodes[nodeIndex];
+        if (node.count > 0) {
+            node.boundsMin = glm::vec3(FLT_MAX);
+            node.boundsMax = glm::vec3(-FLT_MAX);
+            for (int i = node.first; i < node.first + node.count; i++) {
+                node.boundsMin = glm::min(node.boundsMin, spheres[i].center - spheres[i].radius);
+                node.boundsMax = glm::max(node.boundsMax, spheres[i].center + spheres[i].radius);
+            }
+        } else {
+            const Node& left = nodes[node.first];
+            const Node& right = nodes[node.first + 1];
+            node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+            node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+        }
+    }
+}
+
+void SphereBvh::BuildNode(int nodeIndex, int begin, int end, int depth, const std::vector<Sphere>& spheres) {
+    Node& node = nodes[nodeIndex];
+    node.boundsMin = glm::vec3(FLT_MAX);
+    node.boundsMax = glm::vec3(-FLT_MAX);
+    glm::vec3 centroidMin = glm::vec3(FLT_MAX);
+    glm::vec3 centroidMax = glm::vec3(-FLT_MAX);
+    for (int i = begin; i < end; i++) {
+        const Sphere& sphere = spheres[buildOrder[i]];
+        node.boundsMin = glm::min(node.boundsMin, sphere.center - sphere.radius);
+        node.boundsMax = glm::max(node.boundsMax, sphere.center + sphere.radius);
+        centroidMin = glm::min(centroidMin, sphere.center);
+        centroidMax = glm::max(centroidMax, sphere.center);
+    }
+
+    node.first = begin;
+    node.count = end - begin;
+    if (end - begin <= BVH_MAX_LEAF_SPHERES) {
+        return;
+    }
+
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    int middle = -1;
+    if (depth < BVH_SAH_MAX_DEPTH && extent[axis] > .0f) {
+        middle = SplitSah(begin, end, axis, centroidMin, centroidMax, node, spheres);
+    }
+    if (middle == begin || middle == end) {
+        // SAH found a leaf cheaper than any split
+        return;
+    }
+    if (middle < 0) {
+        // Coincident centers or too deep for SAH: split at the median
+        middle = (begin + end) / 2;
+        std::nth_element(buildOrder.begin() + begin, buildOrder.begin() + middle, buildOrder.begin() + end,
+            [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+    }
+
+    int left = (int)nodes.size();
+    node.first = left;
+    node.count = 0;
+    nodes.emplace_back();
+    nodes.emplace_back();
+    BuildNode(left, begin, middle, depth + 1, spheres);
+    BuildNode(left + 1, middle, end, depth + 1, spheres);
+}
+
+// Bins centroids along axis and partitions at the cheapest bin boundary by surface area heuristic.
+// Returns the partition point, begin if a leaf is cheaper than every split, or -1 if no split separates anything.
+int SphereBvh::SplitSah(int begin, int end, int axis, glm::vec3 centroidMin, glm::vec3 centroidMax, const Node& node, const std::vector<Sphere>& spheres) {
+    struct Bin {
+        glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+        glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+        int count = 0;
+    };
+    Bin bins[BVH_SAH_BINS];
+    float binScale = BVH_SAH_BINS / (centroidMax[axis] - centroidMin[axis]);
+    auto binIndex = [&](int sphere) {
+        return glm::min((int)((centroids[sphere][axis] - centroidMin[axis]) * binScale), BVH_SAH_BINS - 1);
+    };
+    for (int i = begin; i < end; i++) {
+        const Sphere& sphere = spheres[buildOrder[i]];
+        Bin& bin = bins[binIndex(buildOrder[i])];
+        bin.boundsMin = glm::min(bin.boundsMin, sphere.center - sphere.radius);
+        bin.boundsMax = glm::max(bin.boundsMax, sphere.center + sphere.radius);
+        bin.count++;
+    }
+
+    // Cost of everything right of each boundary, swept from the right
+    float rightCost[BVH_SAH_BINS];
+    Bin right;
+    for (int b = BVH_SAH_BINS - 1; b > 0; b--) {
+        right.boundsMin = glm::min(right.boundsMin, bins[b].boundsMin);
+        right.boundsMax = glm::max(right.boundsMax, bins[b].boundsMax);
+        right.count += bins[b].count;
+        rightCost[b] = right.count * SurfaceArea(right.boundsMin, right.boundsMax);
+    }
+
+    float bestCost = FLT_MAX;
+    int bestBoundary = -1;
+    Bin left;
+    for (int b = 1; b < BVH_SAH_BINS; b++) {
+        left.boundsMin = glm::min(left.boundsMin, bins[b - 1].boundsMin);
+        left.boundsMax = glm::max(left.boundsMax, bins[b - 1].boundsMax);
+        left.count += bins[b - 1].count;
+        if (left.count == 0 || left.count == end - begin) {
+            continue;
+        }
+        float cost = left.count * SurfaceArea(left.boundsMin, left.boundsMax) + rightCost[b];
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestBoundary = b;
+        }
+    }
+    if (bestBoundary < 0) {
+        return -1;
+    }
+    if (end - begin <= BVH_MAX_LEAF_SPHERES * 4 && bestCost >= (end - begin) * SurfaceArea(node.boundsMin, node.boundsMax)) {
+        return begin;
+    }
+
+    auto middle = std::partition(buildOrder.begin() + begin, buildOrder.begin() + end,
+        [&](int sphere) { return binIndex(sphere) < bestBoundary; });
+    return (int)(middle - buildOrder.begin());
+}
+
+float SphereBvh::Entry(const Node& node, glm::vec3 O, glm::vec3 inverseD, float tMin, float tMax) {
+    glm::vec3 t0 = (node.boundsMin - O) * inverseD;
+    glm::vec3 t1 = (node.boundsMax - O) * inverseD;
+    glm::vec3 near = glm::min(t0, t1);
+    glm::vec3 far = glm::max(t0, t1);
+    float entry = glm::max(glm::max(near.x, near.y), glm::max(near.z, tMin));
+    float exit = glm::min(glm::min(far.x, far.y), glm::min(far.z, tMax));
+    return entry <= exit ? entry : FLT_MAX;
+}
+
+int SphereBvh::Closest(const std::vector<Sphere>& spheres, glm::vec3 O, glm::vec3 D, float tMin, float tMax, float& closestT) const {
+    closestT = tMax;
+    int closest = -1;
+    glm::vec3 inverseD = 1.0f / D;
+    // Tallied locally and added to the thread's counters once, so the loop keeps them in registers
+    Uint64 nodeVisits = 1;
+    Uint64 sphereTests = 0;
+    if (Entry(nodes[0], O, inverseD, tMin, closestT) == FLT_MAX) {
+        ThreadRayCounters().nodeVisits += nodeVisits;
+        return -1;
+    }
+
+    // Far children wait on the stack with their entry distance, so they can be skipped once a closer hit is found
+    int stack[BVH_STACK_SIZE];
+    float stackEntry[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIndex = 0;
+    while (true) {
+        const Node& node = nodes[nodeIndex];
+        if (node.count > 0) {
+            sphereTests += node.count;
+            for (int i = node.first; i < node.first + node.count; i++) {
+                float t1, t2;
+                spheres[i].Intersect(O, D, t1, t2);
+                if (t1 > tMin && t1 < closestT) {
+                    closestT = t1;
+                    closest = i;
+                }
+                if (t2 > tMin && t2 < closestT) {
+                    closestT = t2;
+                    closest = i;
+                }
+            }
+        } else {
+            int near = node.first;
+            int far = node.first + 1;
+            nodeVisits += 2;
+            float nearEntry = Entry(nodes[near], O, inverseD, tMin, closestT);
+            float farEntry = Entry(nodes[far], O, inverseD, tMin, closestT);
+            if (farEntry < nearEntry) {
+                std::swap(near, far);
+                std::swap(nearEntry, farEntry);
+            }
+            if (nearEntry != FLT_MAX) {
+                if (farEntry != FLT_MAX) {
+                    stack[stackSize] = far;
+                    stackEntry[stackSize++] = farEntry;
+                }
+                nodeIndex = near;
+                continue;
+            }
+        }
+        do {
+            if (stackSize == 0) {
+                RayCounters& counters = ThreadRayCounters();
+                counters.nodeVisits += nodeVisits;
+                counters.sphereTests += sphereTests;
+                return closest;
+            }
+            stackSize--;
+        } while (stackEntry[stackSize] >= closestT);
+        nodeIndex = stack[stackSize];
+    }
+}
+
+bool SphereBvh::AnyHit(const std::vector<Sphere>& spheres, glm::vec3 O, glm::vec3 D, float tMin, float tMax) const {
+    glm::vec3 inverseD = 1.0f / D;
+    Uint64 nodeVisits = 0;
+    Uint64 sphereTests = 0;
+    bool hit = false;
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0 && !hit) {
+        const Node& node = nodes[stack[--stackSize]];
+        nodeVisits++;
+        if (Entry(node, O, inverseD, tMin, tMax) == FLT_MAX) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[stackSize++] = node.first + 1;
+            stack[stackSize++] = node.first;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; i++) {
+            float t1, t2;
+            sphereTests++;
+            spheres[i].Intersect(O, D, t1, t2);
+            if ((t1 > tMin && t1 < tMax) || (t2 > tMin && t2 < tMax)) {
+                hit = true;
+                break;
+            }
+        }
+    }
+    RayCounters& counters = ThreadRayCounters();
+    counters.nodeVisits += nodeVisits;
+    counters.sphereTests += sphereTests;
+    return hit;
+}
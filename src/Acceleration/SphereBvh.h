@@ -0,0 +1,51 @@
+#ifndef SPHEREBVH_H
+#define SPHEREBVH_H
+
+#include "../Scene/Sphere.h"
+#include <vector>
+
+// Scenes with fewer spheres are intersected by looping over all of them
+const int BVH_MIN_SPHERES = 8;
+const int BVH_MAX_LEAF_SPHERES = 4;
+const int BVH_SAH_BINS = 12;
+// Below this depth nodes are split by binned SAH, deeper ones at the median, which bounds the tree depth
+const int BVH_SAH_MAX_DEPTH = 32;
+const int BVH_STACK_SIZE = 64;
+
+// Bounding volume hierarchy over the spheres of a scene. Build reorders the spheres so every leaf
+// covers a contiguous range of them, and traversal visits the nearer child first. Traversal counts
+// the node bounds and spheres it tests into the calling thread's RayCounters.
+class SphereBvh {
+    private:
+        struct Node {
+            glm::vec3 boundsMin;
+            // Inner nodes: index of the left child, the right one follows it. Leaves: first sphere
+            int first;
+            glm::vec3 boundsMax;
+            // Spheres in a leaf, 0 for inner nodes
+            int count;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<int> buildOrder;
+        std::vector<glm::vec3> centroids;
+
+        void BuildNode(int nodeIndex, int begin, int end, int depth, const std::vector<Sphere>& spheres);
+        int SplitSah(int begin, int end, int axis, glm::vec3 centroidMin, glm::vec3 centroidMax, const Node& node, const std::vector<Sphere>& spheres);
+        // Distance at which the ray enters the node within (tMin, tMax), FLT_MAX if it misses
+        static float Entry(const Node& node, glm::vec3 O, glm::vec3 inverseD, float tMin, float tMax);
+
+    public:
+        void Build(std::vector<Sphere>& spheres);
+        // Recomputes the node bounds for moved spheres, which must be in the order Build left them.
+        // Keeps the tree's shape, so it is much cheaper than a rebuild but degrades if spheres move far.
+        void Refit(const std::vector<Sphere>& spheres);
+        bool Empty() const { return nodes.empty(); }
+        int NodeCount() const { return (int)nodes.size(); }
+
+        // Index of the closest sphere hit within (tMin, tMax) with its distance in closestT, or -1
+        int Closest(const std::vector<Sphere>& spheres, glm::vec3 O, glm::vec3 D, float tMin, float tMax, float& closestT) const;
+        bool AnyHit(const std::vector<Sphere>& spheres, glm::vec3 O, glm::vec3 D, float tMin, float tMax) const;
+};
+
+#endif
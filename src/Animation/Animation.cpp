@@ -0,0 +1,22 @@
+#include "Animation.h"
+#include "../Sampling/Random.h"
+#include <glm/gtc/constants.hpp>
+
+void AnimateSpheres(const std::vector<Sphere>& rest, float time, std::vector<Sphere>& out) {
+    for (size_t i = 0; i < rest.size(); i++) {
+        const Sphere& sphere = rest[i];
+        out[i] = sphere;
+        if (sphere.radius >= ANIMATION_STATIC_RADIUS) {
+            continue;
+        }
+        float phase = HashUint((Uint32)i) * (1.0f / 4294967296.0f);
+        float bounce = glm::abs(glm::sin(glm::pi<float>() * (time * ANIMATION_BOUNCE_HZ + phase)));
+        out[i].center.y += sphere.radius * ANIMATION_BOUNCE_HEIGHT * bounce;
+    }
+}
+
+glm::vec3 AnimateCamera(glm::vec3 rest, float time) {
+    float angle = glm::two_pi<float>() * time / ANIMATION_CAMERA_PERIOD;
+    return rest + glm::vec3(ANIMATION_CAMERA_SWAY * glm::sin(angle), 0.0f, 0.0f);
+}
+
@@ -0,0 +1,27 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "../Scene/Sphere.h"
+#include <vector>
+
+const int ANIMATION_FPS = 24;
+// Frames allowed between scene update and the finished file: one updating, one tracing, one writing
+const int ANIMATION_FRAMES_IN_FLIGHT = 3;
+const int ANIMATION_MAX_FRAMES_IN_FLIGHT = 16;
+const char* const ANIMATION_OUTPUT = "frame_####.ppm";
+// Spheres at least this large (the ground) stay put
+const float ANIMATION_STATIC_RADIUS = 100.0f;
+// Spheres bounce up to this many radii high, this many times a second
+const float ANIMATION_BOUNCE_HEIGHT = 0.5f;
+const float ANIMATION_BOUNCE_HZ = 0.5f;
+// The camera sways sideways by this much, once per period
+const float ANIMATION_CAMERA_SWAY = 0.75f;
+const float ANIMATION_CAMERA_PERIOD = 8.0f;
+
+// Built-in animation of any scene, a pure function of time so frames can be rendered in any order
+// and in separate runs. Every sphere below the static radius bounces with its own phase, derived
+// from its index, and out (sized like rest) receives the spheres at time seconds.
+void AnimateSpheres(const std::vector<Sphere>& rest, float time, std::vector<Sphere>& out);
+glm::vec3 AnimateCamera(glm::vec3 rest, float time);
+
+#endif
@@ -0,0 +1,80 @@
+#include "Camera.h"
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
+
+Camera::Camera() {
+    Update();
+}
+
+void Camera::SetPose(glm::vec3 position, float yaw, float pitch) {
+    this->position = position;
+    this->yaw = yaw;
+    this->pitch = pitch;
+    Update();
+}
+
+void Camera::SetFov(float degrees) {
+    fov = degrees;
+    Update();
+}
+
+void Camera::Prepare(int canvasWidth, int canvasHeight) {
+    this->canvasWidth = canvasWidth;
+    this->canvasHeight = canvasHeight;
+    Update();
+}
+
+void Camera::Update() {
+    forward = glm::vec3(glm::sin(yaw) * glm::cos(pitch), glm::sin(pitch), glm::cos(yaw) * glm::cos(pitch));
+    right = glm::normalize(glm::cross(glm::vec3(0, 1, 0), forward));
+    up = glm::cross(forward, right);
+
+    // In double, so the default field of view gives exactly the original 1 x 1 viewport
+    viewportHeight = (float)(2.0 * CAMERA_VIEWPORT_DEPTH * std::tan(glm::radians((double)fov) * 0.5));
+    viewportWidth = viewportHeight * canvasWidth / canvasHeight;
+    pixelDeltaX = right * (viewportWidth / canvasWidth);
+    pixelDeltaY = -up * (viewportHeight / canvasHeight);
+    firstPixel = forward * CAMERA_VIEWPORT_DEPTH - (float)(canvasWidth / 2) * pixelDeltaX - (float)(canvasHeight / 2) * pixelDeltaY;
+}
+
+// The part of the direction that depends on the column is shared by the tile's rows, so each packet
+// takes one multiply and one add per component. The operations are those of PrimaryDirection in the
+// same order, which keeps the results identical.
+int Camera::GenerateTile(int x0, int y0, int width, int height, RayPacket* packets) const {
+    int packetsPerRow = (width + RAY_PACKET_WIDTH - 1) / RAY_PACKET_WIDTH;
+    int column = 0;
+
+#if defined(__SSE2__)
+    const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    for (; column < packetsPerRow; column++) {
+        __m128 sX = _mm_add_ps(_mm_set1_ps((float)(x0 + column * RAY_PACKET_WIDTH)), lanes);
+        __m128 columnX = _mm_add_ps(_mm_set1_ps(firstPixel.x), _mm_mul_ps(sX, _mm_set1_ps(pixelDeltaX.x)));
+        __m128 columnY = _mm_add_ps(_mm_set1_ps(firstPixel.y), _mm_mul_ps(sX, _mm_set1_ps(pixelDeltaX.y)));
+        __m128 columnZ = _mm_add_ps(_mm_set1_ps(firstPixel.z), _mm_mul_ps(sX, _mm_set1_ps(pixelDeltaX.z)));
+        for (int row = 0; row < height; row++) {
+            float sY = (float)(y0 + row);
+            RayPacket& packet = packets[row * packetsPerRow + column];
+            _mm_store_ps(packet.x, _mm_add_ps(columnX, _mm_set1_ps(sY * pixelDeltaY.x)));
+            _mm_store_ps(packet.y, _mm_add_ps(columnY, _mm_set1_ps(sY * pixelDeltaY.y)));
+            _mm_store_ps(packet.z, _mm_add_ps(columnZ, _mm_set1_ps(sY * pixelDeltaY.z)));
+        }
+    }
+#endif
+
+    for (; column < packetsPerRow; column++) {
+        for (int row = 0; row < height; row++) {
+            float sY = (float)(y0 + row);
+            RayPacket& packet = packets[row * packetsPerRow + column];
+            for (int lane = 0; lane < RAY_PACKET_WIDTH; lane++) {
+                glm::vec3 direction = PrimaryDirection((float)(x0 + column * RAY_PACKET_WIDTH + lane), sY);
+                packet.x[lane] = direction.x;
+                packet.y[lane] = direction.y;
+                packet.z[lane] = direction.z;
+            }
+        }
+    }
+    return packetsPerRow;
+}
@@ -0,0 +1,81 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <glm/glm.hpp>
+
+// Vertical field of view of the original fixed camera, a 1 x 1 viewport at depth 1
+const float CAMERA_FOV = 53.1301024f;
+const float CAMERA_MIN_FOV = 1.0f;
+const float CAMERA_MAX_FOV = 170.0f;
+// Distance of the viewport from the eye, where primary rays start
+const float CAMERA_VIEWPORT_DEPTH = 1.0f;
+// Primary ray directions reach the viewport at t = 1, so this is their tMin
+const float PRIMARY_RAY_TMIN = 1.0f;
+const int RAY_PACKET_WIDTH = 4;
+
+// Primary ray directions of RAY_PACKET_WIDTH neighbouring pixels of a row, as structure of arrays
+struct alignas(16) RayPacket {
+    float x[RAY_PACKET_WIDTH];
+    float y[RAY_PACKET_WIDTH];
+    float z[RAY_PACKET_WIDTH];
+
+    glm::vec3 Direction(int lane) const { return glm::vec3(x[lane], y[lane], z[lane]); }
+};
+
+// Pinhole camera at position, turned by yaw (radians, to the right about +Y from looking down +Z)
+// and then pitch (up). Prepare sets it up for a canvas of pixels, whose aspect ratio gives the
+// viewport width, and precomputes the viewport's corner and per-pixel steps, so the direction
+// through any screen point is two multiply-adds per component. Screen points are in pixels from the
+// canvas' top left corner, with pixel (sX, sY) centered on point (sX, sY) and the view axis through
+// pixel (canvasWidth / 2, canvasHeight / 2).
+class Camera {
+    private:
+        glm::vec3 position = glm::vec3(0);
+        float yaw = 0.0f;
+        float pitch = 0.0f;
+        float fov = CAMERA_FOV;
+        int canvasWidth = 1;
+        int canvasHeight = 1;
+
+        glm::vec3 right = glm::vec3(1, 0, 0);
+        glm::vec3 up = glm::vec3(0, 1, 0);
+        glm::vec3 forward = glm::vec3(0, 0, 1);
+        float viewportWidth = 1.0f;
+        float viewportHeight = 1.0f;
+        // Direction through screen point (0, 0), and the steps of one pixel right and one pixel down
+        glm::vec3 firstPixel = glm::vec3(0);
+        glm::vec3 pixelDeltaX = glm::vec3(0);
+        glm::vec3 pixelDeltaY = glm::vec3(0);
+
+        void Update();
+
+    public:
+        Camera();
+        void SetPose(glm::vec3 position, float yaw, float pitch);
+        // Vertical field of view in degrees
+        void SetFov(float degrees);
+        void Prepare(int canvasWidth, int canvasHeight);
+
+        glm::vec3 Position() const { return position; }
+        float Yaw() const { return yaw; }
+        float Pitch() const { return pitch; }
+        glm::vec3 Right() const { return right; }
+        glm::vec3 Up() const { return up; }
+        glm::vec3 Forward() const { return forward; }
+        float ViewportWidth() const { return viewportWidth; }
+        float ViewportHeight() const { return viewportHeight; }
+        float ViewportDepth() const { return CAMERA_VIEWPORT_DEPTH; }
+        int CanvasWidth() const { return canvasWidth; }
+        int CanvasHeight() const { return canvasHeight; }
+
+        // Unnormalized direction of the primary ray through screen point (sX, sY)
+        glm::vec3 PrimaryDirection(float sX, float sY) const {
+            return firstPixel + sX * pixelDeltaX + sY * pixelDeltaY;
+        }
+        // Primary directions of the width x height pixels from (x0, y0), row by row in packets of
+        // RAY_PACKET_WIDTH, the last packet of a row padded with pixels beyond it. Bit for bit the same
+        // as PrimaryDirection. Returns the packets per row.
+        int GenerateTile(int x0, int y0, int width, int height, RayPacket* packets) const;
+};
+
+#endif
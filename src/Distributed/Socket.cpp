@@ -0,0 +1,273 @@
+#include "Socket.h"
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SOCKETS_AVAILABLE 1
+#endif
+
+// Connections waiting to be accepted
+static const int LISTEN_BACKLOG = 64;
+
+Socket::~Socket() {
+    Close();
+}
+
+Socket::Socket(Socket&& other) noexcept : descriptor(other.descriptor) {
+    other.descriptor = -1;
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+    std::swap(descriptor, other.descriptor);
+    other.Close();
+    return *this;
+}
+
+#ifdef SOCKETS_AVAILABLE
+
+static bool IsUnixAddress(const std::string& address) {
+    return address.compare(0, 5, "unix:") == 0;
+}
+
+static bool UnixSocketAddress(const std::string& address, sockaddr_un& socketAddress, std::string& error) {
+    std::string path = address.substr(5);
+    std::memset(&socketAddress, 0, sizeof(socketAddress));
+    socketAddress.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(socketAddress.sun_path)) {
+        error = "bad socket path " + path;
+        return false;
+    }
+    std::memcpy(socketAddress.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Splits "host:port" or "port", resolving the host (any interface when listening without one)
+static addrinfo* ResolveTcpAddress(const std::string& address, bool listening, std::string& error) {
+    size_t colon = address.rfind(':');
+    std::string host = colon == std::string::npos ? "" : address.substr(0, colon);
+    std::string port = colon == std::string::npos ? address : address.substr(colon + 1);
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    int status = getaddrinfo(host.empty() ? (listening ? nullptr : "localhost") : host.c_str(), port.c_str(), &hints, &result);
+    if (status != 0) {
+        error = std::string("cannot resolve ") + address + ": " + gai_strerror(status);
+        return nullptr;
+    }
+    return result;
+}
+
+// Tiles are small request/response messages, so send them right away instead of batching
+static void ConfigureStream(int descriptor, int family) {
+    int enable = 1;
+    if (family != AF_UNIX) {
+        setsockopt(descriptor, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+#ifdef SO_NOSIGPIPE
+    setsockopt(descriptor, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+}
+
+bool Socket::Listen(const std::string& address, std::string& error) {
+    Close();
+    if (IsUnixAddress(address)) {
+        sockaddr_un socketAddress;
+        if (!UnixSocketAddress(address, socketAddress, error)) {
+            return false;
+        }
+        unlink(socketAddress.sun_path);
+        descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (descriptor < 0 || bind(descriptor, (sockaddr*)&socketAddress, sizeof(socketAddress)) != 0) {
+            error = std::string("cannot bind ") + address + ": " + std::strerror(errno);
+            Close();
+            return false;
+        }
+    } else {
+        addrinfo* addresses = ResolveTcpAddress(address, true, error);
+        for (addrinfo* entry = addresses; entry && descriptor < 0; entry = entry->ai_next) {
+            descriptor = socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+            int reuse = 1;
+            if (descriptor >= 0 && (setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+                                    bind(descriptor, entry->ai_addr, entry->ai_addrlen) != 0)) {
+                error = std::string("cannot bind ") + address + ": " + std::strerror(errno);
+                Close();
+            }
+        }
+        if (addresses) {
+            freeaddrinfo(addresses);
+        }
+        if (descriptor < 0) {
+            return false;
+        }
+    }
+
+    if (listen(descriptor, LISTEN_BACKLOG) != 0) {
+        error = std::string("cannot listen on ") + address + ": " + std::strerror(errno);
+        Close();
+        return false;
+    }
+    // Accept polls for new connections between tiles, so it must never block
+    fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+bool Socket::Connect(const std::string& address, std::string& error) {
+    Close();
+    if (IsUnixAddress(address)) {
+        sockaddr_un socketAddress;
+        if (!UnixSocketAddress(address, socketAddress, error)) {
+            return false;
+        }
+        descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (descriptor < 0 || connect(descriptor, (sockaddr*)&socketAddress, sizeof(socketAddress)) != 0) {
+            error = std::string("cannot connect to ") + address + ": " + std::strerror(errno);
+            Close();
+            return false;
+        }
+        ConfigureStream(descriptor, AF_UNIX);
+        return true;
+    }
+
+    addrinfo* addresses = ResolveTcpAddress(address, false, error);
+    for (addrinfo* entry = addresses; entry && descriptor < 0; entry = entry->ai_next) {
+        descriptor = socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+        if (descriptor >= 0 && connect(descriptor, entry->ai_addr, entry->ai_addrlen) != 0) {
+            error = std::string("cannot connect to ") + address + ": " + std::strerror(errno);
+            Close();
+        } else if (descriptor >= 0) {
+            ConfigureStream(descriptor, entry->ai_family);
+        }
+    }
+    if (addresses) {
+        freeaddrinfo(addresses);
+    }
+    return descriptor >= 0;
+}
+
+Socket Socket::Accept() {
+    sockaddr_storage peer;
+    socklen_t peerSize = sizeof(peer);
+    int connection = accept(descriptor, (sockaddr*)&peer, &peerSize);
+    if (connection < 0) {
+        return Socket();
+    }
+    // Connections don't inherit O_NONBLOCK everywhere, clear it explicitly
+    fcntl(connection, F_SETFL, fcntl(connection, F_GETFL) & ~O_NONBLOCK);
+    ConfigureStream(connection, peer.ss_family);
+    return Socket(connection);
+}
+
+void Socket::Close() {
+    if (descriptor >= 0) {
+        close(descriptor);
+        descriptor = -1;
+    }
+}
+
+bool Socket::SendAll(const void* data, size_t size) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        ssize_t sent = send(descriptor, bytes, size, flags);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+bool Socket::ReceiveAll(void* data, size_t size) {
+    char* bytes = (char*)data;
+    while (size > 0) {
+        ssize_t received = recv(descriptor, bytes, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        size -= (size_t)received;
+    }
+    return true;
+}
+
+bool Socket::WaitReadable(int timeoutMs) const {
+    pollfd entry = {descriptor, POLLIN, 0};
+    return poll(&entry, 1, timeoutMs) > 0;
+}
+
+bool Socket::WaitAnyReadable(Socket* const* sockets, int count, bool* readable, int timeoutMs) {
+    pollfd entries[SOCKET_MAX_WAIT];
+    count = count < SOCKET_MAX_WAIT ? count : SOCKET_MAX_WAIT;
+    for (int i = 0; i < count; i++) {
+        entries[i] = {sockets[i]->descriptor, POLLIN, 0};
+    }
+    bool ready = poll(entries, count, timeoutMs) > 0;
+    for (int i = 0; i < count; i++) {
+        readable[i] = ready && entries[i].revents != 0;
+    }
+    return ready;
+}
+
+#else
+
+bool Socket::Listen(const std::string&, std::string& error) {
+    error = "sockets are not supported on this platform";
+    return false;
+}
+
+bool Socket::Connect(const std::string&, std::string& error) {
+    error = "sockets are not supported on this platform";
+    return false;
+}
+
+Socket Socket::Accept() {
+    return Socket();
+}
+
+void Socket::Close() {
+    descriptor = -1;
+}
+
+bool Socket::SendAll(const void*, size_t) {
+    return false;
+}
+
+bool Socket::ReceiveAll(void*, size_t) {
+    return false;
+}
+
+bool Socket::WaitReadable(int) const {
+    return false;
+}
+
+bool Socket::WaitAnyReadable(Socket* const*, int count, bool* readable, int) {
+    for (int i = 0; i < count; i++) {
+        readable[i] = false;
+    }
+    return false;
+}
+
+#endif
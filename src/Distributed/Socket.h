@@ -0,0 +1,44 @@
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <cstddef>
+#include <string>
+
+// Sockets WaitAnyReadable can watch at once
+const int SOCKET_MAX_WAIT = 256;
+
+// Blocking stream sockets over TCP ("host:port", or just "port" to listen on every interface) or
+// Unix domain sockets ("unix:/path"). POSIX only; elsewhere every call fails with a reason.
+class Socket {
+    private:
+        int descriptor = -1;
+
+    public:
+        Socket() = default;
+        explicit Socket(int descriptor) : descriptor(descriptor) {}
+        ~Socket();
+        Socket(Socket&& other) noexcept;
+        Socket& operator=(Socket&& other) noexcept;
+        Socket(const Socket&) = delete;
+        Socket& operator=(const Socket&) = delete;
+
+        bool Listen(const std::string& address, std::string& error);
+        bool Connect(const std::string& address, std::string& error);
+        // Next pending connection of a listening socket, an invalid socket if there is none
+        Socket Accept();
+        void Close();
+
+        bool Valid() const { return descriptor >= 0; }
+        int Descriptor() const { return descriptor; }
+
+        // Both return false once the connection is closed or broken
+        bool SendAll(const void* data, size_t size);
+        bool ReceiveAll(void* data, size_t size);
+        // Waits up to timeoutMs for data to read (or the peer hanging up), 0 only checks
+        bool WaitReadable(int timeoutMs) const;
+        // Same over count (at most SOCKET_MAX_WAIT) sockets, setting readable[i] for each that is ready.
+        // Returns false if none became ready within timeoutMs.
+        static bool WaitAnyReadable(Socket* const* sockets, int count, bool* readable, int timeoutMs);
+};
+
+#endif
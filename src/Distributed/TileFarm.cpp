@@ -0,0 +1,322 @@
+#include "TileFarm.h"
+#include "../Profiling/Profiler.h"
+#include <iomanip>
+#include <iostream>
+
+double TileCoordinator::Now() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+bool TileCoordinator::Listen(const std::string& address, int maxWidth, int maxHeight, int tileSize, Uint64 sceneHash, std::string& error) {
+    if (!listener.Listen(address, error)) {
+        return false;
+    }
+    this->address = address;
+    this->tileSize = tileSize;
+    this->sceneHash = sceneHash;
+    startTime = std::chrono::steady_clock::now();
+    workers.reserve(FARM_MAX_WORKERS);
+    tiles.resize((size_t)((maxWidth + tileSize - 1) / tileSize) * ((maxHeight + tileSize - 1) / tileSize));
+    pixelBuffer.resize((size_t)tileSize * tileSize * 3);
+    return true;
+}
+
+void TileCoordinator::WaitForWorkers(int count) {
+    if (count <= 0) {
+        return;
+    }
+    std::cout << "Waiting for " << count << " worker" << (count == 1 ? "" : "s") << " on " << address << std::endl;
+    HdrFramebuffer unused;
+    int ready = 0;
+    while (ready < count) {
+        AcceptWorkers();
+        if (!listener.WaitReadable(FARM_POLL_MS)) {
+            for (Worker& worker : workers) {
+                if (worker.Alive() && worker.threads == 0 && worker.socket.WaitReadable(0)) {
+                    ReceiveMessage(worker, unused);
+                }
+            }
+        }
+        ready = 0;
+        for (const Worker& worker : workers) {
+            ready += worker.Alive() && worker.threads > 0;
+        }
+    }
+}
+
+void TileCoordinator::AcceptWorkers() {
+    while (true) {
+        Socket connection = listener.Accept();
+        if (!connection.Valid()) {
+            return;
+        }
+        if ((int)workers.size() >= FARM_MAX_WORKERS) {
+            std::cout << "Tile farm: turned a worker away, " << FARM_MAX_WORKERS << " have connected already" << std::endl;
+            continue;
+        }
+        workers.emplace_back();
+        Worker& worker = workers.back();
+        worker.socket = std::move(connection);
+        worker.connectedAt = worker.lastMessageAt = Now();
+    }
+}
+
+// Closes the connection and puts the worker's tiles of the current frame back in the queue, unless
+// another worker is tracing them as well
+void TileCoordinator::DropWorker(Worker& worker, const char* reason) {
+    for (int i = 0; i < worker.queuedCount; i++) {
+        const QueuedTile& queued = worker.queued[i];
+        if (queued.frameIndex != frame.frameIndex || queued.tile >= tileCount) {
+            continue;
+        }
+        TileState& tile = tiles[queued.tile];
+        tile.copies--;
+        if (!tile.done && tile.copies == 0) {
+            worker.reassignedTiles++;
+            nextPendingTile = glm::min(nextPendingTile, queued.tile);
+        }
+    }
+    worker.queuedCount = 0;
+    worker.socket.Close();
+    worker.disconnectedAt = Now();
+    worker.dropReason = reason;
+    std::cout << "Tile farm: worker " << (&worker - workers.data()) << " dropped (" << reason << ")";
+    if (worker.reassignedTiles > 0) {
+        std::cout << ", " << worker.reassignedTiles << " tiles reassigned";
+    }
+    std::cout << std::endl;
+}
+
+int TileCoordinator::LiveWorkers() const {
+    int count = 0;
+    for (const Worker& worker : workers) {
+        count += worker.Alive();
+    }
+    return count;
+}
+
+int TileCoordinator::NextPendingTile() {
+    while (nextPendingTile < tileCount && (tiles[nextPendingTile].done || tiles[nextPendingTile].copies > 0)) {
+        nextPendingTile++;
+    }
+    return nextPendingTile < tileCount ? nextPendingTile : -1;
+}
+
+// The longest outstanding tile that only one other worker is tracing, if it is overdue
+int TileCoordinator::StragglerTile(const Worker& worker, double now) const {
+    double averageSeconds = completedTiles > 0 ? completedTileSeconds / completedTiles : 0.0;
+    double overdue = glm::max(FARM_MIN_STRAGGLER_SECONDS, FARM_STRAGGLER_FACTOR * averageSeconds);
+    int oldest = -1;
+    for (int tile = 0; tile < tileCount; tile++) {
+        const TileState& state = tiles[tile];
+        if (state.done || state.copies != 1 || now - state.assignedAt < overdue ||
+            (oldest >= 0 && state.assignedAt >= tiles[oldest].assignedAt)) {
+            continue;
+        }
+        bool ownTile = false;
+        for (int i = 0; i < worker.queuedCount && !ownTile; i++) {
+            ownTile = worker.queued[i].frameIndex == frame.frameIndex && worker.queued[i].tile == tile;
+        }
+        if (!ownTile) {
+            oldest = tile;
+        }
+    }
+    return oldest;
+}
+
+void TileCoordinator::AssignTiles(double now) {
+    for (Worker& worker : workers) {
+        if (!worker.Alive() || worker.threads == 0) {
+            continue;
+        }
+        int credit = glm::min(FARM_MAX_QUEUED_TILES, (int)worker.threads * FARM_TILES_PER_THREAD);
+        while (worker.queuedCount < credit) {
+            int tile = NextPendingTile();
+            if (tile < 0) {
+                tile = StragglerTile(worker, now);
+            }
+            if (tile < 0) {
+                break;
+            }
+            TileRequest request = {frame.frameIndex, frame.width, frame.height, tile, {frame.origin.x, frame.origin.y, frame.origin.z}, frame.yaw, frame.pitch};
+            if (!SendTileMessage(worker.socket, TILE_REQUEST, request)) {
+                DropWorker(worker, "connection lost");
+                break;
+            }
+            TileState& state = tiles[tile];
+            if (state.copies == 0) {
+                state.assignedAt = now;
+            }
+            state.copies++;
+            if (worker.firstTileAt < 0.0) {
+                worker.firstTileAt = now;
+            }
+            if (worker.queuedCount == 0) {
+                // An idle worker owes nothing, so its timeout runs from when it is given work again
+                worker.lastMessageAt = now;
+            }
+            worker.queued[worker.queuedCount++] = {frame.frameIndex, tile, now};
+        }
+    }
+}
+
+void TileCoordinator::ReceiveMessage(Worker& worker, HdrFramebuffer& target) {
+    TileMessageHeader header;
+    if (!worker.socket.ReceiveAll(&header, sizeof(header))) {
+        DropWorker(worker, "disconnected");
+        return;
+    }
+    worker.lastMessageAt = Now();
+    bool ok = false;
+    if (header.type == TILE_HELLO && worker.threads == 0) {
+        ok = ReceiveHello(worker, header.size);
+    } else if (header.type == TILE_RESULT && worker.threads > 0) {
+        ok = ReceiveResult(worker, header.size, target);
+    }
+    if (!ok && worker.Alive()) {
+        DropWorker(worker, "protocol error");
+    }
+}
+
+bool TileCoordinator::ReceiveHello(Worker& worker, Uint32 size) {
+    TileHello hello;
+    if (size != sizeof(hello) || !worker.socket.ReceiveAll(&hello, sizeof(hello))) {
+        return false;
+    }
+    if (hello.version != TILE_PROTOCOL_VERSION || hello.sceneHash != sceneHash) {
+        DropWorker(worker, hello.version != TILE_PROTOCOL_VERSION ? "different protocol version" : "different scene or settings");
+        return true;
+    }
+    worker.threads = glm::max(1u, (unsigned)hello.threads);
+    std::cout << "Tile farm: worker " << (&worker - workers.data()) << " joined with " << worker.threads << " threads" << std::endl;
+    return true;
+}
+
+bool TileCoordinator::ReceiveResult(Worker& worker, Uint32 size, HdrFramebuffer& target) {
+    TileResult result;
+    if (size < sizeof(result) || !worker.socket.ReceiveAll(&result, sizeof(result)) ||
+        result.pixelCount < 0 || result.pixelCount > tileSize * tileSize ||
+        size != sizeof(result) + (Uint32)result.pixelCount * 3 * sizeof(float) ||
+        !worker.socket.ReceiveAll(pixelBuffer.data(), (size_t)result.pixelCount * 3 * sizeof(float))) {
+        return false;
+    }
+
+    double now = Now();
+    for (int i = 0; i < worker.queuedCount; i++) {
+        if (worker.queued[i].frameIndex == result.frameIndex && worker.queued[i].tile == result.tileIndex) {
+            worker.tileSeconds += now - worker.queued[i].sentAt;
+            worker.queued[i] = worker.queued[--worker.queuedCount];
+            break;
+        }
+    }
+
+    bool current = result.frameIndex == frame.frameIndex && result.tileIndex >= 0 && result.tileIndex < tileCount;
+    if (!current || tiles[result.tileIndex].done) {
+        worker.lateTiles++;
+        return true;
+    }
+    int x0 = (result.tileIndex % tilesX) * tileSize;
+    int y0 = (result.tileIndex / tilesX) * tileSize;
+    int x1 = glm::min(x0 + tileSize, frame.width);
+    int y1 = glm::min(y0 + tileSize, frame.height);
+    if (result.pixelCount != (x1 - x0) * (y1 - y0)) {
+        return false;
+    }
+    const float* pixel = pixelBuffer.data();
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++, pixel += 3) {
+            target.SetPixel(x, y, glm::vec3(pixel[0], pixel[1], pixel[2]));
+        }
+    }
+
+    TileState& tile = tiles[result.tileIndex];
+    tile.done = true;
+    doneTiles++;
+    completedTiles++;
+    completedTileSeconds += now - tile.assignedAt;
+    worker.tiles++;
+    worker.pixels += (Uint64)result.pixelCount;
+    return true;
+}
+
+int TileCoordinator::TraceFrame(const FarmFrame& frame, HdrFramebuffer& target, int* localTiles) {
+    PROFILE_ZONE("FarmFrame");
+    this->frame = frame;
+    tilesX = (frame.width + tileSize - 1) / tileSize;
+    tileCount = tilesX * ((frame.height + tileSize - 1) / tileSize);
+    for (int tile = 0; tile < tileCount; tile++) {
+        tiles[tile] = TileState();
+    }
+    doneTiles = 0;
+    nextPendingTile = 0;
+
+    Socket* sockets[SOCKET_MAX_WAIT];
+    Worker* socketWorkers[SOCKET_MAX_WAIT];
+    bool readable[SOCKET_MAX_WAIT];
+    while (doneTiles < tileCount) {
+        AcceptWorkers();
+        if (LiveWorkers() == 0) {
+            int count = 0;
+            for (int tile = 0; tile < tileCount; tile++) {
+                if (!tiles[tile].done) {
+                    localTiles[count++] = tile;
+                }
+            }
+            return count;
+        }
+
+        double now = Now();
+        AssignTiles(now);
+
+        int socketCount = 0;
+        sockets[socketCount++] = &listener;
+        for (Worker& worker : workers) {
+            if (worker.Alive() && socketCount < SOCKET_MAX_WAIT) {
+                socketWorkers[socketCount] = &worker;
+                sockets[socketCount++] = &worker.socket;
+            }
+        }
+        Socket::WaitAnyReadable(sockets, socketCount, readable, FARM_POLL_MS);
+        for (int i = 1; i < socketCount; i++) {
+            if (readable[i] && socketWorkers[i]->Alive()) {
+                ReceiveMessage(*socketWorkers[i], target);
+            }
+        }
+
+        now = Now();
+        for (Worker& worker : workers) {
+            bool owesMessage = worker.queuedCount > 0 || worker.threads == 0;
+            if (worker.Alive() && owesMessage && now - worker.lastMessageAt > FARM_WORKER_TIMEOUT) {
+                DropWorker(worker, "timed out");
+            }
+        }
+    }
+    return 0;
+}
+
+void TileCoordinator::PrintStats() const {
+    if (workers.empty()) {
+        return;
+    }
+    double now = Now();
+    std::cout << std::fixed << std::setprecision(2) << "  tile farm workers:" << std::endl;
+    for (size_t i = 0; i < workers.size(); i++) {
+        const Worker& worker = workers[i];
+        double seconds = worker.firstTileAt < 0.0 ? 0.0 : (worker.Alive() ? now : worker.disconnectedAt) - worker.firstTileAt;
+        std::cout << "    worker " << i << ": " << worker.threads << " threads, " << worker.tiles << " tiles, "
+                  << (seconds > 0.0 ? worker.pixels / seconds / 1e6 : 0.0) << " M pixels/s";
+        if (worker.tiles + worker.lateTiles > 0) {
+            std::cout << ", " << worker.tileSeconds * 1000.0 / (worker.tiles + worker.lateTiles) << " ms per tile round trip";
+        }
+        if (worker.lateTiles > 0) {
+            std::cout << ", " << worker.lateTiles << " late duplicates";
+        }
+        if (!worker.Alive()) {
+            std::cout << ", dropped (" << worker.dropReason << ")";
+            if (worker.reassignedTiles > 0) {
+                std::cout << " with " << worker.reassignedTiles << " tiles reassigned";
+            }
+        }
+        std::cout << std::endl;
+    }
+}
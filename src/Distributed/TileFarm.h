@@ -0,0 +1,121 @@
+#ifndef TILEFARM_H
+#define TILEFARM_H
+
+#include "../Framebuffer/Framebuffer.h"
+#include "Socket.h"
+#include "TileProtocol.h"
+#include <SDL2/SDL.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+const int FARM_MAX_WORKERS = 64;
+// Tiles queued on a worker per render thread it has, so it never sits idle waiting for the next one
+const int FARM_TILES_PER_THREAD = 2;
+const int FARM_MAX_QUEUED_TILES = 64;
+// A worker that owes tiles but sends nothing for this long is dropped and its tiles reassigned
+const double FARM_WORKER_TIMEOUT = 5.0;
+// Once every tile is assigned, idle workers also trace tiles another worker has held for this many
+// times the average tile time, and whichever copy arrives first is used
+const double FARM_STRAGGLER_FACTOR = 4.0;
+const double FARM_MIN_STRAGGLER_SECONDS = 0.05;
+const int FARM_POLL_MS = 5;
+// Workers retry connecting this often, for this long, so they can be started before the coordinator
+const int FARM_CONNECT_RETRY_MS = 100;
+const int FARM_CONNECT_ATTEMPTS = 100;
+
+struct FarmFrame {
+    Uint32 frameIndex;
+    int width;
+    int height;
+    glm::vec3 origin;
+    float yaw;
+    float pitch;
+};
+
+// Coordinator side of the tile farm: hands the tiles of each frame to worker processes over sockets
+// and gathers their radiance into the frame. Tiles of dropped workers go back into the queue, slow
+// tiles are traced a second time by idle workers, and whatever is left once no worker is connected
+// is handed back to the caller to trace locally. Workers and per-frame state are sized up front, so
+// a frame doesn't allocate.
+class TileCoordinator {
+    private:
+        struct QueuedTile {
+            Uint32 frameIndex;
+            int tile;
+            double sentAt;
+        };
+
+        struct Worker {
+            Socket socket;
+            // 0 until its TileHello arrives
+            unsigned threads = 0;
+            QueuedTile queued[FARM_MAX_QUEUED_TILES];
+            int queuedCount = 0;
+            double connectedAt = 0.0;
+            // When it was sent its first tile, throughput is measured from there
+            double firstTileAt = -1.0;
+            double disconnectedAt = 0.0;
+            // Last message from it, or when it was last given tiles while it had none
+            double lastMessageAt = 0.0;
+            Uint64 tiles = 0;
+            Uint64 pixels = 0;
+            double tileSeconds = 0.0;
+            // Its results that came in after another copy of the tile, and tiles taken back when it was dropped
+            Uint64 lateTiles = 0;
+            Uint64 reassignedTiles = 0;
+            const char* dropReason = nullptr;
+
+            bool Alive() const { return socket.Valid(); }
+        };
+
+        struct TileState {
+            int copies = 0;
+            double assignedAt = 0.0;
+            bool done = false;
+        };
+
+        Socket listener;
+        std::string address;
+        int tileSize = 0;
+        Uint64 sceneHash = 0;
+        std::chrono::steady_clock::time_point startTime;
+        std::vector<Worker> workers;
+        std::vector<TileState> tiles;
+        std::vector<float> pixelBuffer;
+        FarmFrame frame = {};
+        int tilesX = 0;
+        int tileCount = 0;
+        int doneTiles = 0;
+        // Every tile before this one is assigned or done
+        int nextPendingTile = 0;
+        Uint64 completedTiles = 0;
+        double completedTileSeconds = 0.0;
+
+        double Now() const;
+        void AcceptWorkers();
+        void DropWorker(Worker& worker, const char* reason);
+        int LiveWorkers() const;
+        int NextPendingTile();
+        int StragglerTile(const Worker& worker, double now) const;
+        void AssignTiles(double now);
+        void ReceiveMessage(Worker& worker, HdrFramebuffer& target);
+        bool ReceiveHello(Worker& worker, Uint32 size);
+        bool ReceiveResult(Worker& worker, Uint32 size, HdrFramebuffer& target);
+
+    public:
+        // Listens for workers on address. Frames may be up to maxWidth x maxHeight and are split into
+        // tileSize tiles; workers whose scene hash differs from sceneHash are turned away.
+        bool Listen(const std::string& address, int maxWidth, int maxHeight, int tileSize, Uint64 sceneHash, std::string& error);
+        // Blocks until count workers have connected and introduced themselves
+        void WaitForWorkers(int count);
+
+        // Traces every tile of frame into target on the workers. If the last worker is lost, returns the
+        // number of tiles left undone and writes their indices to localTiles (room for every tile of a
+        // maxWidth x maxHeight frame), otherwise returns 0.
+        int TraceFrame(const FarmFrame& frame, HdrFramebuffer& target, int* localTiles);
+
+        void PrintStats() const;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef TILEPROTOCOL_H
+#define TILEPROTOCOL_H
+
+#include "Socket.h"
+#include <SDL2/SDL.h>
+
+// Messages between a tile farm coordinator and its workers. Each is a TileMessageHeader followed by
+// a payload struct in the sender's memory layout, so both ends must be builds of the same version
+// for the same architecture, which the protocol version and scene hash in TileHello check for.
+const Uint32 TILE_PROTOCOL_VERSION = 2;
+
+enum TileMessageType : Uint32 {
+    // Worker to coordinator once connected: TileHello
+    TILE_HELLO = 1,
+    // Coordinator to worker: TileRequest
+    TILE_REQUEST = 2,
+    // Worker to coordinator: TileResult followed by pixelCount linear RGB float triples in row order
+    TILE_RESULT = 3
+};
+
+struct TileMessageHeader {
+    Uint32 type;
+    // Bytes following the header
+    Uint32 size;
+};
+
+struct TileHello {
+    Uint32 version;
+    Uint32 threads;
+    // Hash of the worker's scene and shading settings, which must equal the coordinator's
+    Uint64 sceneHash;
+};
+
+// Trace tile tileIndex of a width x height frame, TILE_SIZE tiles numbered row by row
+struct TileRequest {
+    Uint32 frameIndex;
+    Sint32 width;
+    Sint32 height;
+    Sint32 tileIndex;
+    // Camera pose, see Camera::SetPose
+    float origin[3];
+    float yaw;
+    float pitch;
+};
+
+struct TileResult {
+    Uint32 frameIndex;
+    Sint32 tileIndex;
+    Sint32 pixelCount;
+};
+
+// Sends a message with a fixed-size payload in a single write
+template <typename Payload>
+bool SendTileMessage(Socket& socket, TileMessageType type, const Payload& payload) {
+    struct {
+        TileMessageHeader header;
+        Payload payload;
+    } message = {{(Uint32)type, (Uint32)sizeof(Payload)}, payload};
+    return socket.SendAll(&message, sizeof(message));
+}
+
+#endif
@@ -0,0 +1,38 @@
+#include "Framebuffer.h"
+#include <utility>
+
+void Framebuffer::Resize(int width, int height) {
+    this->width = width;
+    this->height = height;
+    pixels.assign((size_t)width * height, 0xFF000000);
+}
+
+void HdrFramebuffer::Resize(int width, int height) {
+    this->width = width;
+    this->height = height;
+    pixels.assign((size_t)width * height, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+void TripleBuffer::Resize(int width, int height) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& buffer : buffers) {
+        buffer.Resize(width, height);
+    }
+    hasNewFrame = false;
+}
+
+void TripleBuffer::Publish() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::swap(backIndex, readyIndex);
+    hasNewFrame = true;
+}
+
+bool TripleBuffer::AcquireLatest() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!hasNewFrame) {
+        return false;
+    }
+    std::swap(frontIndex, readyIndex);
+    hasNewFrame = false;
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <SDL2/SDL.h>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <vector>
+
+// Pixels are packed as SDL_PIXELFORMAT_ARGB8888
+struct Framebuffer {
+    int width = 0;
+    int height = 0;
+    std::vector<Uint32> pixels;
+
+    void Resize(int width, int height);
+    int Pitch() const { return width * (int)sizeof(Uint32); }
+    void SetPixel(int x, int y, SDL_Color color) {
+        pixels[y * width + x] = ((Uint32)color.a << 24) | ((Uint32)color.r << 16) | ((Uint32)color.g << 8) | (Uint32)color.b;
+    }
+};
+
+// Linear float radiance. Pixels are four floats (alpha unused) so a pixel loads straight into a SIMD register.
+struct HdrFramebuffer {
+    int width = 0;
+    int height = 0;
+    std::vector<glm::vec4> pixels;
+
+    void Resize(int width, int height);
+    glm::vec3 GetPixel(int x, int y) const { return glm::vec3(pixels[(size_t)y * width + x]); }
+    void SetPixel(int x, int y, glm::vec3 radiance) { pixels[(size_t)y * width + x] = glm::vec4(radiance, 1.0f); }
+};
+
+// Hands finished frames from the render thread to the presenting thread.
+// The render thread always owns the back buffer, the presenter always owns the front buffer,
+// and the middle buffer holds the newest finished frame, so neither side ever waits on the other.
+class TripleBuffer {
+    private:
+        Framebuffer buffers[3];
+        int backIndex = 0;
+        int readyIndex = 1;
+        int frontIndex = 2;
+        bool hasNewFrame = false;
+        std::mutex mutex;
+
+    public:
+        void Resize(int width, int height);
+
+        Framebuffer& Back() { return buffers[backIndex]; }
+        const Framebuffer& Front() const { return buffers[frontIndex]; }
+
+        // Render thread: marks the back buffer as the newest finished frame
+        void Publish();
+        // Presenter: moves the newest finished frame to the front, returns false if there was none
+        bool AcquireLatest();
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "PpmFile.h"
+#include <fstream>
+#include <vector>
+
+bool WritePpm(const std::string& path, const Framebuffer& frame) {
+    std::vector<unsigned char> data;
+    EncodePpm(frame, data);
+    std::ofstream file(path, std::ios::binary);
+    return file && file.write((const char*)data.data(), data.size());
+}
+
+void EncodePpm(const Framebuffer& frame, std::vector<unsigned char>& out) {
+    std::string header = "P6\n" + std::to_string(frame.width) + " " + std::to_string(frame.height) + "\n255\n";
+    out.insert(out.end(), header.begin(), header.end());
+    size_t start = out.size();
+    out.resize(start + frame.pixels.size() * 3);
+    unsigned char* data = &out[start];
+    for (size_t i = 0; i < frame.pixels.size(); i++) {
+        Uint32 pixel = frame.pixels[i];
+        data[i * 3] = (unsigned char)(pixel >> 16);
+        data[i * 3 + 1] = (unsigned char)(pixel >> 8);
+        data[i * 3 + 2] = (unsigned char)pixel;
+    }
+}
+
+// Reads the next header number, skipping whitespace and # comments
+static bool ReadHeaderValue(std::istream& file, int& value) {
+    while (file) {
+        int next = file.peek();
+        if (next == '#') {
+            file.ignore(1 << 16, '\n');
+        } else if (next == ' ' || next == '\t' || next == '\r' || next == '\n') {
+            file.get();
+        } else {
+            break;
+        }
+    }
+    return (bool)(file >> value);
+}
+
+bool ReadPpm(const std::string& path, Framebuffer& frame) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[2] = {};
+    if (!file.read(magic, 2) || magic[0] != 'P' || magic[1] != '6') {
+        return false;
+    }
+    int width, height, maxValue;
+    if (!ReadHeaderValue(file, width) || !ReadHeaderValue(file, height) || !ReadHeaderValue(file, maxValue) ||
+        width <= 0 || height <= 0 || maxValue != 255) {
+        return false;
+    }
+    // A single whitespace character separates the header from the pixels
+    file.get();
+
+    std::vector<unsigned char> data((size_t)width * height * 3);
+    if (!file.read((char*)data.data(), data.size())) {
+        return false;
+    }
+    frame.Resize(width, height);
+    for (size_t i = 0; i < frame.pixels.size(); i++) {
+        frame.pixels[i] = 0xFF000000 | ((Uint32)data[i * 3] << 16) | ((Uint32)data[i * 3 + 1] << 8) | (Uint32)data[i * 3 + 2];
+    }
+    return true;
+}
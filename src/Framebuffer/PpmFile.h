@@ -0,0 +1,16 @@
+#ifndef PPMFILE_H
+#define PPMFILE_H
+
+#include "Framebuffer.h"
+#include <string>
+#include <vector>
+
+// Binary 8-bit RGB PPM (P6), the simplest format any image viewer or diff tool reads.
+// Alpha is dropped on write and set opaque on read.
+bool WritePpm(const std::string& path, const Framebuffer& frame);
+// Appends the whole file to out
+void EncodePpm(const Framebuffer& frame, std::vector<unsigned char>& out);
+// Resizes frame to the file's dimensions, returns false for missing or malformed files
+bool ReadPpm(const std::string& path, Framebuffer& frame);
+
+#endif
@@ -0,0 +1,114 @@
+#include "ToneMapper.h"
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Linear [0, 1] is quantized to this many steps before the sRGB lookup, fine enough that dark gradients don't band
+static const int SRGB_TABLE_SIZE = 8192;
+
+static const Uint8* SrgbTable() {
+    static Uint8 table[SRGB_TABLE_SIZE];
+    static bool initialized = [] {
+        for (int i = 0; i < SRGB_TABLE_SIZE; i++) {
+            table[i] = (Uint8)(ToneMapper::LinearToSrgb((float)i / (SRGB_TABLE_SIZE - 1)) * 255.0f + 0.5f);
+        }
+        return true;
+    }();
+    (void)initialized;
+    return table;
+}
+
+float ToneMapper::SrgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float ToneMapper::LinearToSrgb(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+void ToneMapper::Configure(ToneMapOperator toneMapOperator, float exposure) {
+    this->toneMapOperator = toneMapOperator;
+    this->exposure = exposure;
+}
+
+static inline Uint32 PackPixel(const Uint8* table, int r, int g, int b) {
+    return 0xFF000000 | ((Uint32)table[r] << 16) | ((Uint32)table[g] << 8) | (Uint32)table[b];
+}
+
+static inline float MapChannel(float value, ToneMapOperator toneMapOperator) {
+    switch (toneMapOperator) {
+        case ToneMapOperator::Reinhard:
+            return value / (1.0f + value);
+        case ToneMapOperator::Aces:
+            return (value * (2.51f * value + 0.03f)) / (value * (2.43f * value + 0.59f) + 0.14f);
+        default:
+            return value;
+    }
+}
+
+static inline int TableIndex(float value) {
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return (int)(value * (SRGB_TABLE_SIZE - 1) + 0.5f);
+}
+
+#if defined(__SSE2__)
+static inline __m128 MapChannels(__m128 value, ToneMapOperator toneMapOperator) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    switch (toneMapOperator) {
+        case ToneMapOperator::Reinhard:
+            return _mm_div_ps(value, _mm_add_ps(one, value));
+        case ToneMapOperator::Aces: {
+            __m128 numerator = _mm_mul_ps(value, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), value), _mm_set1_ps(0.03f)));
+            __m128 denominator = _mm_add_ps(_mm_mul_ps(value, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), value), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f));
+            return _mm_div_ps(numerator, denominator);
+        }
+        default:
+            return value;
+    }
+}
+
+static inline __m128i TableIndices(__m128 value) {
+    value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps((float)(SRGB_TABLE_SIZE - 1))));
+}
+#endif
+
+void ToneMapper::MapRows(const HdrFramebuffer& source, Framebuffer& target, int width, int rowBegin, int rowEnd) const {
+    const Uint8* table = SrgbTable();
+
+    for (int y = rowBegin; y < rowEnd; y++) {
+        const glm::vec4* in = &source.pixels[(size_t)y * source.width];
+        Uint32* out = &target.pixels[(size_t)y * target.width];
+        int x = 0;
+
+#if defined(__SSE2__)
+        // Transpose four RGBA pixels into R, G and B registers, one lane per pixel
+        const __m128 scale = _mm_set1_ps(exposure);
+        alignas(16) int r[4], g[4], b[4];
+        for (; x + 4 <= width; x += 4) {
+            __m128 p0 = _mm_loadu_ps(&in[x].x);
+            __m128 p1 = _mm_loadu_ps(&in[x + 1].x);
+            __m128 p2 = _mm_loadu_ps(&in[x + 2].x);
+            __m128 p3 = _mm_loadu_ps(&in[x + 3].x);
+            _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+            _mm_store_si128((__m128i*)r, TableIndices(MapChannels(_mm_mul_ps(p0, scale), toneMapOperator)));
+            _mm_store_si128((__m128i*)g, TableIndices(MapChannels(_mm_mul_ps(p1, scale), toneMapOperator)));
+            _mm_store_si128((__m128i*)b, TableIndices(MapChannels(_mm_mul_ps(p2, scale), toneMapOperator)));
+            for (int i = 0; i < 4; i++) {
+                out[x + i] = PackPixel(table, r[i], g[i], b[i]);
+            }
+        }
+#endif
+
+        for (; x < width; x++) {
+            glm::vec3 value = glm::vec3(in[x]) * exposure;
+            out[x] = PackPixel(table,
+                TableIndex(MapChannel(value.r, toneMapOperator)),
+                TableIndex(MapChannel(value.g, toneMapOperator)),
+                TableIndex(MapChannel(value.b, toneMapOperator)));
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef TONEMAPPER_H
+#define TONEMAPPER_H
+
+#include "Framebuffer.h"
+
+enum class ToneMapOperator {
+    Clamp,
+    Reinhard,
+    // Narkowicz's fit of the ACES filmic curve
+    Aces
+};
+
+// Converts linear HDR radiance to sRGB encoded ARGB8888 for display.
+// Exposure and the curve run four pixels at a time in SSE registers, the sRGB encode is a table lookup.
+class ToneMapper {
+    private:
+        ToneMapOperator toneMapOperator = ToneMapOperator::Clamp;
+        float exposure = 1.0f;
+
+    public:
+        void Configure(ToneMapOperator toneMapOperator, float exposure);
+
+        // Maps the first width pixels of rows [rowBegin, rowEnd), safe to call concurrently for disjoint rows
+        void MapRows(const HdrFramebuffer& source, Framebuffer& target, int width, int rowBegin, int rowEnd) const;
+
+        static float SrgbToLinear(float value);
+        static float LinearToSrgb(float value);
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "ClusterGrid.h"
+#include <algorithm>
+
+int ClusterGrid::Slice(float depth) const {
+    if (depth <= view.ViewportDepth()) {
+        return 0;
+    }
+    return glm::min((int)(glm::log(depth / view.ViewportDepth()) * sliceScale), CLUSTER_DEPTH_SLICES - 1);
+}
+
+// Conservative cluster bounds of a light's sphere of influence. Returns false if it lies entirely behind the near plane.
+bool ClusterGrid::ClusterRange(glm::vec3 position, float r, int& tileX0, int& tileY0, int& tileX1, int& tileY1, int& slice0, int& slice1) const {
+    glm::vec3 relative = position - view.Position();
+    float x = glm::dot(relative, view.Right());
+    float y = glm::dot(relative, view.Up());
+    float z = glm::dot(relative, view.Forward());
+    if (z + r < view.ViewportDepth()) {
+        return false;
+    }
+    slice0 = Slice(z - r);
+    slice1 = Slice(z + r);
+
+    tileX0 = 0;
+    tileY0 = 0;
+    tileX1 = tilesX - 1;
+    tileY1 = tilesY - 1;
+    if (z - r <= view.ViewportDepth()) {
+        return true;
+    }
+
+    // The sphere fits in the box x +- r, y +- r, z +- r, whose corners bound its projection
+    float pixelsPerUnitX = view.ViewportDepth() * view.CanvasWidth() / view.ViewportWidth();
+    float pixelsPerUnitY = view.ViewportDepth() * view.CanvasHeight() / view.ViewportHeight();
+    float minX = glm::min((x - r) / (z - r), (x - r) / (z + r)) * pixelsPerUnitX;
+    float maxX = glm::max((x + r) / (z - r), (x + r) / (z + r)) * pixelsPerUnitX;
+    float minY = glm::min((y - r) / (z - r), (y - r) / (z + r)) * pixelsPerUnitY;
+    float maxY = glm::max((y + r) / (z - r), (y + r) / (z + r)) * pixelsPerUnitY;
+
+    // Canvas to screen pixels, widened by a pixel for sub-pixel sample offsets
+    float screenX0 = minX + view.CanvasWidth() / 2 - 1.0f;
+    float screenX1 = maxX + view.CanvasWidth() / 2 + 1.0f;
+    float screenY0 = view.CanvasHeight() / 2 - maxY - 1.0f;
+    float screenY1 = view.CanvasHeight() / 2 - minY + 1.0f;
+    if (screenX1 < 0.0f || screenY1 < 0.0f || screenX0 >= view.CanvasWidth() || screenY0 >= view.CanvasHeight()) {
+        return false;
+    }
+    tileX0 = glm::max((int)screenX0, 0) / CLUSTER_TILE_SIZE;
+    tileY0 = glm::max((int)screenY0, 0) / CLUSTER_TILE_SIZE;
+    tileX1 = glm::min((int)screenX1 / CLUSTER_TILE_SIZE, tilesX - 1);
+    tileY1 = glm::min((int)screenY1 / CLUSTER_TILE_SIZE, tilesY - 1);
+    return true;
+}
+
+void ClusterGrid::Reserve(int maxWidth, int maxHeight) {
+    int maxClusters = ((maxWidth + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE) *
+        ((maxHeight + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE) * CLUSTER_DEPTH_SLICES;
+    counts.reserve(maxClusters);
+    offsets.reserve(maxClusters + 1);
+}
+
+void ClusterGrid::ReleaseFrameMemory() {
+    ReleaseFrameVector(lightIndices);
+}
+
+void ClusterGrid::Build(const LightSet& lightSet, const Camera& view) {
+    this->view = view;
+    tilesX = (view.CanvasWidth() + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+    tilesY = (view.CanvasHeight() + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+    sliceScale = CLUSTER_DEPTH_SLICES / glm::log(CLUSTER_FAR_DEPTH / view.ViewportDepth());
+
+    int clusterCount = ClusterCount();
+    counts.assign(clusterCount, 0);
+    offsets.resize(clusterCount + 1);
+
+    // Count, prefix sum, then fill the flattened per-cluster lists
+    for (int pass = 0; pass < 2; pass++) {
+        const LightArrays& ranged = lightSet.ranged;
+        for (int index = 0; index < ranged.Count(); index++) {
+            int tileX0, tileY0, tileX1, tileY1, slice0, slice1;
+            glm::vec3 position(ranged.x[index], ranged.y[index], ranged.z[index]);
+            if (!ClusterRange(position, lightSet.rangedRadii[index], tileX0, tileY0, tileX1, tileY1, slice0, slice1)) {
+                continue;
+            }
+            for (int slice = slice0; slice <= slice1; slice++) {
+                for (int tileY = tileY0; tileY <= tileY1; tileY++) {
+                    for (int tileX = tileX0; tileX <= tileX1; tileX++) {
+                        int cluster = (slice * tilesY + tileY) * tilesX + tileX;
+                        if (pass == 0) {
+                            counts[cluster]++;
+                        } else {
+                            lightIndices[offsets[cluster] + counts[cluster]++] = index;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (pass == 0) {
+            offsets[0] = 0;
+            for (int cluster = 0; cluster < clusterCount; cluster++) {
+                offsets[cluster + 1] = offsets[cluster] + counts[cluster];
+            }
+            lightIndices.resize(offsets[clusterCount]);
+            std::fill(counts.begin(), counts.end(), 0);
+        }
+    }
+}
+
+int ClusterGrid::TileIndex(int sX, int sY) const {
+    return (sY / CLUSTER_TILE_SIZE) * tilesX + sX / CLUSTER_TILE_SIZE;
+}
+
+const int* ClusterGrid::Lights(int tileIndex, glm::vec3 P, int& count) const {
+    int cluster = Slice(glm::dot(P - view.Position(), view.Forward())) * tilesX * tilesY + tileIndex;
+    count = offsets[cluster + 1] - offsets[cluster];
+    return lightIndices.data() + offsets[cluster];
+}
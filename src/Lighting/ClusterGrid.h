@@ -0,0 +1,46 @@
+#ifndef CLUSTERGRID_H
+#define CLUSTERGRID_H
+
+#include "../Camera/Camera.h"
+#include "../Memory/FrameArena.h"
+#include "LightSet.h"
+#include <vector>
+
+const int CLUSTER_TILE_SIZE = 32;
+const int CLUSTER_DEPTH_SLICES = 16;
+// View depth where the last depth slice starts, it extends to infinity
+const float CLUSTER_FAR_DEPTH = 100.0f;
+
+// Clustered light culling: the view frustum is cut into screen tiles and logarithmic depth slices,
+// and each cluster lists the finite-range point lights whose sphere of influence overlaps it,
+// as indices into LightSet::ranged.
+// Shading a primary hit then only has to look at the lights of its cluster.
+// How many lists a light lands in changes as the camera moves, so the lists live in frame memory
+// and are built again every frame.
+class ClusterGrid {
+    private:
+        // The camera the clusters are built for, prepared for the canvas they cover
+        Camera view;
+        int tilesX = 0;
+        int tilesY = 0;
+        float sliceScale = 0.0f;
+        std::vector<int> counts;
+        std::vector<int> offsets;
+        FrameVector<int> lightIndices;
+
+        int Slice(float depth) const;
+        bool ClusterRange(glm::vec3 position, float r, int& tileX0, int& tileY0, int& tileX1, int& tileY1, int& slice0, int& slice1) const;
+
+    public:
+        // Sizes the per-cluster counts for canvases up to maxWidth x maxHeight
+        void Reserve(int maxWidth, int maxHeight);
+        void Build(const LightSet& lightSet, const Camera& view);
+        // Drops the lists, before the frame arenas are reset
+        void ReleaseFrameMemory();
+        int TileIndex(int sX, int sY) const;
+        // Lights that can reach point P, which lies in the given screen tile
+        const int* Lights(int tileIndex, glm::vec3 P, int& count) const;
+        int ClusterCount() const { return tilesX * tilesY * CLUSTER_DEPTH_SLICES; }
+};
+
+#endif
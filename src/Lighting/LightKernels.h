@@ -0,0 +1,229 @@
+#ifndef LIGHTKERNELS_H
+#define LIGHTKERNELS_H
+
+#include "LightSet.h"
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Lights are shaded in batches: one branch-free pass over the SoA arrays computes every light's
+// unshadowed diffuse term and specular cosine, then shadow rays and the specular power are only
+// evaluated for lights that contribute at all. With SSE2 the pass takes four lights at a time, with
+// the operations of the scalar loop in the same order, so both give the same bits.
+const int LIGHT_BATCH_SIZE = 64;
+
+struct ShadingPoint {
+    glm::vec3 P;
+    glm::vec3 N;
+    glm::vec3 V;
+    float inverseLengthV;
+    // Specular exponent
+    float s;
+};
+
+// Per-light results of a kernel, light[k] indexes the LightArrays the batch was built from
+struct LightBatch {
+    int count;
+    int light[LIGHT_BATCH_SIZE];
+    // Intensity after range falloff
+    float weight[LIGHT_BATCH_SIZE];
+    float diffuse[LIGHT_BATCH_SIZE];
+    // R.V clamped to zero, raised to the specular exponent only for unshadowed lights
+    float specularCosine[LIGHT_BATCH_SIZE];
+};
+
+// Phong terms of a light in normalized direction (lx, ly, lz), matching the reference loop
+template <bool Specular>
+inline void PhongTerms(const ShadingPoint& point, float lx, float ly, float lz, float weight, LightBatch& batch, int k) {
+    float nDotL = point.N.x * lx + point.N.y * ly + point.N.z * lz;
+    batch.weight[k] = weight;
+    batch.diffuse[k] = nDotL > 0.0f ? weight * nDotL : 0.0f;
+    batch.specularCosine[k] = 0.0f;
+    if (Specular) {
+        // R = 2N(N.L) - L has unit length because N and L do
+        float rx = 2.0f * point.N.x * nDotL - lx;
+        float ry = 2.0f * point.N.y * nDotL - ly;
+        float rz = 2.0f * point.N.z * nDotL - lz;
+        float rDotV = (rx * point.V.x + ry * point.V.y + rz * point.V.z) * point.inverseLengthV;
+        batch.specularCosine[k] = rDotV > 0.0f ? rDotV : 0.0f;
+    }
+}
+
+// Unshadowed contribution of batch entry k
+template <bool Specular>
+inline float BatchContribution(const LightBatch& batch, int k, float s) {
+    float i = batch.diffuse[k];
+    if (Specular && batch.specularCosine[k] > 0.0f) {
+        i += batch.weight[k] * std::pow(batch.specularCosine[k], s);
+    }
+    return i;
+}
+
+// 1 / sqrt(x), exactly rounded like 1.0f / std::sqrt but without the errno check that keeps the loops
+// around it from being vectorized
+inline float InverseSqrt(float x) {
+#if defined(__SSE2__)
+    return _mm_cvtss_f32(_mm_div_ss(_mm_set_ss(1.0f), _mm_sqrt_ss(_mm_set_ss(x))));
+#else
+    return 1.0f / std::sqrt(x);
+#endif
+}
+
+#if defined(__SSE2__)
+// PhongTerms of four lights k..k+3, with the terms of lanes outside active set to zero
+template <bool Specular>
+inline void PhongTerms4(const ShadingPoint& point, __m128 lx, __m128 ly, __m128 lz, __m128 weight, __m128 active, LightBatch& batch, int k) {
+    const __m128 zero = _mm_setzero_ps();
+    __m128 nDotL = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(point.N.x), lx), _mm_mul_ps(_mm_set1_ps(point.N.y), ly)),
+        _mm_mul_ps(_mm_set1_ps(point.N.z), lz));
+    _mm_storeu_ps(batch.weight + k, weight);
+    _mm_storeu_ps(batch.diffuse + k, _mm_and_ps(_mm_and_ps(active, _mm_cmpgt_ps(nDotL, zero)), _mm_mul_ps(weight, nDotL)));
+    __m128 specularCosine = zero;
+    if (Specular) {
+        __m128 rx = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.0f * point.N.x), nDotL), lx);
+        __m128 ry = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.0f * point.N.y), nDotL), ly);
+        __m128 rz = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.0f * point.N.z), nDotL), lz);
+        __m128 rDotV = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, _mm_set1_ps(point.V.x)), _mm_mul_ps(ry, _mm_set1_ps(point.V.y))),
+            _mm_mul_ps(rz, _mm_set1_ps(point.V.z))), _mm_set1_ps(point.inverseLengthV));
+        specularCosine = _mm_and_ps(_mm_and_ps(active, _mm_cmpgt_ps(rDotV, zero)), rDotV);
+    }
+    _mm_storeu_ps(batch.specularCosine + k, specularCosine);
+}
+
+inline __m128 InverseSqrt4(__m128 x) {
+    return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(x));
+}
+
+// values[light[0..3]], or the four values from light[0] on when contiguous
+inline __m128 LoadLights4(const std::vector<float>& values, const int* light, bool contiguous) {
+    if (contiguous) {
+        return _mm_loadu_ps(values.data() + light[0]);
+    }
+    return _mm_setr_ps(values[light[0]], values[light[1]], values[light[2]], values[light[3]]);
+}
+#endif
+
+// With SSE2 the kernels take four lights per step and finish the last few of a batch in the scalar loop
+template <bool Specular>
+inline void DirectionalBatch(const LightArrays& lights, int begin, int count, const ShadingPoint& point, LightBatch& batch) {
+    int k = 0;
+#if defined(__SSE2__)
+    const __m128 active = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (; k + 4 <= count; k += 4) {
+        for (int lane = 0; lane < 4; lane++) {
+            batch.light[k + lane] = begin + k + lane;
+        }
+        __m128 x = _mm_loadu_ps(lights.x.data() + begin + k);
+        __m128 y = _mm_loadu_ps(lights.y.data() + begin + k);
+        __m128 z = _mm_loadu_ps(lights.z.data() + begin + k);
+        __m128 inverseLength = InverseSqrt4(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        PhongTerms4<Specular>(point, _mm_mul_ps(x, inverseLength), _mm_mul_ps(y, inverseLength), _mm_mul_ps(z, inverseLength),
+            _mm_loadu_ps(lights.intensity.data() + begin + k), active, batch, k);
+    }
+#endif
+    const float* x = lights.x.data() + begin;
+    const float* y = lights.y.data() + begin;
+    const float* z = lights.z.data() + begin;
+    const float* intensity = lights.intensity.data() + begin;
+    for (; k < count; k++) {
+        float inverseLength = InverseSqrt(x[k] * x[k] + y[k] * y[k] + z[k] * z[k]);
+        batch.light[k] = begin + k;
+        PhongTerms<Specular>(point, x[k] * inverseLength, y[k] * inverseLength, z[k] * inverseLength, intensity[k], batch, k);
+    }
+    batch.count = count;
+}
+
+// Unlimited range point lights [begin, begin + count)
+template <bool Specular>
+inline void PointBatch(const LightArrays& lights, int begin, int count, const ShadingPoint& point, LightBatch& batch) {
+    int k = 0;
+#if defined(__SSE2__)
+    const __m128 active = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    const __m128 px = _mm_set1_ps(point.P.x);
+    const __m128 py = _mm_set1_ps(point.P.y);
+    const __m128 pz = _mm_set1_ps(point.P.z);
+    for (; k + 4 <= count; k += 4) {
+        for (int lane = 0; lane < 4; lane++) {
+            batch.light[k + lane] = begin + k + lane;
+        }
+        __m128 lx = _mm_sub_ps(_mm_loadu_ps(lights.x.data() + begin + k), px);
+        __m128 ly = _mm_sub_ps(_mm_loadu_ps(lights.y.data() + begin + k), py);
+        __m128 lz = _mm_sub_ps(_mm_loadu_ps(lights.z.data() + begin + k), pz);
+        __m128 inverseDistance = InverseSqrt4(_mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz)));
+        PhongTerms4<Specular>(point, _mm_mul_ps(lx, inverseDistance), _mm_mul_ps(ly, inverseDistance), _mm_mul_ps(lz, inverseDistance),
+            _mm_loadu_ps(lights.intensity.data() + begin + k), active, batch, k);
+    }
+#endif
+    const float* x = lights.x.data() + begin;
+    const float* y = lights.y.data() + begin;
+    const float* z = lights.z.data() + begin;
+    const float* intensity = lights.intensity.data() + begin;
+    for (; k < count; k++) {
+        float lx = x[k] - point.P.x;
+        float ly = y[k] - point.P.y;
+        float lz = z[k] - point.P.z;
+        float inverseDistance = InverseSqrt(lx * lx + ly * ly + lz * lz);
+        batch.light[k] = begin + k;
+        PhongTerms<Specular>(point, lx * inverseDistance, ly * inverseDistance, lz * inverseDistance, intensity[k], batch, k);
+    }
+    batch.count = count;
+}
+
+// Ranged point lights [begin, begin + count), or indices[begin..] when indices is given, scaled by the
+// (1 - (d/r)^4)^2 window. The range test is a mask: lights out of range get zero terms, so visitors skip
+// them, and a group of four with none in range is left out of the batch altogether.
+template <bool Specular>
+inline void RangedBatch(const LightArrays& lights, const int* indices, int begin, int count, const ShadingPoint& point, LightBatch& batch) {
+    int k = 0;
+    int out = 0;
+#if defined(__SSE2__)
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 px = _mm_set1_ps(point.P.x);
+    const __m128 py = _mm_set1_ps(point.P.y);
+    const __m128 pz = _mm_set1_ps(point.P.z);
+    for (; k + 4 <= count; k += 4) {
+        int light[4];
+        for (int lane = 0; lane < 4; lane++) {
+            light[lane] = indices ? indices[begin + k + lane] : begin + k + lane;
+        }
+        __m128 lx = _mm_sub_ps(LoadLights4(lights.x, light, !indices), px);
+        __m128 ly = _mm_sub_ps(LoadLights4(lights.y, light, !indices), py);
+        __m128 lz = _mm_sub_ps(LoadLights4(lights.z, light, !indices), pz);
+        __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz));
+        __m128 ratio = _mm_mul_ps(distanceSquared, LoadLights4(lights.inverseRadiusSquared, light, !indices));
+        __m128 inRange = _mm_cmplt_ps(ratio, one);
+        if (_mm_movemask_ps(inRange) == 0) {
+            continue;
+        }
+        __m128 inverseDistance = InverseSqrt4(distanceSquared);
+        __m128 window = _mm_sub_ps(one, _mm_mul_ps(ratio, ratio));
+        __m128 weight = _mm_and_ps(inRange, _mm_mul_ps(_mm_mul_ps(LoadLights4(lights.intensity, light, !indices), window), window));
+        for (int lane = 0; lane < 4; lane++) {
+            batch.light[out + lane] = light[lane];
+        }
+        PhongTerms4<Specular>(point, _mm_mul_ps(lx, inverseDistance), _mm_mul_ps(ly, inverseDistance), _mm_mul_ps(lz, inverseDistance),
+            weight, inRange, batch, out);
+        out += 4;
+    }
+#endif
+    // Each light is written to the next entry, which only moves on if it is in range
+    for (; k < count; k++) {
+        int light = indices ? indices[begin + k] : begin + k;
+        float lx = lights.x[light] - point.P.x;
+        float ly = lights.y[light] - point.P.y;
+        float lz = lights.z[light] - point.P.z;
+        float distanceSquared = lx * lx + ly * ly + lz * lz;
+        float inverseDistance = InverseSqrt(distanceSquared);
+        float ratio = distanceSquared * lights.inverseRadiusSquared[light];
+        float window = 1.0f - ratio * ratio;
+        batch.light[out] = light;
+        PhongTerms<Specular>(point, lx * inverseDistance, ly * inverseDistance, lz * inverseDistance, lights.intensity[light] * window * window, batch, out);
+        out += ratio < 1.0f;
+    }
+    batch.count = out;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#include "LightSet.h"
+
+void LightArrays::Clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    intensity.clear();
+    inverseRadiusSquared.clear();
+}
+
+static void Append(LightArrays& arrays, glm::vec3 value, float intensity) {
+    arrays.x.push_back(value.x);
+    arrays.y.push_back(value.y);
+    arrays.z.push_back(value.z);
+    arrays.intensity.push_back(intensity);
+}
+
+void LightSet::Build(const std::vector<Light>& lights) {
+    ambient = 0.0f;
+    directional.Clear();
+    point.Clear();
+    ranged.Clear();
+    rangedRadii.clear();
+
+    for (const Light& light : lights) {
+        switch (light.type) {
+            case LightType::Ambient:
+                ambient += light.intensity;
+                break;
+            case LightType::Directional:
+                Append(directional, light.direction, light.intensity);
+                break;
+            case LightType::Point:
+                if (light.radius > 0.0f) {
+                    Append(ranged, light.position, light.intensity);
+                    ranged.inverseRadiusSquared.push_back(1.0f / (light.radius * light.radius));
+                    rangedRadii.push_back(light.radius);
+                } else {
+                    Append(point, light.position, light.intensity);
+                }
+                break;
+        }
+    }
+}
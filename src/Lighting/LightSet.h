@@ -0,0 +1,36 @@
+#ifndef LIGHTSET_H
+#define LIGHTSET_H
+
+#include "../Scene/Light.h"
+#include <vector>
+
+// One light type in structure-of-arrays form. x/y/z hold the direction (as given, not normalized,
+// so shadow rays match the reference loop) for directional lights and the position for point lights.
+struct LightArrays {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> intensity;
+    // Ranged point lights only
+    std::vector<float> inverseRadiusSquared;
+
+    int Count() const { return (int)intensity.size(); }
+    void Clear();
+};
+
+// A scene's lights split by type, rebuilt once per frame, so the shading kernels never branch on
+// the light type and ambient light is a single precomputed sum.
+class LightSet {
+    public:
+        float ambient = 0.0f;
+        LightArrays directional;
+        // Point lights with unlimited range
+        LightArrays point;
+        // Point lights with a falloff radius, in the order ClusterGrid lists refer to
+        LightArrays ranged;
+        std::vector<float> rangedRadii;
+
+        void Build(const std::vector<Light>& lights);
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "LightTree.h"
+#include <algorithm>
+#include <cfloat>
+
+// Keeps every light selectable, so lights the cone bound rules out (which can still add specular) stay unbiased
+static const float MIN_ORIENTATION_WEIGHT = 0.01f;
+
+void LightTree::Build(const std::vector<Light>& lights) {
+    nodes.clear();
+    buildOrder.clear();
+    for (int i = 0; i < (int)lights.size(); i++) {
+        if (lights[i].type == LightType::Point && lights[i].radius <= .0f) {
+            buildOrder.push_back(i);
+        }
+    }
+    if (buildOrder.empty()) {
+        return;
+    }
+
+    // Children are appended as the tree is built, reserving keeps node references valid
+    nodes.reserve(buildOrder.size() * 2 - 1);
+    nodes.emplace_back();
+    BuildNode(0, 0, (int)buildOrder.size(), lights);
+}
+
+void LightTree::BuildNode(int nodeIndex, int begin, int end, const std::vector<Light>& lights) {
+    Node& node = nodes[nodeIndex];
+    node.boundsMin = glm::vec3(FLT_MAX);
+    node.boundsMax = glm::vec3(-FLT_MAX);
+    node.intensity = 0.0f;
+    for (int i = begin; i < end; i++) {
+        const Light& light = lights[buildOrder[i]];
+        node.boundsMin = glm::min(node.boundsMin, light.position);
+        node.boundsMax = glm::max(node.boundsMax, light.position);
+        node.intensity += light.intensity;
+    }
+
+    if (end - begin == 1) {
+        node.child = -1;
+        node.lightIndex = buildOrder[begin];
+        return;
+    }
+
+    // Median split along the longest axis
+    glm::vec3 extent = node.boundsMax - node.boundsMin;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    int middle = (begin + end) / 2;
+    std::nth_element(buildOrder.begin() + begin, buildOrder.begin() + middle, buildOrder.begin() + end,
+        [&](int a, int b) { return lights[a].position[axis] < lights[b].position[axis]; });
+
+    int left = (int)nodes.size();
+    node.child = left;
+    node.lightIndex = -1;
+    nodes.emplace_back();
+    nodes.emplace_back();
+    BuildNode(left, begin, middle, lights);
+    BuildNode(left + 1, middle, end, lights);
+}
+
+// Summed intensity scaled by the largest cosine any point in the node's bounding sphere can make with N.
+// Point lights here have no distance falloff, so orientation is the only thing that varies with P.
+float LightTree::Importance(const Node& node, glm::vec3 P, glm::vec3 N) const {
+    glm::vec3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+    float radius = glm::length(node.boundsMax - node.boundsMin) * 0.5f;
+    glm::vec3 toCenter = center - P;
+    float distanceSquared = glm::dot(toCenter, toCenter);
+    if (distanceSquared <= radius * radius) {
+        return node.intensity;
+    }
+
+    float distance = glm::sqrt(distanceSquared);
+    float cosTheta = glm::dot(N, toCenter) / distance;
+    float sinAlpha = radius / distance;
+    float cosAlpha = glm::sqrt(1.0f - sinAlpha * sinAlpha);
+    float cosBound = 1.0f;
+    if (cosTheta < cosAlpha) {
+        float sinTheta = glm::sqrt(glm::max(0.0f, 1.0f - cosTheta * cosTheta));
+        cosBound = cosTheta * cosAlpha + sinTheta * sinAlpha;
+    }
+    return node.intensity * (glm::max(cosBound, 0.0f) + MIN_ORIENTATION_WEIGHT);
+}
+
+int LightTree::Sample(glm::vec3 P, glm::vec3 N, float u, float& pdf) const {
+    pdf = 1.0f;
+    if (nodes.empty()) {
+        return -1;
+    }
+
+    int nodeIndex = 0;
+    while (nodes[nodeIndex].child >= 0) {
+        int left = nodes[nodeIndex].child;
+        float leftImportance = Importance(nodes[left], P, N);
+        float rightImportance = Importance(nodes[left + 1], P, N);
+        float total = leftImportance + rightImportance;
+        if (total <= 0.0f) {
+            return -1;
+        }
+
+        // Reuse the remainder of u for the next level instead of drawing a new number
+        float leftProbability = leftImportance / total;
+        if (u < leftProbability) {
+            u /= leftProbability;
+            pdf *= leftProbability;
+            nodeIndex = left;
+        } else {
+            u = (u - leftProbability) / (1.0f - leftProbability);
+            pdf *= 1.0f - leftProbability;
+            nodeIndex = left + 1;
+        }
+        u = glm::min(u, 0.99999994f);
+    }
+    return nodes[nodeIndex].lightIndex;
+}
@@ -0,0 +1,39 @@
+#ifndef LIGHTTREE_H
+#define LIGHTTREE_H
+
+#include "../Scene/Light.h"
+#include <vector>
+
+// Bounding volume hierarchy over the point lights of a scene. Each node stores the bounds and summed
+// intensity of the lights below it, which is enough to estimate how much a whole group of lights can
+// contribute at a shading point and pick one light with probability proportional to that estimate.
+class LightTree {
+    private:
+        struct Node {
+            glm::vec3 boundsMin;
+            float intensity;
+            glm::vec3 boundsMax;
+            // Inner nodes: index of the left child, the right one follows it. Leaves: -1
+            int child;
+            // Leaves: index into the scene's light list. Inner nodes: -1
+            int lightIndex;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<int> buildOrder;
+
+        void BuildNode(int nodeIndex, int begin, int end, const std::vector<Light>& lights);
+        float Importance(const Node& node, glm::vec3 P, glm::vec3 N) const;
+
+    public:
+        // Indexes every unlimited range point light in lights, other lights are ignored
+        void Build(const std::vector<Light>& lights);
+        bool Empty() const { return nodes.empty(); }
+        int LightCount() const { return ((int)nodes.size() + 1) / 2; }
+
+        // Walks down the tree choosing children by importance. Returns the chosen light index and its
+        // selection probability in pdf, or -1 if no light can contribute. u is uniform in [0, 1).
+        int Sample(glm::vec3 P, glm::vec3 N, float u, float& pdf) const;
+};
+
+#endif
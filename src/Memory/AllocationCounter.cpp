@@ -0,0 +1,87 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> heapAllocations{0};
+static thread_local bool ignoreAllocations = false;
+
+uint64_t HeapAllocationCount() {
+    return heapAllocations.load(std::memory_order_relaxed);
+}
+
+void IgnoreThreadAllocations() {
+    ignoreAllocations = true;
+}
+
+static void CountAllocation() {
+    if (!ignoreAllocations) {
+        heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+static void* CountedAllocate(std::size_t size) {
+    CountAllocation();
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+static void* CountedAllocate(std::size_t size, std::align_val_t alignment) {
+    CountAllocation();
+    std::size_t align = (std::size_t)alignment;
+    // aligned_alloc wants a size that is a multiple of the alignment
+    if (void* memory = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) {
+    return CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return CountedAllocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return CountedAllocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return CountedAllocate(size, alignment);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
@@ -0,0 +1,15 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <cstdint>
+
+// Heap allocations made through operator new since startup, by every thread that has not opted out.
+// The count comes from replacing the global operator new, so it covers standard containers,
+// std::function and strings but not memory SDL or the C library take with malloc.
+uint64_t HeapAllocationCount();
+
+// Leaves the calling thread's allocations out of the count, for threads outside the renderer
+// (the presenting thread, whose graphics driver may allocate while a frame renders)
+void IgnoreThreadAllocations();
+
+#endif
@@ -0,0 +1,85 @@
+#include "FrameArena.h"
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+
+Arena::~Arena() {
+    while (first) {
+        Block* next = first->next;
+        std::free(first);
+        first = next;
+    }
+}
+
+// Moves on to the next kept block when it is big enough, otherwise inserts a new one after the current.
+// Blocks come straight from malloc, so arena growth is not counted as a heap allocation per frame.
+void Arena::NextBlock(size_t bytes, size_t alignment) {
+    size_t needed = sizeof(Block) + bytes + alignment;
+    Block* next = current ? current->next : first;
+    if (!next || next->size < needed) {
+        size_t size = needed > ARENA_BLOCK_SIZE ? needed : ARENA_BLOCK_SIZE;
+        Block* block = (Block*)std::malloc(size);
+        if (!block) {
+            throw std::bad_alloc();
+        }
+        block->size = size;
+        block->next = next;
+        if (current) {
+            current->next = block;
+        } else {
+            first = block;
+        }
+        reservedBytes += size;
+        growCount++;
+        next = block;
+    }
+    current = next;
+    cursor = (char*)(current + 1);
+    end = (char*)current + current->size;
+}
+
+void Arena::Reset() {
+    current = nullptr;
+    cursor = nullptr;
+    end = nullptr;
+}
+
+// Arenas belong to the registry rather than to their thread, so a reset never touches a destroyed one
+static std::mutex arenasMutex;
+static std::vector<std::unique_ptr<Arena>> arenas;
+
+Arena& ThreadArena() {
+    static thread_local Arena* arena = nullptr;
+    if (!arena) {
+        std::lock_guard<std::mutex> lock(arenasMutex);
+        arenas.push_back(std::make_unique<Arena>());
+        arena = arenas.back().get();
+    }
+    return *arena;
+}
+
+void ResetThreadArenas() {
+    std::lock_guard<std::mutex> lock(arenasMutex);
+    for (auto& arena : arenas) {
+        arena->Reset();
+    }
+}
+
+size_t ThreadArenaReservedBytes() {
+    std::lock_guard<std::mutex> lock(arenasMutex);
+    size_t bytes = 0;
+    for (auto& arena : arenas) {
+        bytes += arena->ReservedBytes();
+    }
+    return bytes;
+}
+
+int ThreadArenaGrowCount() {
+    std::lock_guard<std::mutex> lock(arenasMutex);
+    int count = 0;
+    for (auto& arena : arenas) {
+        count += arena->GrowCount();
+    }
+    return count;
+}
@@ -0,0 +1,105 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Blocks are at least this large, bigger allocations get a block of their own
+const size_t ARENA_BLOCK_SIZE = 1 << 20;
+
+// Bump allocator for data that lives no longer than a frame. Allocating moves a pointer along the
+// current block; nothing is freed individually, Reset rewinds to the first block instead. Blocks
+// are kept across resets, so once an arena has grown to a frame's high-water mark it stops asking
+// the heap for memory.
+class Arena {
+    private:
+        struct Block {
+            Block* next;
+            size_t size;
+        };
+
+        Block* first = nullptr;
+        Block* current = nullptr;
+        char* cursor = nullptr;
+        char* end = nullptr;
+        size_t reservedBytes = 0;
+        int growCount = 0;
+
+        static char* Align(char* pointer, size_t alignment) {
+            return (char*)(((size_t)pointer + alignment - 1) & ~(alignment - 1));
+        }
+        void NextBlock(size_t bytes, size_t alignment);
+
+    public:
+        Arena() = default;
+        ~Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* Allocate(size_t bytes, size_t alignment) {
+            char* memory = Align(cursor, alignment);
+            if (!cursor || memory + bytes > end) {
+                NextBlock(bytes, alignment);
+                memory = Align(cursor, alignment);
+            }
+            cursor = memory + bytes;
+            return memory;
+        }
+        void Reset();
+
+        size_t ReservedBytes() const { return reservedBytes; }
+        // Blocks taken from the heap since startup
+        int GrowCount() const { return growCount; }
+};
+
+// The calling thread's frame arena, created on first use
+Arena& ThreadArena();
+
+// Rewinds every thread's arena. Only call between frames, while no thread still uses memory from one:
+// containers holding arena memory have to be emptied first.
+void ResetThreadArenas();
+
+// Summed over every thread's arena
+size_t ThreadArenaReservedBytes();
+int ThreadArenaGrowCount();
+
+// Standard allocator over the frame arena of whichever thread allocates. Deallocating does nothing,
+// memory comes back when the arenas are reset.
+template <typename T>
+class FrameAllocator {
+    public:
+        using value_type = T;
+        using is_always_equal = std::true_type;
+
+        FrameAllocator() = default;
+        template <typename U>
+        FrameAllocator(const FrameAllocator<U>&) {}
+
+        T* allocate(size_t count) {
+            return static_cast<T*>(ThreadArena().Allocate(count * sizeof(T), alignof(T)));
+        }
+        void deallocate(T*, size_t) {}
+};
+
+template <typename T, typename U>
+bool operator==(const FrameAllocator<T>&, const FrameAllocator<U>&) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const FrameAllocator<T>&, const FrameAllocator<U>&) {
+    return false;
+}
+
+// Growable array in frame memory. It must be released (see ReleaseFrameVector) before the arenas
+// are reset, a FrameVector that outlives its frame points into memory the next frame reuses.
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+template <typename T>
+void ReleaseFrameVector(FrameVector<T>& vector) {
+    FrameVector<T>().swap(vector);
+}
+
+#endif
@@ -0,0 +1,161 @@
+#include "ColorConvert.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Fixed point BT.601 limited range: coefficients scaled by 256, with rounding
+static inline Uint8 Luma(int r, int g, int b) {
+    return (Uint8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline Uint8 ChromaU(int r, int g, int b) {
+    return (Uint8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline Uint8 ChromaV(int r, int g, int b) {
+    return (Uint8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// Converts the pixels of columns x and x + 1 in row0 and row1 (the same row for the last of an odd
+// height), writing luma1 only if it is not null
+static inline void ConvertBlock(const Uint32* row0, const Uint32* row1, int x, int width, Uint8* luma0, Uint8* luma1, Uint8* u, Uint8* v) {
+    int x1 = x + 1 < width ? x + 1 : x;
+    const Uint32 pixels[4] = {row0[x], row0[x1], row1[x], row1[x1]};
+    int r = 0, g = 0, b = 0;
+    for (int i = 0; i < 4; i++) {
+        int pr = (pixels[i] >> 16) & 0xFF;
+        int pg = (pixels[i] >> 8) & 0xFF;
+        int pb = pixels[i] & 0xFF;
+        r += pr;
+        g += pg;
+        b += pb;
+        Uint8 luma = Luma(pr, pg, pb);
+        if (i == 0) {
+            luma0[x] = luma;
+        } else if (i == 1 && x1 != x) {
+            luma0[x1] = luma;
+        } else if (i == 2 && luma1) {
+            luma1[x] = luma;
+        } else if (i == 3 && luma1 && x1 != x) {
+            luma1[x1] = luma;
+        }
+    }
+    r = (r + 2) >> 2;
+    g = (g + 2) >> 2;
+    b = (b + 2) >> 2;
+    u[x / 2] = ChromaU(r, g, b);
+    v[x / 2] = ChromaV(r, g, b);
+}
+
+#if defined(__SSE2__)
+// Splits eight packed ARGB pixels into R, G and B with one 16-bit lane per pixel
+static inline void UnpackChannels(const Uint32* pixels, __m128i& r, __m128i& g, __m128i& b) {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i p0 = _mm_loadu_si128((const __m128i*)pixels);
+    __m128i p1 = _mm_loadu_si128((const __m128i*)(pixels + 4));
+    r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+    g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    b = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+}
+
+// The sums fit 16 bits unsigned, so the wrapping multiplies and the logical shift give the exact result
+static inline __m128i LumaLanes(__m128i r, __m128i g, __m128i b) {
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+    sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+    return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+}
+
+// Averages each pair of lanes of the two rows' sums into four 2x2 block values, in the low four lanes
+static inline __m128i BlockAverage(__m128i rowSum) {
+    __m128i sum = _mm_madd_epi16(rowSum, _mm_set1_epi16(1));
+    sum = _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(2)), 2);
+    return _mm_packs_epi32(sum, sum);
+}
+
+// Chroma sums stay within +-28688, so signed 16-bit lanes and an arithmetic shift match the scalar code
+static inline __m128i ChromaLanes(__m128i r, __m128i g, __m128i b, short cr, short cg, short cb) {
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(cr)), _mm_mullo_epi16(g, _mm_set1_epi16(cg)));
+    sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(cb)), _mm_set1_epi16(128)));
+    return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+}
+#endif
+
+static void ConvertRows(const Framebuffer& frame, Uint8* yPlane, Uint8* uPlane, Uint8* vPlane, bool vectorized) {
+    int width = frame.width;
+    int height = frame.height;
+    int chromaWidth = (width + 1) / 2;
+    for (int y = 0; y < height; y += 2) {
+        const Uint32* row0 = &frame.pixels[(size_t)y * width];
+        const Uint32* row1 = y + 1 < height ? row0 + width : row0;
+        Uint8* luma0 = yPlane + (size_t)y * width;
+        Uint8* luma1 = y + 1 < height ? luma0 + width : nullptr;
+        Uint8* u = uPlane + (size_t)(y / 2) * chromaWidth;
+        Uint8* v = vPlane + (size_t)(y / 2) * chromaWidth;
+        int x = 0;
+
+#if defined(__SSE2__)
+        // Eight columns of both rows at a time, giving 16 luma and four of each chroma values
+        for (; vectorized && x + 8 <= width; x += 8) {
+            __m128i r0, g0, b0, r1, g1, b1;
+            UnpackChannels(row0 + x, r0, g0, b0);
+            UnpackChannels(row1 + x, r1, g1, b1);
+            __m128i luma = LumaLanes(r0, g0, b0);
+            _mm_storel_epi64((__m128i*)(luma0 + x), _mm_packus_epi16(luma, luma));
+            if (luma1) {
+                luma = LumaLanes(r1, g1, b1);
+                _mm_storel_epi64((__m128i*)(luma1 + x), _mm_packus_epi16(luma, luma));
+            }
+
+            __m128i r = BlockAverage(_mm_add_epi16(r0, r1));
+            __m128i g = BlockAverage(_mm_add_epi16(g0, g1));
+            __m128i b = BlockAverage(_mm_add_epi16(b0, b1));
+            __m128i chromaU = ChromaLanes(r, g, b, -38, -74, 112);
+            __m128i chromaV = ChromaLanes(r, g, b, 112, -94, -18);
+            int packedU = _mm_cvtsi128_si32(_mm_packus_epi16(chromaU, chromaU));
+            int packedV = _mm_cvtsi128_si32(_mm_packus_epi16(chromaV, chromaV));
+            std::memcpy(u + x / 2, &packedU, 4);
+            std::memcpy(v + x / 2, &packedV, 4);
+        }
+#endif
+
+        for (; x < width; x += 2) {
+            ConvertBlock(row0, row1, x, width, luma0, luma1, u, v);
+        }
+    }
+}
+
+void ConvertToYuv420(const Framebuffer& frame, Uint8* yPlane, Uint8* uPlane, Uint8* vPlane) {
+    ConvertRows(frame, yPlane, uPlane, vPlane, true);
+}
+
+void ConvertToYuv420Scalar(const Framebuffer& frame, Uint8* yPlane, Uint8* uPlane, Uint8* vPlane) {
+    ConvertRows(frame, yPlane, uPlane, vPlane, false);
+}
+
+void ConvertToRgba(const Framebuffer& frame, Uint8* out) {
+    size_t count = frame.pixels.size();
+    const Uint32* pixels = frame.pixels.data();
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    // x86 is little endian, so RGBA bytes are ABGR words: swap the R and B bytes of ARGB, keep A and G
+    const __m128i keep = _mm_set1_epi32((int)0xFF00FF00);
+    const __m128i low = _mm_set1_epi32(0xFF);
+    for (; i + 4 <= count; i += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(pixels + i));
+        __m128i swapped = _mm_or_si128(_mm_and_si128(p, keep),
+            _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), low), _mm_slli_epi32(_mm_and_si128(p, low), 16)));
+        _mm_storeu_si128((__m128i*)(out + i * 4), swapped);
+    }
+#endif
+
+    for (; i < count; i++) {
+        Uint32 pixel = pixels[i];
+        out[i * 4] = (Uint8)(pixel >> 16);
+        out[i * 4 + 1] = (Uint8)(pixel >> 8);
+        out[i * 4 + 2] = (Uint8)pixel;
+        out[i * 4 + 3] = (Uint8)(pixel >> 24);
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef COLORCONVERT_H
+#define COLORCONVERT_H
+
+#include "../Framebuffer/Framebuffer.h"
+
+// Planar 8-bit YUV 4:2:0 with BT.601 limited range coefficients, what Y4M readers assume. Chroma is
+// the average of each 2x2 block, with the last row and column repeated for odd sizes. The planes are
+// width x height and ((width + 1) / 2) x ((height + 1) / 2).
+void ConvertToYuv420(const Framebuffer& frame, Uint8* yPlane, Uint8* uPlane, Uint8* vPlane);
+// Same result without SIMD, the reference for the vector path
+void ConvertToYuv420Scalar(const Framebuffer& frame, Uint8* yPlane, Uint8* uPlane, Uint8* vPlane);
+
+// R, G, B, A bytes per pixel
+void ConvertToRgba(const Framebuffer& frame, Uint8* out);
+
+#endif
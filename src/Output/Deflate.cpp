@@ -0,0 +1,202 @@
+#include "Deflate.h"
+#include <algorithm>
+
+// Match lengths 3..258 and distances 1..32768 are coded as a symbol for a range plus extra bits
+static const int LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const int LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537,
+    2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const int DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+const int DEFLATE_MIN_MATCH = 3;
+const int DEFLATE_MAX_MATCH = 258;
+const int DEFLATE_END_OF_BLOCK = 256;
+
+// Huffman codes are sent most significant bit first into a stream that is otherwise least significant first
+static uint32_t ReverseBits(uint32_t value, int count) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < count; i++) {
+        reversed = (reversed << 1) | (value & 1);
+        value >>= 1;
+    }
+    return reversed;
+}
+
+struct FixedCode {
+    uint16_t bits;
+    uint8_t length;
+};
+
+// The fixed literal/length code of RFC 1951 section 3.2.6, already bit reversed
+static const FixedCode* FixedCodes() {
+    static FixedCode codes[288];
+    static bool built = [] {
+        for (int symbol = 0; symbol < 288; symbol++) {
+            uint32_t code;
+            int length;
+            if (symbol < 144) {
+                code = 0x30 + symbol;
+                length = 8;
+            } else if (symbol < 256) {
+                code = 0x190 + symbol - 144;
+                length = 9;
+            } else if (symbol < 280) {
+                code = symbol - 256;
+                length = 7;
+            } else {
+                code = 0xC0 + symbol - 280;
+                length = 8;
+            }
+            codes[symbol] = {(uint16_t)ReverseBits(code, length), (uint8_t)length};
+        }
+        return true;
+    }();
+    (void)built;
+    return codes;
+}
+
+void Deflater::WriteBits(uint32_t value, int count) {
+    bitBuffer |= value << bitCount;
+    bitCount += count;
+    while (bitCount >= 8) {
+        out->push_back((unsigned char)bitBuffer);
+        bitBuffer >>= 8;
+        bitCount -= 8;
+    }
+}
+
+void Deflater::WriteLiteral(int literal) {
+    const FixedCode& code = FixedCodes()[literal];
+    WriteBits(code.bits, code.length);
+}
+
+void Deflater::WriteMatch(int length, int distance) {
+    int lengthCode = 0;
+    while (lengthCode < 28 && LENGTH_BASE[lengthCode + 1] <= length) {
+        lengthCode++;
+    }
+    WriteLiteral(257 + lengthCode);
+    WriteBits(length - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+
+    int distanceCode = 0;
+    while (distanceCode < 29 && DISTANCE_BASE[distanceCode + 1] <= distance) {
+        distanceCode++;
+    }
+    WriteBits(ReverseBits(distanceCode, 5), 5);
+    WriteBits(distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode]);
+}
+
+void Deflater::Compress(const unsigned char* data, size_t size, std::vector<unsigned char>& out) {
+    this->out = &out;
+    bitBuffer = 0;
+    bitCount = 0;
+    head.assign(1 << DEFLATE_HASH_BITS, -1);
+    previous.resize(DEFLATE_WINDOW);
+
+    // Deflate with a 32 KiB window and no preset dictionary, the check bits make the pair a multiple of 31
+    out.push_back(0x78);
+    out.push_back(0x01);
+    // A single final block with the fixed codes
+    WriteBits(1, 1);
+    WriteBits(1, 2);
+
+    int count = (int)size;
+    auto hash = [data](int p) {
+        uint32_t key = ((uint32_t)data[p] << 16) | ((uint32_t)data[p + 1] << 8) | data[p + 2];
+        return (key * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+    };
+    auto insert = [&](int p) {
+        uint32_t bucket = hash(p);
+        previous[p % DEFLATE_WINDOW] = head[bucket];
+        head[bucket] = p;
+    };
+
+    int p = 0;
+    while (p + DEFLATE_MIN_MATCH <= count) {
+        // Chains only ever lead back in the data, and entries older than the window have been overwritten
+        int maxLength = std::min(DEFLATE_MAX_MATCH, count - p);
+        int bestLength = 0;
+        int bestDistance = 0;
+        int candidate = head[hash(p)];
+        for (int chain = 0; candidate >= 0 && p - candidate <= DEFLATE_WINDOW && chain < DEFLATE_MAX_CHAIN; chain++) {
+            if (data[candidate + bestLength] == data[p + bestLength]) {
+                int length = 0;
+                while (length < maxLength && data[candidate + length] == data[p + length]) {
+                    length++;
+                }
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = p - candidate;
+                    if (length == maxLength) {
+                        break;
+                    }
+                }
+            }
+            candidate = previous[candidate % DEFLATE_WINDOW];
+        }
+
+        if (bestLength >= DEFLATE_MIN_MATCH) {
+            WriteMatch(bestLength, bestDistance);
+            for (int end = p + bestLength; p < end; p++) {
+                if (p + DEFLATE_MIN_MATCH <= count) {
+                    insert(p);
+                }
+            }
+        } else {
+            WriteLiteral(data[p]);
+            insert(p);
+            p++;
+        }
+    }
+    for (; p < count; p++) {
+        WriteLiteral(data[p]);
+    }
+    WriteLiteral(DEFLATE_END_OF_BLOCK);
+    if (bitCount > 0) {
+        WriteBits(0, 8 - bitCount);
+    }
+
+    uint32_t adler = Adler32(data, size);
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back((unsigned char)(adler >> shift));
+    }
+    this->out = nullptr;
+}
+
+uint32_t Adler32(const unsigned char* data, size_t size) {
+    // Largest run of bytes whose sums can't overflow 32 bits before the modulo
+    const size_t blockSize = 5552;
+    uint32_t a = 1;
+    uint32_t b = 0;
+    while (size > 0) {
+        size_t block = std::min(size, blockSize);
+        for (size_t i = 0; i < block; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+
+uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc) {
+    static uint32_t table[256];
+    static bool built = [] {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return true;
+    }();
+    (void)built;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
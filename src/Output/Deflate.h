@@ -0,0 +1,37 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Longest hash chain followed when looking for a match, trading ratio for speed
+const int DEFLATE_MAX_CHAIN = 32;
+const int DEFLATE_WINDOW = 32768;
+const int DEFLATE_HASH_BITS = 15;
+
+// zlib stream compressor for PNG: LZ77 over a 32 KiB window with hash chains, coded with the fixed
+// Huffman tables of RFC 1951. Fixed codes need no table building or second pass, and rendered images
+// after PNG filtering are runs and small deltas that LZ77 removes most of anyway. The match tables
+// are kept between calls, so a Deflater reused for every frame stops allocating after the first.
+class Deflater {
+    private:
+        std::vector<int> head;
+        std::vector<int> previous;
+        std::vector<unsigned char>* out = nullptr;
+        uint32_t bitBuffer = 0;
+        int bitCount = 0;
+
+        void WriteBits(uint32_t value, int count);
+        void WriteLiteral(int literal);
+        void WriteMatch(int length, int distance);
+
+    public:
+        // Appends data compressed as a zlib stream to out
+        void Compress(const unsigned char* data, size_t size, std::vector<unsigned char>& out);
+};
+
+uint32_t Adler32(const unsigned char* data, size_t size);
+uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc = 0);
+
+#endif
@@ -0,0 +1,201 @@
+#include "FrameStream.h"
+#include "../Memory/AllocationCounter.h"
+#include "../Profiling/Profiler.h"
+#include "../Timing/FramePacer.h"
+#include "ColorConvert.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define STREAMS_AVAILABLE 1
+#endif
+
+static const char FRAME_HEADER[] = "FRAME\n";
+
+bool ParseStreamFormat(const char* name, StreamFormat& format) {
+    if (std::strcmp(name, "y4m") == 0) {
+        format = StreamFormat::Y4m;
+    } else if (std::strcmp(name, "rgba") == 0) {
+        format = StreamFormat::Rgba;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* StreamFormatName(StreamFormat format) {
+    return format == StreamFormat::Y4m ? "y4m" : "rgba";
+}
+
+FrameStream::FrameStream(StreamFormat format, int width, int height, int fps, int bufferCount)
+    : format(format), width(width), height(height), fps(fps), buffers(bufferCount), freeFrames(bufferCount), pendingFrames(bufferCount + 1) {
+    for (Framebuffer& buffer : buffers) {
+        buffer.Resize(width, height);
+        freeFrames.Push(&buffer);
+    }
+    if (format == StreamFormat::Y4m) {
+        int chromaSize = ((width + 1) / 2) * ((height + 1) / 2);
+        converted.resize((size_t)width * height + 2 * (size_t)chromaSize);
+    } else {
+        converted.resize((size_t)width * height * 4);
+    }
+}
+
+FrameStream::~FrameStream() {
+    Finish();
+}
+
+#ifdef STREAMS_AVAILABLE
+
+bool FrameStream::Open(const std::string& target, std::string& error) {
+    if (target == "-") {
+        descriptor = STDOUT_FILENO;
+    } else {
+        descriptor = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (descriptor < 0) {
+            error = "can't open " + target + ": " + std::strerror(errno);
+            return false;
+        }
+        ownsDescriptor = true;
+    }
+    // A reader that exits makes writes fail with EPIPE rather than killing the renderer
+    std::signal(SIGPIPE, SIG_IGN);
+#ifdef F_SETPIPE_SZ
+    // Fails harmlessly when the target is not a pipe
+    fcntl(descriptor, F_SETPIPE_SZ, FRAME_STREAM_PIPE_BYTES);
+#endif
+
+    if (format == StreamFormat::Y4m) {
+        char header[128];
+        int length = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, fps);
+        if (!WriteAll((const Uint8*)header, length, nullptr, 0)) {
+            error = std::string("can't write to ") + target + ": " + std::strerror(errno);
+            return false;
+        }
+    }
+    thread = std::thread(&FrameStream::StreamLoop, this);
+    return true;
+}
+
+// Writes header and data with as few writev calls as the pipe allows, false if the reader is gone
+bool FrameStream::WriteAll(const Uint8* header, size_t headerSize, const Uint8* data, size_t dataSize) {
+    iovec parts[2] = {{(void*)header, headerSize}, {(void*)data, dataSize}};
+    int first = headerSize > 0 ? 0 : 1;
+    int count = dataSize > 0 ? 2 : 1;
+    while (first < count) {
+        ssize_t written = writev(descriptor, parts + first, count - first);
+        writeCalls++;
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        while (first < count && (size_t)written >= parts[first].iov_len) {
+            written -= parts[first].iov_len;
+            first++;
+        }
+        if (first < count) {
+            parts[first].iov_base = (Uint8*)parts[first].iov_base + written;
+            parts[first].iov_len -= written;
+        }
+    }
+    return true;
+}
+
+void FrameStream::Finish() {
+    if (thread.joinable()) {
+        pendingFrames.Push(nullptr);
+        thread.join();
+    }
+    if (ownsDescriptor) {
+        close(descriptor);
+        ownsDescriptor = false;
+    }
+    descriptor = -1;
+}
+
+#else
+
+bool FrameStream::Open(const std::string&, std::string& error) {
+    error = "streaming is not supported on this platform";
+    return false;
+}
+
+bool FrameStream::WriteAll(const Uint8*, size_t, const Uint8*, size_t) {
+    return false;
+}
+
+void FrameStream::Finish() {
+}
+
+#endif
+
+Framebuffer& FrameStream::Acquire() {
+    auto waitStart = FramePacer::Now();
+    Framebuffer* frame = freeFrames.Pop();
+    acquireWaitSeconds += FramePacer::SecondsSince(waitStart);
+    return *frame;
+}
+
+void FrameStream::Submit(Framebuffer& frame) {
+    pendingFrames.Push(&frame);
+}
+
+void FrameStream::StreamLoop() {
+    IgnoreThreadAllocations();
+    PROFILE_THREAD_NAME("frame stream");
+    while (Framebuffer* frame = pendingFrames.Pop()) {
+        if (!broken) {
+            auto convertStart = FramePacer::Now();
+            {
+                PROFILE_ZONE("ConvertFrame");
+                if (format == StreamFormat::Y4m) {
+                    Uint8* yPlane = converted.data();
+                    Uint8* uPlane = yPlane + (size_t)width * height;
+                    Uint8* vPlane = uPlane + (size_t)((width + 1) / 2) * ((height + 1) / 2);
+                    ConvertToYuv420(*frame, yPlane, uPlane, vPlane);
+                } else {
+                    ConvertToRgba(*frame, converted.data());
+                }
+            }
+            convertSeconds += FramePacer::SecondsSince(convertStart);
+
+            auto writeStart = FramePacer::Now();
+            bool written;
+            {
+                PROFILE_ZONE("WriteFrame");
+                if (format == StreamFormat::Y4m) {
+                    written = WriteAll((const Uint8*)FRAME_HEADER, sizeof(FRAME_HEADER) - 1, converted.data(), converted.size());
+                } else {
+                    written = WriteAll(nullptr, 0, converted.data(), converted.size());
+                }
+            }
+            writeSeconds += FramePacer::SecondsSince(writeStart);
+            if (written) {
+                frames++;
+                bytes += converted.size();
+            } else {
+                std::cout << "Frame stream closed (" << std::strerror(errno) << "), dropping the remaining frames" << std::endl;
+                broken = true;
+            }
+        }
+        freeFrames.Push(frame);
+    }
+}
+
+void FrameStream::PrintStats() const {
+    int perFrame = frames > 0 ? frames : 1;
+    std::cout << std::fixed << std::setprecision(2)
+              << "  stream: " << frames << " " << StreamFormatName(format) << " frames, " << bytes / 1024.0 / 1024.0
+              << " MiB, per frame convert " << convertSeconds * 1000.0 / perFrame << " ms, write "
+              << writeSeconds * 1000.0 / perFrame << " ms in " << (double)writeCalls / perFrame << " calls" << std::endl
+              << "  rendering waited " << acquireWaitSeconds * 1000.0 << " ms for free stream buffers" << std::endl;
+}
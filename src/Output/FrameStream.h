@@ -0,0 +1,68 @@
+#ifndef FRAMESTREAM_H
+#define FRAMESTREAM_H
+
+#include "../Framebuffer/Framebuffer.h"
+#include "../Threading/BoundedQueue.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+const int FRAME_STREAM_BUFFERS = 3;
+// Pipe buffer asked for on Linux, so a frame goes to the reader in a few large writes
+const int FRAME_STREAM_PIPE_BYTES = 1 << 20;
+
+enum class StreamFormat {
+    // YUV4MPEG2 with 4:2:0 chroma, which ffmpeg reads with no options
+    Y4m,
+    // Headerless R, G, B, A bytes, for ffmpeg -f rawvideo -pix_fmt rgba -s WxH
+    Rgba
+};
+
+bool ParseStreamFormat(const char* name, StreamFormat& format);
+const char* StreamFormatName(StreamFormat format);
+
+// Streams frames as raw video to stdout, a named pipe or a file, for piping into an encoder. Like
+// ImageWriter, frames are copied into recycled buffers and converted and written on a thread of its
+// own, which writes each frame with a single vectored write of its header and pixels.
+class FrameStream {
+    private:
+        StreamFormat format;
+        int width;
+        int height;
+        int fps;
+        int descriptor = -1;
+        bool ownsDescriptor = false;
+        std::vector<Framebuffer> buffers;
+        BoundedQueue<Framebuffer*> freeFrames;
+        BoundedQueue<Framebuffer*> pendingFrames;
+        // The converted frame, contiguous so one write covers it
+        std::vector<Uint8> converted;
+        std::thread thread;
+        // Set by the stream thread when the reader goes away, later frames are dropped
+        bool broken = false;
+        int frames = 0;
+        Uint64 bytes = 0;
+        Uint64 writeCalls = 0;
+        double convertSeconds = 0.0;
+        double writeSeconds = 0.0;
+        double acquireWaitSeconds = 0.0;
+
+        void StreamLoop();
+        bool WriteAll(const Uint8* header, size_t headerSize, const Uint8* data, size_t dataSize);
+
+    public:
+        FrameStream(StreamFormat format, int width, int height, int fps, int bufferCount);
+        ~FrameStream();
+        FrameStream(const FrameStream&) = delete;
+        FrameStream& operator=(const FrameStream&) = delete;
+
+        // Opens target, "-" for stdout, and writes the stream header. Opening a named pipe waits for its reader.
+        bool Open(const std::string& target, std::string& error);
+        Framebuffer& Acquire();
+        void Submit(Framebuffer& frame);
+        // Waits for every submitted frame to be written and closes the stream
+        void Finish();
+        void PrintStats() const;
+};
+
+#endif
@@ -0,0 +1,300 @@
+#include "ImageFile.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+bool ImageFormatFromPath(const std::string& path, ImageFormat& format) {
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string extension = path.substr(dot + 1);
+    for (char& c : extension) {
+        c = (char)std::tolower((unsigned char)c);
+    }
+    if (extension == "ppm") {
+        format = ImageFormat::Ppm;
+    } else if (extension == "png") {
+        format = ImageFormat::Png;
+    } else if (extension == "pfm") {
+        format = ImageFormat::Pfm;
+    } else if (extension == "exr") {
+        format = ImageFormat::Exr;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* ImageFormatName(ImageFormat format) {
+    switch (format) {
+        case ImageFormat::Ppm: return "ppm";
+        case ImageFormat::Png: return "png";
+        case ImageFormat::Pfm: return "pfm";
+        case ImageFormat::Exr: return "exr";
+    }
+    return "unknown";
+}
+
+bool IsHdrFormat(ImageFormat format) {
+    return format == ImageFormat::Pfm || format == ImageFormat::Exr;
+}
+
+std::string FramePath(const std::string& pattern, int frame) {
+    size_t begin = pattern.find('#');
+    if (begin == std::string::npos) {
+        return pattern;
+    }
+    size_t end = pattern.find_first_not_of('#', begin);
+    if (end == std::string::npos) {
+        end = pattern.size();
+    }
+    char number[32];
+    std::snprintf(number, sizeof(number), "%0*d", (int)(end - begin), frame);
+    return pattern.substr(0, begin) + number + pattern.substr(end);
+}
+
+static void AppendText(std::vector<unsigned char>& out, const char* text) {
+    out.insert(out.end(), text, text + std::strlen(text) + 1);
+}
+
+// Both file formats are little endian whatever the machine is
+static void AppendLittle(std::vector<unsigned char>& out, Uint64 value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back((unsigned char)(value >> (i * 8)));
+    }
+}
+
+static void AppendFloat(std::vector<unsigned char>& out, float value) {
+    Uint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    AppendLittle(out, bits, 4);
+}
+
+static void AppendBigEndian(std::vector<unsigned char>& out, Uint32 value) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back((unsigned char)(value >> shift));
+    }
+}
+
+static void AppendPngChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size) {
+    AppendBigEndian(out, (Uint32)size);
+    size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    AppendBigEndian(out, Crc32(&out[typeStart], size + 4));
+}
+
+static int PaethPredictor(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+    return pb <= pc ? b : c;
+}
+
+// Byte i of row after PNG filter type filter (0 none, 1 sub, 2 up, 3 average, 4 Paeth), above is the previous row or nullptr
+static unsigned char FilterByte(int filter, const unsigned char* row, const unsigned char* above, int i) {
+    const int bytesPerPixel = 3;
+    int a = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+    int b = above ? above[i] : 0;
+    int c = above && i >= bytesPerPixel ? above[i - bytesPerPixel] : 0;
+    switch (filter) {
+        case 1: return (unsigned char)(row[i] - a);
+        case 2: return (unsigned char)(row[i] - b);
+        case 3: return (unsigned char)(row[i] - (a + b) / 2);
+        case 4: return (unsigned char)(row[i] - PaethPredictor(a, b, c));
+    }
+    return row[i];
+}
+
+void EncodePng(const Framebuffer& frame, Deflater& deflater, std::vector<unsigned char>& scratch, std::vector<unsigned char>& out) {
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.insert(out.end(), signature, signature + 8);
+    unsigned char header[13] = {};
+    for (int i = 0; i < 4; i++) {
+        header[i] = (unsigned char)(frame.width >> (24 - i * 8));
+        header[4 + i] = (unsigned char)(frame.height >> (24 - i * 8));
+    }
+    // 8 bits per channel, RGB, default compression and filtering, not interlaced
+    header[8] = 8;
+    header[9] = 2;
+    AppendPngChunk(out, "IHDR", header, sizeof(header));
+
+    // RGB rows first, then each row behind a filter type byte, choosing per row the filter whose output
+    // has the smallest sum of magnitudes as PNG recommends
+    size_t rowBytes = (size_t)frame.width * 3;
+    size_t rawSize = rowBytes * frame.height;
+    scratch.resize(rawSize + (rowBytes + 1) * frame.height);
+    unsigned char* raw = scratch.data();
+    unsigned char* filtered = raw + rawSize;
+    for (size_t i = 0; i < frame.pixels.size(); i++) {
+        Uint32 pixel = frame.pixels[i];
+        raw[i * 3] = (unsigned char)(pixel >> 16);
+        raw[i * 3 + 1] = (unsigned char)(pixel >> 8);
+        raw[i * 3 + 2] = (unsigned char)pixel;
+    }
+    for (int y = 0; y < frame.height; y++) {
+        const unsigned char* row = raw + y * rowBytes;
+        const unsigned char* above = y > 0 ? row - rowBytes : nullptr;
+        int bestFilter = 0;
+        long bestCost = -1;
+        for (int filter = 0; filter < 5; filter++) {
+            long cost = 0;
+            for (int i = 0; i < (int)rowBytes; i++) {
+                cost += std::abs((int)(signed char)FilterByte(filter, row, above, i));
+            }
+            if (bestCost < 0 || cost < bestCost) {
+                bestCost = cost;
+                bestFilter = filter;
+            }
+        }
+        unsigned char* target = filtered + y * (rowBytes + 1);
+        target[0] = (unsigned char)bestFilter;
+        for (int i = 0; i < (int)rowBytes; i++) {
+            target[i + 1] = FilterByte(bestFilter, row, above, i);
+        }
+    }
+
+    // The compressed stream goes straight into out behind a placeholder length, patched afterwards
+    size_t lengthAt = out.size();
+    AppendBigEndian(out, 0);
+    out.insert(out.end(), {'I', 'D', 'A', 'T'});
+    deflater.Compress(filtered, (rowBytes + 1) * frame.height, out);
+    Uint32 length = (Uint32)(out.size() - lengthAt - 8);
+    for (int i = 0; i < 4; i++) {
+        out[lengthAt + i] = (unsigned char)(length >> (24 - i * 8));
+    }
+    AppendBigEndian(out, Crc32(&out[lengthAt + 4], length + 4));
+    AppendPngChunk(out, "IEND", nullptr, 0);
+}
+
+void EncodePfm(const HdrFramebuffer& frame, float scale, std::vector<unsigned char>& out) {
+    char header[64];
+    // A negative scale marks the floats as little endian
+    int length = std::snprintf(header, sizeof(header), "PF\n%d %d\n-1.0\n", frame.width, frame.height);
+    out.insert(out.end(), header, header + length);
+    // Rows run bottom to top
+    for (int y = frame.height - 1; y >= 0; y--) {
+        for (int x = 0; x < frame.width; x++) {
+            glm::vec3 radiance = frame.GetPixel(x, y) * scale;
+            AppendFloat(out, radiance.r);
+            AppendFloat(out, radiance.g);
+            AppendFloat(out, radiance.b);
+        }
+    }
+}
+
+// Rounds to the nearest half, ties to even, with overflow to infinity and underflow through the subnormals
+Uint16 FloatToHalf(float value) {
+    Uint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    Uint32 sign = (bits >> 16) & 0x8000;
+    Uint32 magnitude = bits & 0x7FFFFFFF;
+    if (magnitude >= 0x7F800000) {
+        // Infinity stays infinity, NaN stays a quiet NaN
+        return (Uint16)(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+    }
+    if (magnitude >= 0x477FF000) {
+        return (Uint16)(sign | 0x7C00);
+    }
+    if (magnitude < 0x38800000) {
+        if (magnitude < 0x33000000) {
+            return (Uint16)sign;
+        }
+        Uint32 mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+        int shift = 126 - (int)(magnitude >> 23);
+        Uint32 half = mantissa >> shift;
+        Uint32 remainder = mantissa & ((1u << shift) - 1);
+        Uint32 halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) {
+            half++;
+        }
+        return (Uint16)(sign | half);
+    }
+    // Rebias the exponent from 127 to 15, a carry out of the mantissa correctly bumps the exponent
+    Uint32 half = (magnitude - 0x38000000) >> 13;
+    Uint32 remainder = magnitude & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return (Uint16)(sign | half);
+}
+
+static void AppendExrAttribute(std::vector<unsigned char>& out, const char* name, const char* type, int size) {
+    AppendText(out, name);
+    AppendText(out, type);
+    AppendLittle(out, (Uint32)size, 4);
+}
+
+void EncodeExr(const HdrFramebuffer& frame, float scale, std::vector<unsigned char>& out) {
+    const int pixelTypeHalf = 1;
+    // Channels must be listed, and stored in each scanline, in alphabetical order
+    static const char* const channels[3] = {"B", "G", "R"};
+    static const int channelComponents[3] = {2, 1, 0};
+
+    size_t fileStart = out.size();
+    AppendLittle(out, 20000630, 4);
+    // Version 2, single part scanline file
+    AppendLittle(out, 2, 4);
+
+    AppendExrAttribute(out, "channels", "chlist", 3 * (2 + 16) + 1);
+    for (const char* channel : channels) {
+        AppendText(out, channel);
+        AppendLittle(out, pixelTypeHalf, 4);
+        // pLinear and three reserved bytes, then x and y sampling
+        AppendLittle(out, 0, 4);
+        AppendLittle(out, 1, 4);
+        AppendLittle(out, 1, 4);
+    }
+    out.push_back(0);
+    AppendExrAttribute(out, "compression", "compression", 1);
+    out.push_back(0);
+    for (const char* window : {"dataWindow", "displayWindow"}) {
+        AppendExrAttribute(out, window, "box2i", 16);
+        AppendLittle(out, 0, 4);
+        AppendLittle(out, 0, 4);
+        AppendLittle(out, (Uint32)(frame.width - 1), 4);
+        AppendLittle(out, (Uint32)(frame.height - 1), 4);
+    }
+    AppendExrAttribute(out, "lineOrder", "lineOrder", 1);
+    out.push_back(0);
+    AppendExrAttribute(out, "pixelAspectRatio", "float", 4);
+    AppendFloat(out, 1.0f);
+    AppendExrAttribute(out, "screenWindowCenter", "v2f", 8);
+    AppendFloat(out, 0.0f);
+    AppendFloat(out, 0.0f);
+    AppendExrAttribute(out, "screenWindowWidth", "float", 4);
+    AppendFloat(out, 1.0f);
+    out.push_back(0);
+
+    // Offsets of every scanline block from the start of the file, then the blocks
+    Uint32 blockBytes = (Uint32)frame.width * 3 * 2;
+    Uint64 firstBlock = out.size() - fileStart + (Uint64)frame.height * 8;
+    for (int y = 0; y < frame.height; y++) {
+        AppendLittle(out, firstBlock + (Uint64)y * (8 + blockBytes), 8);
+    }
+    for (int y = 0; y < frame.height; y++) {
+        AppendLittle(out, (Uint32)y, 4);
+        AppendLittle(out, blockBytes, 4);
+        const glm::vec4* row = &frame.pixels[(size_t)y * frame.width];
+        for (int component : channelComponents) {
+            for (int x = 0; x < frame.width; x++) {
+                AppendLittle(out, FloatToHalf(row[x][component] * scale), 2);
+            }
+        }
+    }
+}
+
+bool WriteFileData(const std::string& path, const std::vector<unsigned char>& data) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && written;
+}
@@ -0,0 +1,37 @@
+#ifndef IMAGEFILE_H
+#define IMAGEFILE_H
+
+#include "../Framebuffer/Framebuffer.h"
+#include "Deflate.h"
+#include <string>
+#include <vector>
+
+enum class ImageFormat {
+    // 8-bit sRGB from the tone mapped frame
+    Ppm,
+    Png,
+    // Linear radiance before tone mapping: 32-bit float RGB, and OpenEXR with half float RGB
+    Pfm,
+    Exr
+};
+
+// Format named by the extension of path (.ppm, .png, .pfm or .exr), false for any other
+bool ImageFormatFromPath(const std::string& path, ImageFormat& format);
+const char* ImageFormatName(ImageFormat format);
+bool IsHdrFormat(ImageFormat format);
+
+// Replaces the first run of # in pattern with frame, zero padded to the length of the run
+std::string FramePath(const std::string& pattern, int frame);
+
+// Each appends the whole file to out. HDR formats write radiance times scale.
+void EncodePng(const Framebuffer& frame, Deflater& deflater, std::vector<unsigned char>& scratch, std::vector<unsigned char>& out);
+void EncodePfm(const HdrFramebuffer& frame, float scale, std::vector<unsigned char>& out);
+// Scanline OpenEXR, uncompressed, with half float B, G and R channels
+void EncodeExr(const HdrFramebuffer& frame, float scale, std::vector<unsigned char>& out);
+
+Uint16 FloatToHalf(float value);
+
+// Writes data to path with a single call, false if the file can't be created or written in full
+bool WriteFileData(const std::string& path, const std::vector<unsigned char>& data);
+
+#endif
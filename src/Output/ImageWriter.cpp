@@ -0,0 +1,131 @@
+#include "ImageWriter.h"
+#include "../Framebuffer/PpmFile.h"
+#include "../Memory/AllocationCounter.h"
+#include "../Profiling/Profiler.h"
+#include "../Timing/FramePacer.h"
+#include <iomanip>
+#include <iostream>
+
+ImageWriter::ImageWriter(const std::string& pattern, ImageFormat format, int width, int height, int bufferCount, int threadCount)
+    : pattern(pattern), format(format), jobs(bufferCount), freeJobs(bufferCount), pendingJobs(bufferCount + threadCount) {
+    for (ImageJob& job : jobs) {
+        if (IsHdrFormat(format)) {
+            job.radiance.Resize(width, height);
+        } else {
+            job.image.Resize(width, height);
+        }
+        freeJobs.Push(&job);
+    }
+    for (int i = 0; i < threadCount; i++) {
+        writers.push_back(std::make_unique<WriterThread>());
+        WriterThread& writer = *writers.back();
+        writer.thread = std::thread(&ImageWriter::WriterLoop, this, std::ref(writer));
+    }
+}
+
+ImageWriter::~ImageWriter() {
+    Finish();
+}
+
+ImageJob& ImageWriter::Acquire() {
+    auto waitStart = FramePacer::Now();
+    ImageJob* job = freeJobs.Pop();
+    acquireWaitSeconds += FramePacer::SecondsSince(waitStart);
+    return *job;
+}
+
+void ImageWriter::Submit(ImageJob& job) {
+    submitted++;
+    pendingJobs.Push(&job);
+}
+
+void ImageWriter::Finish() {
+    // One nullptr stops one thread, after the frames queued before it
+    for (auto& writer : writers) {
+        if (writer->thread.joinable()) {
+            pendingJobs.Push(nullptr);
+        }
+    }
+    for (auto& writer : writers) {
+        if (writer->thread.joinable()) {
+            writer->thread.join();
+        }
+    }
+}
+
+void ImageWriter::WriterLoop(WriterThread& writer) {
+    IgnoreThreadAllocations();
+    PROFILE_THREAD_NAME("image writer");
+    while (ImageJob* job = pendingJobs.Pop()) {
+        auto encodeStart = FramePacer::Now();
+        writer.encoded.clear();
+        {
+            PROFILE_ZONE("EncodeImage");
+            switch (format) {
+                case ImageFormat::Ppm:
+                    EncodePpm(job->image, writer.encoded);
+                    break;
+                case ImageFormat::Png:
+                    EncodePng(job->image, writer.deflater, writer.scratch, writer.encoded);
+                    break;
+                case ImageFormat::Pfm:
+                    EncodePfm(job->radiance, job->radianceScale, writer.encoded);
+                    break;
+                case ImageFormat::Exr:
+                    EncodeExr(job->radiance, job->radianceScale, writer.encoded);
+                    break;
+            }
+        }
+        writer.encodeSeconds += FramePacer::SecondsSince(encodeStart);
+
+        auto writeStart = FramePacer::Now();
+        std::string path = FramePath(pattern, job->frame);
+        bool written;
+        {
+            PROFILE_ZONE("WriteImage");
+            written = WriteFileData(path, writer.encoded);
+        }
+        writer.writeSeconds += FramePacer::SecondsSince(writeStart);
+        if (written) {
+            writer.files++;
+            writer.bytes += writer.encoded.size();
+        } else {
+            if (writer.failures == 0) {
+                std::cout << "Failed to write " << path << std::endl;
+            }
+            writer.failures++;
+        }
+        freeJobs.Push(job);
+    }
+}
+
+int ImageWriter::Failures() const {
+    int failures = 0;
+    for (const auto& writer : writers) {
+        failures += writer->failures;
+    }
+    return failures;
+}
+
+void ImageWriter::PrintStats() const {
+    int files = 0;
+    Uint64 bytes = 0;
+    double encodeSeconds = 0.0;
+    double writeSeconds = 0.0;
+    for (const auto& writer : writers) {
+        files += writer->files;
+        bytes += writer->bytes;
+        encodeSeconds += writer->encodeSeconds;
+        writeSeconds += writer->writeSeconds;
+    }
+    int attempts = glm::max(1, files + Failures());
+    std::cout << std::fixed << std::setprecision(2)
+              << "  image writer: " << files << " " << ImageFormatName(format) << " files, " << bytes / 1024.0 / 1024.0
+              << " MiB on " << writers.size() << " threads, per file encode " << encodeSeconds * 1000.0 / attempts
+              << " ms, write " << writeSeconds * 1000.0 / attempts << " ms" << std::endl
+              << "  rendering waited " << acquireWaitSeconds * 1000.0 << " ms for free buffers over " << submitted << " frames";
+    if (Failures() > 0) {
+        std::cout << ", " << Failures() << " failed to write";
+    }
+    std::cout << std::endl;
+}
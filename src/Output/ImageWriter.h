@@ -0,0 +1,73 @@
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include "../Framebuffer/Framebuffer.h"
+#include "../Threading/BoundedQueue.h"
+#include "Deflate.h"
+#include "ImageFile.h"
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int IMAGE_WRITER_THREADS = 2;
+const int IMAGE_WRITER_BUFFERS = 4;
+
+// A finished frame on its way to disk. Lent to the renderer between Acquire and Submit, which fills
+// in image for 8-bit formats or radiance for HDR ones.
+struct ImageJob {
+    int frame = 0;
+    Framebuffer image;
+    HdrFramebuffer radiance;
+    // HDR formats write radiance times this
+    float radianceScale = 1.0f;
+};
+
+// Encodes and writes frames on its own threads, so saving images costs the renderer only the copy
+// into a buffer. Buffers are allocated once and go back to a free queue after their file is written;
+// when every one is waiting on the disk, Acquire blocks rather than letting the backlog grow.
+class ImageWriter {
+    private:
+        struct WriterThread {
+            std::thread thread;
+            // Encoding buffers, kept between frames so they only grow during the first ones
+            std::vector<unsigned char> encoded;
+            std::vector<unsigned char> scratch;
+            Deflater deflater;
+            int files = 0;
+            int failures = 0;
+            Uint64 bytes = 0;
+            double encodeSeconds = 0.0;
+            double writeSeconds = 0.0;
+        };
+
+        std::string pattern;
+        ImageFormat format;
+        std::vector<ImageJob> jobs;
+        BoundedQueue<ImageJob*> freeJobs;
+        BoundedQueue<ImageJob*> pendingJobs;
+        std::vector<std::unique_ptr<WriterThread>> writers;
+        // Time Acquire spent waiting for a free buffer, the only way the disk can slow down rendering
+        double acquireWaitSeconds = 0.0;
+        int submitted = 0;
+
+        void WriterLoop(WriterThread& writer);
+
+    public:
+        // Frames are width x height and go to pattern, whose first run of # becomes the frame number
+        // and whose extension picks the format
+        ImageWriter(const std::string& pattern, ImageFormat format, int width, int height, int bufferCount, int threadCount);
+        ~ImageWriter();
+        ImageWriter(const ImageWriter&) = delete;
+        ImageWriter& operator=(const ImageWriter&) = delete;
+
+        bool Hdr() const { return IsHdrFormat(format); }
+        ImageJob& Acquire();
+        void Submit(ImageJob& job);
+        // Waits for every submitted frame to be written and stops the threads
+        void Finish();
+        void PrintStats() const;
+        int Failures() const;
+};
+
+#endif
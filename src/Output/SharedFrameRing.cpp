@@ -0,0 +1,211 @@
+#include "SharedFrameRing.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SHARED_MEMORY_AVAILABLE 1
+#endif
+
+uint64_t SharedClockNanos() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static size_t RoundUp(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// shm_open names are a single path component starting with a slash
+static std::string SegmentName(const std::string& name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+SharedFrameRing::~SharedFrameRing() {
+    Close();
+}
+
+SharedFrameReader::~SharedFrameReader() {
+    Close();
+}
+
+#ifdef SHARED_MEMORY_AVAILABLE
+
+bool SharedFrameRing::Create(const std::string& segment, int width, int height, int slotCount, std::string& error) {
+    name = SegmentName(segment);
+    // A segment left by a renderer that crashed; its readers keep their mapping of it
+    shm_unlink(name.c_str());
+    int descriptor = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (descriptor < 0) {
+        error = "can't create shared memory " + name + ": " + std::strerror(errno);
+        return false;
+    }
+
+    // Each slot's pixels start on a page of their own
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t frameBytes = (size_t)width * height * sizeof(uint32_t);
+    size_t slotBytes = RoundUp(frameBytes, page);
+    size_t pixelOffset = RoundUp(sizeof(SharedRingHeader), page);
+    size_t size = pixelOffset + slotBytes * slotCount;
+    void* memory = MAP_FAILED;
+    if (ftruncate(descriptor, (off_t)size) == 0) {
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    }
+    int mapError = errno;
+    close(descriptor);
+    if (memory == MAP_FAILED) {
+        error = "can't map shared memory " + name + ": " + std::strerror(mapError);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    // Touch every page now, so the first frames published don't pay for the page faults
+    std::memset(memory, 0, size);
+
+    mappedBytes = size;
+    this->slotCount = slotCount;
+    header = new (memory) SharedRingHeader();
+    header->version = SHARED_RING_VERSION;
+    header->slotCount = (uint32_t)slotCount;
+    header->width = (uint32_t)width;
+    header->height = (uint32_t)height;
+    header->stride = (uint32_t)(width * sizeof(uint32_t));
+    header->pixelOffset = pixelOffset;
+    header->slotBytes = slotBytes;
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, SHARED_RING_MAGIC, sizeof(SHARED_RING_MAGIC));
+    return true;
+}
+
+void SharedFrameRing::Close() {
+    if (!header) {
+        return;
+    }
+    header->closed.store(1, std::memory_order_release);
+    munmap(header, mappedBytes);
+    shm_unlink(name.c_str());
+    header = nullptr;
+}
+
+bool SharedFrameReader::Open(const std::string& segment, std::string& error) {
+    std::string name = SegmentName(segment);
+    int descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+    if (descriptor < 0) {
+        error = "can't open shared memory " + name + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat status;
+    void* memory = MAP_FAILED;
+    if (fstat(descriptor, &status) == 0 && (size_t)status.st_size >= sizeof(SharedRingHeader)) {
+        memory = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    }
+    close(descriptor);
+    if (memory == MAP_FAILED) {
+        error = name + " is not a frame ring";
+        return false;
+    }
+
+    const SharedRingHeader* mapped = (const SharedRingHeader*)memory;
+    size_t size = (size_t)status.st_size;
+    if (std::memcmp(mapped->magic, SHARED_RING_MAGIC, sizeof(SHARED_RING_MAGIC)) != 0 || mapped->version != SHARED_RING_VERSION ||
+        mapped->slotCount < 1 || mapped->slotCount > (uint32_t)SHARED_RING_MAX_SLOTS ||
+        mapped->pixelOffset + mapped->slotBytes * mapped->slotCount > size ||
+        (uint64_t)mapped->stride * mapped->height > mapped->slotBytes) {
+        munmap(memory, size);
+        error = name + " is not a frame ring of version " + std::to_string(SHARED_RING_VERSION);
+        return false;
+    }
+    header = mapped;
+    mappedBytes = size;
+    return true;
+}
+
+void SharedFrameReader::Close() {
+    if (header) {
+        munmap((void*)header, mappedBytes);
+        header = nullptr;
+    }
+}
+
+#else
+
+bool SharedFrameRing::Create(const std::string&, int, int, int, std::string& error) {
+    error = "shared memory is not supported on this platform";
+    return false;
+}
+
+void SharedFrameRing::Close() {
+}
+
+bool SharedFrameReader::Open(const std::string&, std::string& error) {
+    error = "shared memory is not supported on this platform";
+    return false;
+}
+
+void SharedFrameReader::Close() {
+}
+
+#endif
+
+// Seqlock write: the odd sequence goes out before any pixel, the even one after all of them, and the
+// frame only becomes the latest once its slot is complete
+void SharedFrameRing::Publish(const uint32_t* pixels, uint64_t frame) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t ringSequence = ++published;
+    uint32_t index = (uint32_t)((ringSequence - 1) % header->slotCount);
+    SharedFrameSlot& slot = header->slots[index];
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    char* target = (char*)header + header->pixelOffset + index * header->slotBytes;
+    std::memcpy(target, pixels, (size_t)header->stride * header->height);
+    slot.ringSequence.store(ringSequence, std::memory_order_relaxed);
+    slot.frame.store(frame, std::memory_order_relaxed);
+    slot.publishNanos.store(SharedClockNanos(), std::memory_order_relaxed);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    header->latest.store(ringSequence, std::memory_order_release);
+    publishSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SharedFrameRing::PrintStats() const {
+    uint64_t perFrame = published > 0 ? published : 1;
+    std::cout << std::fixed << std::setprecision(3)
+              << "  shared memory " << name << ": " << published << " frames published round robin into " << slotCount
+              << " slots, " << publishSeconds * 1000.0 / perFrame << " ms per frame" << std::endl;
+}
+
+bool SharedFrameReader::Acquire(uint64_t newerThan, SharedFrameView& view) const {
+    uint64_t latest = header->latest.load(std::memory_order_acquire);
+    if (latest == 0 || latest <= newerThan) {
+        return false;
+    }
+    uint32_t index = (uint32_t)((latest - 1) % header->slotCount);
+    const SharedFrameSlot& slot = header->slots[index];
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+        // The writer went round the ring since reading latest
+        return false;
+    }
+    view.ringSequence = slot.ringSequence.load(std::memory_order_relaxed);
+    view.frame = slot.frame.load(std::memory_order_relaxed);
+    view.publishNanos = slot.publishNanos.load(std::memory_order_relaxed);
+    view.sequence = sequence;
+    view.slot = (int)index;
+    view.width = (int)header->width;
+    view.height = (int)header->height;
+    view.pixels = (const uint32_t*)((const char*)header + header->pixelOffset + index * header->slotBytes);
+    return StillValid(view);
+}
+
+// Seqlock read: anything read from the slot before the acquire fence that came from a newer write
+// makes the sequence loaded after it differ
+bool SharedFrameReader::StillValid(const SharedFrameView& view) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return header->slots[view.slot].sequence.load(std::memory_order_relaxed) == view.sequence;
+}
@@ -0,0 +1,120 @@
+#ifndef SHAREDFRAMERING_H
+#define SHAREDFRAMERING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// This header is shared with processes that read the frames, so it only uses fixed width types and
+// doesn't pull in the renderer (or SDL).
+
+const int SHARED_RING_SLOTS = 4;
+const int SHARED_RING_MAX_SLOTS = 16;
+const uint32_t SHARED_RING_VERSION = 1;
+const char SHARED_RING_MAGIC[8] = {'R', 'T', 'F', 'R', 'A', 'M', 'E', 'S'};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the shared ring needs lock-free 64-bit atomics");
+
+// Seqlock of one slot. sequence is odd while the writer copies a frame in and even once it is
+// complete, and the other fields describe the frame it completed.
+struct alignas(64) SharedFrameSlot {
+    std::atomic<uint64_t> sequence;
+    // Position of the frame in the ring's publish order, starting at 1
+    std::atomic<uint64_t> ringSequence;
+    // The renderer's frame index
+    std::atomic<uint64_t> frame;
+    // std::chrono::steady_clock nanoseconds when the frame was complete, CLOCK_MONOTONIC on Linux,
+    // which every process on the machine shares
+    std::atomic<uint64_t> publishNanos;
+};
+
+// Start of the shared memory segment. Slot i's pixels are at pixelOffset + i * slotBytes from the
+// start, height rows of stride bytes holding 32-bit 0xAARRGGBB words (B, G, R, A bytes on little endian).
+struct SharedRingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t reserved;
+    uint64_t pixelOffset;
+    uint64_t slotBytes;
+    // ringSequence of the newest complete frame, 0 before the first
+    alignas(64) std::atomic<uint64_t> latest;
+    // Set when the renderer exits
+    std::atomic<uint32_t> closed;
+    SharedFrameSlot slots[SHARED_RING_MAX_SLOTS];
+};
+
+// Publishes finished frames into a POSIX shared memory segment holding a ring of frame slots, for
+// other processes on the machine to read in place. The writer never waits for readers: it fills the
+// slots round robin, so a reader has slotCount - 1 frame times to use a frame before it is overwritten,
+// and each slot's seqlock tells the reader whether that happened.
+class SharedFrameRing {
+    private:
+        std::string name;
+        SharedRingHeader* header = nullptr;
+        size_t mappedBytes = 0;
+        int slotCount = 0;
+        uint64_t published = 0;
+        double publishSeconds = 0.0;
+
+    public:
+        SharedFrameRing() = default;
+        ~SharedFrameRing();
+        SharedFrameRing(const SharedFrameRing&) = delete;
+        SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+        // Creates the segment /name (replacing a stale one) with slotCount width x height frames
+        bool Create(const std::string& name, int width, int height, int slotCount, std::string& error);
+        // Copies width * height pixels into the next slot and makes it the latest frame
+        void Publish(const uint32_t* pixels, uint64_t frame);
+        // Marks the ring closed for the readers and removes the segment's name
+        void Close();
+        void PrintStats() const;
+};
+
+// A frame in the reader's mapping, valid to use until StillValid says otherwise
+struct SharedFrameView {
+    const uint32_t* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int slot = 0;
+    uint64_t sequence = 0;
+    uint64_t ringSequence = 0;
+    uint64_t frame = 0;
+    uint64_t publishNanos = 0;
+};
+
+// Maps a SharedFrameRing's segment read-only
+class SharedFrameReader {
+    private:
+        const SharedRingHeader* header = nullptr;
+        size_t mappedBytes = 0;
+
+    public:
+        SharedFrameReader() = default;
+        ~SharedFrameReader();
+        SharedFrameReader(const SharedFrameReader&) = delete;
+        SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+
+        bool Open(const std::string& name, std::string& error);
+        void Close();
+        int Width() const { return (int)header->width; }
+        int Height() const { return (int)header->height; }
+        int SlotCount() const { return (int)header->slotCount; }
+        bool Closed() const { return header->closed.load(std::memory_order_acquire) != 0; }
+        // Points view at the newest complete frame if its ringSequence is above newerThan, false if
+        // there is none yet or its slot is being rewritten
+        bool Acquire(uint64_t newerThan, SharedFrameView& view) const;
+        // False if the writer has started overwriting the view's slot, so what was read from its
+        // pixels may be torn. Call it after using them.
+        bool StillValid(const SharedFrameView& view) const;
+};
+
+// Nanoseconds on the clock of SharedFrameSlot::publishNanos
+uint64_t SharedClockNanos();
+
+#endif
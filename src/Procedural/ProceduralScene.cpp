@@ -0,0 +1,240 @@
+#include "ProceduralScene.h"
+#include "../Sampling/Random.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Spheres fill a cube of this half size in front of the camera
+static const float SCENE_HALF_SIZE = 4.0f;
+static const glm::vec3 SCENE_CENTER = glm::vec3(0.0f, 0.0f, 7.0f);
+static const float MAX_SPHERE_RADIUS = 1.0f;
+// Records read or written per fwrite/fread call
+static const size_t FILE_CHUNK_RECORDS = 1 << 14;
+static const int SPHERE_FLOATS = 9;
+static const int LIGHT_FLOATS = 8;
+static const char SCENE_FILE_MAGIC[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '1'};
+
+static const char* DISTRIBUTION_NAMES[] = {"default", "uniform", "clustered", "nested", "degenerate"};
+
+bool ParseSceneDistribution(const char* name, SceneDistribution& distribution) {
+    for (int i = 0; i < (int)(sizeof(DISTRIBUTION_NAMES) / sizeof(DISTRIBUTION_NAMES[0])); i++) {
+        if (std::strcmp(name, DISTRIBUTION_NAMES[i]) == 0) {
+            distribution = (SceneDistribution)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* SceneDistributionName(SceneDistribution distribution) {
+    return DISTRIBUTION_NAMES[(int)distribution];
+}
+
+// Independent random stream per object index, so generation needs no sequential state
+static Uint32 StreamSeed(unsigned seed, Uint32 index, Uint32 stream) {
+    return HashUint(HashUint(index ^ (stream * 0x9E3779B9u)) + seed);
+}
+
+static glm::vec3 RandomInBox(Uint32& rngState, float halfSize) {
+    float x = RandomFloat(rngState);
+    float y = RandomFloat(rngState);
+    float z = RandomFloat(rngState);
+    return SCENE_CENTER + halfSize * (2.0f * glm::vec3(x, y, z) - 1.0f);
+}
+
+static glm::vec3 RandomDirection(Uint32& rngState) {
+    float z = 2.0f * RandomFloat(rngState) - 1.0f;
+    float angle = 6.2831853f * RandomFloat(rngState);
+    float r = glm::sqrt(glm::max(0.0f, 1.0f - z * z));
+    return glm::vec3(r * glm::cos(angle), r * glm::sin(angle), z);
+}
+
+// Distance between neighbours if count spheres were spread evenly over a cube of the given half size
+static float Spacing(float halfSize, int count) {
+    return 2.0f * halfSize / (float)std::cbrt((double)glm::max(count, 1));
+}
+
+// Random material like the extra spheres of the default scene, with the albedo drawn directly in linear space
+static Sphere RandomSphere(Uint32& rngState, glm::vec3 center, float radius) {
+    Sphere sphere;
+    sphere.center = center;
+    sphere.radius = glm::min(radius, MAX_SPHERE_RADIUS);
+    float r = RandomFloat(rngState);
+    float g = RandomFloat(rngState);
+    float b = RandomFloat(rngState);
+    sphere.albedo = 0.05f + 0.95f * glm::vec3(r, g, b);
+    sphere.specular = RandomFloat(rngState) < 0.5f ? -1.0f : 10.0f + 490.0f * RandomFloat(rngState);
+    sphere.reflective = 0.4f * RandomFloat(rngState);
+    return sphere;
+}
+
+static Sphere UniformSphere(const ProceduralSceneSpec& spec, Uint32& rngState) {
+    float spacing = Spacing(SCENE_HALF_SIZE, spec.sphereCount);
+    glm::vec3 center = RandomInBox(rngState, SCENE_HALF_SIZE);
+    return RandomSphere(rngState, center, spacing * (0.15f + 0.3f * RandomFloat(rngState)));
+}
+
+// Spheres are dealt round robin to about cbrt(count) clusters and spread around the cluster center
+// by a sum of uniforms, which falls off roughly like a Gaussian
+static Sphere ClusteredSphere(const ProceduralSceneSpec& spec, int index, Uint32& rngState) {
+    int clusterCount = glm::max(1, (int)std::cbrt((double)spec.sphereCount));
+    int cluster = index % clusterCount;
+    Uint32 clusterState = StreamSeed(spec.seed, cluster, 1);
+    glm::vec3 clusterCenter = RandomInBox(clusterState, 0.8f * SCENE_HALF_SIZE);
+    float clusterRadius = SCENE_HALF_SIZE / (float)std::cbrt((double)clusterCount) * (0.3f + 0.4f * RandomFloat(clusterState));
+
+    glm::vec3 offset;
+    for (int axis = 0; axis < 3; axis++) {
+        offset[axis] = RandomFloat(rngState) + RandomFloat(rngState) + RandomFloat(rngState) - 1.5f;
+    }
+    float members = (float)spec.sphereCount / clusterCount;
+    float radius = Spacing(clusterRadius, (int)members) * (0.1f + 0.2f * RandomFloat(rngState));
+    return RandomSphere(rngState, clusterCenter + clusterRadius * offset, radius);
+}
+
+// Consecutive spheres form stacks of PROCEDURAL_NESTED_LEVELS, each level shrinking and placed off
+// center inside the outermost sphere of its stack
+static Sphere NestedSphere(const ProceduralSceneSpec& spec, int index, Uint32& rngState) {
+    int stack = index / PROCEDURAL_NESTED_LEVELS;
+    int level = index % PROCEDURAL_NESTED_LEVELS;
+    int stackCount = (spec.sphereCount + PROCEDURAL_NESTED_LEVELS - 1) / PROCEDURAL_NESTED_LEVELS;
+    Uint32 stackState = StreamSeed(spec.seed, stack, 2);
+    glm::vec3 stackCenter = RandomInBox(stackState, SCENE_HALF_SIZE);
+    float outerRadius = glm::min(MAX_SPHERE_RADIUS, Spacing(SCENE_HALF_SIZE, stackCount) * (0.3f + 0.2f * RandomFloat(stackState)));
+
+    float radius = outerRadius * std::pow(0.7f, (float)level);
+    glm::vec3 center = stackCenter + RandomDirection(rngState) * (outerRadius - radius) * RandomFloat(rngState);
+    return RandomSphere(rngState, center, radius);
+}
+
+// Pairs of spheres share their exact center, a tenth of the pairs lie on one plane, and radii mix
+// a few huge spheres with tiny ones and ones large enough to overlap their neighbours
+static Sphere DegenerateSphere(const ProceduralSceneSpec& spec, int index, Uint32& rngState) {
+    Uint32 pairState = StreamSeed(spec.seed, index / 2, 3);
+    glm::vec3 center = RandomInBox(pairState, SCENE_HALF_SIZE);
+    if (RandomFloat(pairState) < 0.1f) {
+        center.y = SCENE_CENTER.y - 0.5f * SCENE_HALF_SIZE;
+    }
+
+    float spacing = Spacing(SCENE_HALF_SIZE, spec.sphereCount);
+    float kind = RandomFloat(rngState);
+    float radius;
+    if (kind < 0.001f) {
+        radius = 0.5f + 0.5f * RandomFloat(rngState);
+    } else if (kind < 0.5f) {
+        radius = spacing * 0.01f * (1.0f + RandomFloat(rngState));
+    } else {
+        radius = spacing * (0.5f + RandomFloat(rngState));
+    }
+    return RandomSphere(rngState, center, radius);
+}
+
+void GenerateSpheres(const ProceduralSceneSpec& spec, int begin, int end, Sphere* out) {
+    for (int index = begin; index < end; index++) {
+        Uint32 rngState = StreamSeed(spec.seed, index, 0);
+        Sphere& sphere = out[index - begin];
+        switch (spec.distribution) {
+            case SceneDistribution::Clustered:
+                sphere = ClusteredSphere(spec, index, rngState);
+                break;
+            case SceneDistribution::Nested:
+                sphere = NestedSphere(spec, index, rngState);
+                break;
+            case SceneDistribution::Degenerate:
+                sphere = DegenerateSphere(spec, index, rngState);
+                break;
+            default:
+                sphere = UniformSphere(spec, rngState);
+                break;
+        }
+    }
+}
+
+// The default scene's ambient and directional light, with its point light's intensity shared by
+// lightCount point lights spread through the scene volume
+void GenerateLights(const ProceduralSceneSpec& spec, std::vector<Light>& lights) {
+    lights.push_back(Light(LightType::Ambient, 0.2f, glm::vec3(0), glm::vec3(0)));
+    lights.push_back(Light(LightType::Directional, 0.2f, glm::vec3(0), glm::vec3(1, 4, 4)));
+    for (int i = 0; i < spec.lightCount; i++) {
+        Uint32 rngState = StreamSeed(spec.seed, i, 4);
+        glm::vec3 position = RandomInBox(rngState, SCENE_HALF_SIZE);
+        lights.push_back(Light(LightType::Point, 0.6f / spec.lightCount, position, glm::vec3(0)));
+    }
+}
+
+bool WriteSceneFile(const std::string& path, const std::vector<Sphere>& spheres, const std::vector<Light>& lights) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    Uint64 counts[2] = {spheres.size(), lights.size()};
+    bool ok = std::fwrite(SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC), 1, file) == 1 &&
+              std::fwrite(counts, sizeof(counts), 1, file) == 1;
+
+    std::vector<float> buffer(FILE_CHUNK_RECORDS * SPHERE_FLOATS);
+    for (size_t begin = 0; ok && begin < spheres.size(); begin += FILE_CHUNK_RECORDS) {
+        size_t end = glm::min(spheres.size(), begin + FILE_CHUNK_RECORDS);
+        float* record = buffer.data();
+        for (size_t i = begin; i < end; i++, record += SPHERE_FLOATS) {
+            const Sphere& sphere = spheres[i];
+            float values[SPHERE_FLOATS] = {sphere.center.x, sphere.center.y, sphere.center.z, sphere.radius,
+                                           sphere.albedo.r, sphere.albedo.g, sphere.albedo.b, sphere.specular, sphere.reflective};
+            std::memcpy(record, values, sizeof(values));
+        }
+        ok = std::fwrite(buffer.data(), sizeof(float) * SPHERE_FLOATS, end - begin, file) == end - begin;
+    }
+
+    for (size_t i = 0; ok && i < lights.size(); i++) {
+        const Light& light = lights[i];
+        Sint32 type = (Sint32)light.type;
+        float values[LIGHT_FLOATS] = {light.intensity, light.position.x, light.position.y, light.position.z,
+                                      light.direction.x, light.direction.y, light.direction.z, light.radius};
+        ok = std::fwrite(&type, sizeof(type), 1, file) == 1 && std::fwrite(values, sizeof(values), 1, file) == 1;
+    }
+    return std::fclose(file) == 0 && ok;
+}
+
+bool ReadSceneFile(const std::string& path, std::vector<Sphere>& spheres, std::vector<Light>& lights) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[sizeof(SCENE_FILE_MAGIC)];
+    Uint64 counts[2];
+    bool ok = std::fread(magic, sizeof(magic), 1, file) == 1 && std::memcmp(magic, SCENE_FILE_MAGIC, sizeof(magic)) == 0 &&
+              std::fread(counts, sizeof(counts), 1, file) == 1 && counts[0] <= (Uint64)PROCEDURAL_MAX_SPHERES;
+    if (!ok) {
+        std::fclose(file);
+        return false;
+    }
+
+    spheres.resize(counts[0]);
+    std::vector<float> buffer(FILE_CHUNK_RECORDS * SPHERE_FLOATS);
+    for (size_t begin = 0; ok && begin < spheres.size(); begin += FILE_CHUNK_RECORDS) {
+        size_t end = glm::min(spheres.size(), begin + FILE_CHUNK_RECORDS);
+        ok = std::fread(buffer.data(), sizeof(float) * SPHERE_FLOATS, end - begin, file) == end - begin;
+        const float* record = buffer.data();
+        for (size_t i = begin; ok && i < end; i++, record += SPHERE_FLOATS) {
+            Sphere& sphere = spheres[i];
+            sphere.center = glm::vec3(record[0], record[1], record[2]);
+            sphere.radius = record[3];
+            sphere.albedo = glm::vec3(record[4], record[5], record[6]);
+            sphere.specular = record[7];
+            sphere.reflective = record[8];
+        }
+    }
+
+    lights.clear();
+    for (Uint64 i = 0; ok && i < counts[1]; i++) {
+        Sint32 type;
+        float values[LIGHT_FLOATS];
+        ok = std::fread(&type, sizeof(type), 1, file) == 1 && std::fread(values, sizeof(values), 1, file) == 1 &&
+             type >= LightType::Ambient && type <= LightType::Directional;
+        if (ok) {
+            lights.push_back(Light((LightType)type, values[0], glm::vec3(values[1], values[2], values[3]),
+                                   glm::vec3(values[4], values[5], values[6]), values[7]));
+        }
+    }
+    std::fclose(file);
+    return ok;
+}
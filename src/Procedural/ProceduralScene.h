@@ -0,0 +1,53 @@
+#ifndef PROCEDURALSCENE_H
+#define PROCEDURALSCENE_H
+
+#include "../Scene/Light.h"
+#include "../Scene/Sphere.h"
+#include <string>
+#include <vector>
+
+const int PROCEDURAL_MAX_SPHERES = 100000000;
+const int PROCEDURAL_SPHERES = 100000;
+const int PROCEDURAL_LIGHTS = 64;
+// Spheres generated per thread pool job
+const int PROCEDURAL_CHUNK_SIZE = 1 << 16;
+// Concentric levels per stack of the nested distribution
+const int PROCEDURAL_NESTED_LEVELS = 6;
+
+enum class SceneDistribution {
+    // The hand-built scene of Raytracer::Setup
+    Default,
+    // Similar sized spheres spread evenly over the scene volume
+    Uniform,
+    // Dense blobs of small spheres with empty space between them
+    Clustered,
+    // Stacks of spheres inside spheres, whose bounds all overlap
+    Nested,
+    // Coincident duplicates, huge and tiny spheres mixed, and a flat slab of spheres
+    Degenerate
+};
+
+struct ProceduralSceneSpec {
+    SceneDistribution distribution = SceneDistribution::Uniform;
+    int sphereCount = PROCEDURAL_SPHERES;
+    int lightCount = PROCEDURAL_LIGHTS;
+    unsigned seed = 1;
+};
+
+bool ParseSceneDistribution(const char* name, SceneDistribution& distribution);
+const char* SceneDistributionName(SceneDistribution distribution);
+
+// Writes spheres [begin, end) of the scene into out[0, end - begin). Every sphere depends only on the
+// seed and its index, so chunks can be generated in parallel and in any order with the same result.
+void GenerateSpheres(const ProceduralSceneSpec& spec, int begin, int end, Sphere* out);
+// Appends the scene's ambient, directional and point lights
+void GenerateLights(const ProceduralSceneSpec& spec, std::vector<Light>& lights);
+
+// Binary scene file: the magic "RTSCENE1", sphere and light counts as 64-bit integers, then every
+// sphere as 9 floats (center, radius, linear albedo, specular, reflective) and every light as its
+// type followed by 8 floats (intensity, position, direction, radius), in native byte order.
+bool WriteSceneFile(const std::string& path, const std::vector<Sphere>& spheres, const std::vector<Light>& lights);
+// Replaces spheres and lights with the file's, returns false for missing or malformed files
+bool ReadSceneFile(const std::string& path, std::vector<Sphere>& spheres, std::vector<Light>& lights);
+
+#endif
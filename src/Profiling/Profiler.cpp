@@ -0,0 +1,78 @@
+#include "Profiler.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Single writer ring: the owning thread fills events[count % size] and then publishes the new count
+struct ProfileRing {
+    std::unique_ptr<ProfileEvent[]> events{new ProfileEvent[PROFILE_RING_SIZE]};
+    std::atomic<uint64_t> count{0};
+    int id = 0;
+    std::atomic<const char*> name{nullptr};
+};
+
+static const std::chrono::steady_clock::time_point profileStart = std::chrono::steady_clock::now();
+
+// Rings belong to the registry rather than to their thread, so zones survive threads that have exited
+static std::mutex ringsMutex;
+static std::vector<std::unique_ptr<ProfileRing>> rings;
+
+static ProfileRing& ThreadRing() {
+    static thread_local ProfileRing* ring = nullptr;
+    if (!ring) {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(std::make_unique<ProfileRing>());
+        ring = rings.back().get();
+        ring->id = (int)rings.size();
+    }
+    return *ring;
+}
+
+uint64_t ProfileNow() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profileStart).count();
+}
+
+void ProfileRecord(const char* name, uint64_t begin, uint64_t end) {
+    ProfileRing& ring = ThreadRing();
+    uint64_t count = ring.count.load(std::memory_order_relaxed);
+    ring.events[count % PROFILE_RING_SIZE] = {name, begin, end};
+    ring.count.store(count + 1, std::memory_order_release);
+}
+
+void ProfileThreadName(const char* name) {
+    ThreadRing().name.store(name, std::memory_order_release);
+}
+
+bool WriteChromeTrace(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (auto& ring : rings) {
+        if (const char* name = ring->name.load(std::memory_order_acquire)) {
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", ring->id, name);
+            first = false;
+        }
+
+        // A full ring holds the last PROFILE_RING_SIZE zones, its oldest slot may be rewritten while
+        // we read it, so that one is skipped
+        uint64_t count = ring->count.load(std::memory_order_acquire);
+        uint64_t begin = count > PROFILE_RING_SIZE ? count - PROFILE_RING_SIZE + 1 : 0;
+        for (uint64_t i = begin; i < count; i++) {
+            const ProfileEvent& event = ring->events[i % PROFILE_RING_SIZE];
+            std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", event.name, ring->id, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+            first = false;
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
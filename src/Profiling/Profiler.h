@@ -0,0 +1,54 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <string>
+
+// Zones kept per thread, older ones are overwritten once a thread has recorded more
+const int PROFILE_RING_SIZE = 1 << 16;
+
+// Scoped zones are only recorded in builds with RT_PROFILE defined (make profile), otherwise the
+// macros expand to nothing and cost nothing. A zone times the rest of its enclosing block.
+#ifdef RT_PROFILE
+const bool PROFILING_ENABLED = true;
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) ProfileThreadName(name)
+#else
+const bool PROFILING_ENABLED = false;
+#define PROFILE_ZONE(name)
+#define PROFILE_THREAD_NAME(name)
+#endif
+
+struct ProfileEvent {
+    // String literal naming the zone
+    const char* name;
+    // Nanoseconds since the profiler started
+    uint64_t begin;
+    uint64_t end;
+};
+
+uint64_t ProfileNow();
+// Appends to the calling thread's ring. Only the owning thread writes a ring, so recording takes no lock.
+void ProfileRecord(const char* name, uint64_t begin, uint64_t end);
+// Names the calling thread in the trace
+void ProfileThreadName(const char* name);
+
+// Writes every thread's recorded zones as Chrome trace-event JSON, for chrome://tracing or Perfetto.
+// Meant for once rendering has stopped: a thread that is still recording may overwrite zones mid-read.
+bool WriteChromeTrace(const std::string& path);
+
+class ProfileZone {
+    private:
+        const char* name;
+        uint64_t begin;
+
+    public:
+        explicit ProfileZone(const char* name) : name(name), begin(ProfileNow()) {}
+        ~ProfileZone() { ProfileRecord(name, begin, ProfileNow()); }
+        ProfileZone(const ProfileZone&) = delete;
+        ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#endif
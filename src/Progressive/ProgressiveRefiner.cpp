@@ -0,0 +1,136 @@
+#include "ProgressiveRefiner.h"
+#include <algorithm>
+#include <glm/glm.hpp>
+
+// Units handed to one pool job, and jobs per thread between deadline checks
+static const int UNITS_PER_JOB = 32;
+static const int JOBS_PER_THREAD = 4;
+
+// Compared in the displayable [0, 1] range so overexposed highlights don't dominate the ordering
+static inline float ChannelDifference(glm::vec4 a, glm::vec4 b) {
+    glm::vec3 difference = glm::abs(glm::min(glm::vec3(a), 1.0f) - glm::min(glm::vec3(b), 1.0f));
+    return glm::max(difference.r, glm::max(difference.g, difference.b));
+}
+
+void ProgressiveRefiner::Resize(int width, int height) {
+    image.Resize(width, height);
+    // Sized for the finest pass, whose units are 2x2 blocks, so later passes never allocate mid-frame
+    size_t finestUnits = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    order.reserve(finestUnits);
+    priority.reserve(finestUnits);
+    Restart();
+}
+
+void ProgressiveRefiner::Restart() {
+    blockSize = COARSEST_BLOCK_SIZE;
+    BeginPass();
+}
+
+// The coarse pass works on blocks of blockSize, refinement passes on parent blocks of twice the block size
+void ProgressiveRefiner::BeginPass() {
+    int unitSize = blockSize == COARSEST_BLOCK_SIZE ? blockSize : blockSize * 2;
+    unitsX = (image.width + unitSize - 1) / unitSize;
+    unitsY = (image.height + unitSize - 1) / unitSize;
+    int unitCount = unitsX * unitsY;
+
+    order.resize(unitCount);
+    for (int i = 0; i < unitCount; i++) {
+        order[i] = i;
+    }
+    nextUnit = 0;
+    if (blockSize == COARSEST_BLOCK_SIZE) {
+        return;
+    }
+
+    priority.resize(unitCount);
+    for (int unitY = 0; unitY < unitsY; unitY++) {
+        for (int unitX = 0; unitX < unitsX; unitX++) {
+            float difference = glm::max(
+                glm::max(SampleDifference(unitX, unitY, unitX - 1, unitY), SampleDifference(unitX, unitY, unitX + 1, unitY)),
+                glm::max(SampleDifference(unitX, unitY, unitX, unitY - 1), SampleDifference(unitX, unitY, unitX, unitY + 1)));
+            priority[unitY * unitsX + unitX] = difference;
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) { return priority[a] > priority[b]; });
+}
+
+float ProgressiveRefiner::SampleDifference(int unitX, int unitY, int otherX, int otherY) const {
+    if (otherX < 0 || otherY < 0 || otherX >= unitsX || otherY >= unitsY) {
+        return 0.0f;
+    }
+    int unitSize = blockSize * 2;
+    glm::vec4 sample = image.pixels[(size_t)unitY * unitSize * image.width + unitX * unitSize];
+    glm::vec4 other = image.pixels[(size_t)otherY * unitSize * image.width + otherX * unitSize];
+    return ChannelDifference(sample, other);
+}
+
+void ProgressiveRefiner::FillBlock(int x, int y, int size, glm::vec4 pixel) {
+    int x1 = glm::min(x + size, image.width);
+    int y1 = glm::min(y + size, image.height);
+    for (int row = y; row < y1; row++) {
+        std::fill(&image.pixels[(size_t)row * image.width + x], &image.pixels[(size_t)row * image.width + x1], pixel);
+    }
+}
+
+void ProgressiveRefiner::RefineUnit(int unit, const TraceFunction& trace) {
+    int unitX = unit % unitsX;
+    int unitY = unit / unitsX;
+
+    if (blockSize == COARSEST_BLOCK_SIZE) {
+        int x = unitX * blockSize;
+        int y = unitY * blockSize;
+        image.SetPixel(x, y, trace(x, y));
+        FillBlock(x, y, blockSize, image.pixels[(size_t)y * image.width + x]);
+        return;
+    }
+
+    // The parent's own top-left sample already exists, the other three children are new
+    int parentX = unitX * blockSize * 2;
+    int parentY = unitY * blockSize * 2;
+    for (int child = 0; child < 4; child++) {
+        int x = parentX + (child & 1) * blockSize;
+        int y = parentY + (child >> 1) * blockSize;
+        if (x >= image.width || y >= image.height) {
+            continue;
+        }
+        if (child != 0) {
+            image.SetPixel(x, y, trace(x, y));
+        }
+        FillBlock(x, y, blockSize, image.pixels[(size_t)y * image.width + x]);
+    }
+}
+
+Uint64 ProgressiveRefiner::Refine(ThreadPool& pool, const TraceFunction& trace, Clock::time_point deadline, const PresentFunction& present) {
+    Uint64 rayCount = 0;
+    int unitsPerRound = UNITS_PER_JOB * JOBS_PER_THREAD * (int)pool.ThreadCount();
+
+    while (!IsComplete()) {
+        bool mustFinishPass = blockSize == COARSEST_BLOCK_SIZE;
+        if (!mustFinishPass && Clock::now() >= deadline) {
+            present(image);
+            return rayCount;
+        }
+
+        size_t roundBegin = nextUnit;
+        size_t roundEnd = glm::min(order.size(), roundBegin + (size_t)unitsPerRound);
+        int jobs = (int)((roundEnd - roundBegin + UNITS_PER_JOB - 1) / UNITS_PER_JOB);
+        pool.ParallelFor(jobs, [&](int job) {
+            size_t begin = roundBegin + (size_t)job * UNITS_PER_JOB;
+            size_t end = glm::min(begin + UNITS_PER_JOB, roundEnd);
+            for (size_t i = begin; i < end; i++) {
+                RefineUnit(order[i], trace);
+            }
+        });
+        rayCount += (roundEnd - roundBegin) * (mustFinishPass ? 1 : 3);
+        nextUnit = roundEnd;
+
+        if (nextUnit == order.size()) {
+            present(image);
+            blockSize /= 2;
+            if (!IsComplete()) {
+                BeginPass();
+            }
+        }
+    }
+    return rayCount;
+}
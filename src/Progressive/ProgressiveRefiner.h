@@ -0,0 +1,49 @@
+#ifndef PROGRESSIVEREFINER_H
+#define PROGRESSIVEREFINER_H
+
+#include "../Framebuffer/Framebuffer.h"
+#include "../Threading/ThreadPool.h"
+#include <chrono>
+#include <functional>
+#include <vector>
+
+const int COARSEST_BLOCK_SIZE = 8;
+
+// Builds an image coarse-to-fine: one sample per 8x8 block, then 4x4, 2x2 and 1x1.
+// Every pass only traces the samples the previous one didn't have, and visits the parent
+// blocks whose samples differ most from their neighbours first, so edges sharpen before flat areas.
+class ProgressiveRefiner {
+    public:
+        using Clock = std::chrono::steady_clock;
+        // Returns the radiance for screen pixel (x, y)
+        using TraceFunction = std::function<glm::vec3(int x, int y)>;
+        using PresentFunction = std::function<void(const HdrFramebuffer& image)>;
+
+    private:
+        HdrFramebuffer image;
+        // Block size the current pass produces, 0 once the image is fully refined
+        int blockSize = 0;
+        int unitsX = 0;
+        int unitsY = 0;
+        std::vector<int> order;
+        std::vector<float> priority;
+        size_t nextUnit = 0;
+
+        void BeginPass();
+        void RefineUnit(int unit, const TraceFunction& trace);
+        void FillBlock(int x, int y, int size, glm::vec4 pixel);
+        float SampleDifference(int unitX, int unitY, int otherX, int otherY) const;
+
+    public:
+        void Resize(int width, int height);
+        void Restart();
+        bool IsComplete() const { return blockSize == 0; }
+        int BlockSize() const { return blockSize; }
+        const HdrFramebuffer& Image() const { return image; }
+
+        // Refines until the image is complete or the deadline passes, presenting after every finished pass
+        // and once more when stopping mid-pass. The coarsest pass always completes. Returns the number of rays traced.
+        Uint64 Refine(ThreadPool& pool, const TraceFunction& trace, Clock::time_point deadline, const PresentFunction& present);
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef RAYCONTEXT_H
+#define RAYCONTEXT_H
+
+#include <SDL2/SDL.h>
+
+// State carried along one camera path through TraceRay and ComputeLighting
+struct RayContext {
+    // Seeded per pixel, frame and sample so stochastic choices are reproducible regardless of thread scheduling
+    Uint32 rngState;
+    // Screen tile of the primary ray while its hit is being shaded, -1 for secondary hits
+    int clusterTile;
+};
+
+#endif
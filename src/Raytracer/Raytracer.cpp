@@ -1,9 +1,53 @@
 #include "Raytracer.h"
+#include "../Sampling/Random.h"
+#include "../Memory/AllocationCounter.h"
+#include "../Profiling/Profiler.h"
 #include "glm/common.hpp"
+#include <algorithm>
+#include <cassert>
 #include <cfloat>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 
-void Raytracer::Initialize() {
+void Raytracer::Initialize(const Settings& settings) {
+    this->settings = settings;
+    windowWidth = settings.windowWidth;
+    windowHeight = settings.windowHeight;
+    camera.SetFov(settings.fov);
+
+    frames.Resize(windowWidth, windowHeight);
+    hdrFrame.Resize(windowWidth, windowHeight);
+    if (settings.accumulate) {
+        accumulatedFrame.Resize(windowWidth, windowHeight);
+    }
+    toneMapper.Configure(settings.toneMapOperator, settings.exposure);
+    renderPool = std::make_unique<ThreadPool>();
+    framePacer.SetTargetFps(settings.targetFps);
+    if (settings.aaMaxSamples > 1) {
+        adaptiveSampler.Configure(settings.aaThreshold, settings.aaMaxSamples);
+        adaptiveSampler.Resize(windowWidth, windowHeight);
+    }
+    if (settings.progressive) {
+        refiner.Resize(windowWidth, windowHeight);
+    } else if (settings.dynamicResolution) {
+        scaledFrame.Resize(windowWidth, windowHeight);
+        dynamicResolution.SetLimits(settings.minRenderScale, 1.0f);
+    }
+    if (settings.wavefront) {
+        wavefront.Reserve();
+    }
+    if (settings.heatmapMaxCost > 0) {
+        heatmap.Configure(settings.heatmapMaxCost);
+        heatmap.Resize(windowWidth, windowHeight);
+    }
+
+    // Benchmarks run headless, so they never touch the video subsystem
+    if (settings.Headless()) {
+        isRunning = true;
+        return;
+    }
+
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         std::cout << "Failed to init SDL" << std::endl;
         return;
@@ -11,11 +55,6 @@ void Raytracer::Initialize() {
 
     SDL_DisplayMode displayMode;
     SDL_GetCurrentDisplayMode(0, &displayMode);
-    windowWidth = 640;
-    windowHeight = 640;
-    viewportWidth = 1;
-    viewportHeight = 1;
-    viewportDepth = 1;
 
     window = SDL_CreateWindow(
         "raytracer",
@@ -34,10 +73,48 @@ void Raytracer::Initialize() {
         return;
     }
 
+    frameTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, windowWidth, windowHeight);
+    if (!frameTexture) {
+        return;
+    }
+
     isRunning = true;
 }
 
 void Raytracer::Setup() {
+    auto setupStart = FramePacer::Now();
+    if (!settings.sceneFile.empty()) {
+        if (!ReadSceneFile(settings.sceneFile, spheres, lights)) {
+            std::cout << "Failed to read scene file " << settings.sceneFile << std::endl;
+            isRunning = false;
+            return;
+        }
+    } else if (settings.sceneDistribution != SceneDistribution::Default) {
+        GenerateScene();
+    } else {
+        AddDefaultScene();
+    }
+
+    AddExtraLights(settings.extraLights);
+    BuildLightStructures();
+
+    AddExtraSpheres(settings.extraSpheres);
+    sceneSetupSeconds = FramePacer::SecondsSince(setupStart);
+    auto buildStart = FramePacer::Now();
+    if ((int)spheres.size() >= BVH_MIN_SPHERES) {
+        sphereBvh.Build(spheres);
+    }
+    bvhBuildSeconds = FramePacer::SecondsSince(buildStart);
+
+    if (!settings.coordinatorAddress.empty()) {
+        StartTileFarm();
+    }
+    if (isRunning && !settings.sharedMemoryName.empty() && settings.sceneOutputFile.empty() && settings.workerAddress.empty()) {
+        StartSharedFrames();
+    }
+}
+
+void Raytracer::AddDefaultScene() {
     SDL_Color red = {255, 0, 0, 255};
     SDL_Color green = {0, 255, 0, 255};
     SDL_Color blue = {0, 0, 255, 255};
@@ -62,13 +139,670 @@ void Raytracer::Setup() {
     lights.push_back(l3);
 }
 
+// Generates the --scene stress scene in parallel chunks, which come out the same on any thread count
+void Raytracer::GenerateScene() {
+    ProceduralSceneSpec spec;
+    spec.distribution = settings.sceneDistribution;
+    spec.sphereCount = settings.sceneSpheres;
+    spec.lightCount = settings.sceneLights;
+    spec.seed = settings.sceneSeed;
+
+    spheres.resize(spec.sphereCount);
+    int chunks = (spec.sphereCount + PROCEDURAL_CHUNK_SIZE - 1) / PROCEDURAL_CHUNK_SIZE;
+    Sphere* out = spheres.data();
+    renderPool->ParallelFor(chunks, [&spec, out](int chunk) {
+        int begin = chunk * PROCEDURAL_CHUNK_SIZE;
+        int end = glm::min(spec.sphereCount, begin + PROCEDURAL_CHUNK_SIZE);
+        GenerateSpheres(spec, begin, end, out + begin);
+    });
+    GenerateLights(spec, lights);
+}
+
+void Raytracer::WriteScene() const {
+    if (WriteSceneFile(settings.sceneOutputFile, spheres, lights)) {
+        std::cout << "Scene with " << spheres.size() << " spheres and " << lights.size() << " lights written to "
+                  << settings.sceneOutputFile << std::endl;
+    } else {
+        std::cout << "Failed to write scene file " << settings.sceneOutputFile << std::endl;
+    }
+}
+
+// Scatters small spheres with random materials in front of the camera, for scenes large enough
+// that traversal order and memory locality matter
+void Raytracer::AddExtraSpheres(int count) {
+    Uint32 rngState = 54321;
+    for (int i = 0; i < count; i++) {
+        glm::vec3 center = glm::vec3(
+            -8.0f + 16.0f * RandomFloat(rngState),
+            -0.9f + 6.0f * RandomFloat(rngState),
+            2.0f + 16.0f * RandomFloat(rngState));
+        float radius = 0.02f + 0.13f * RandomFloat(rngState);
+        SDL_Color color = {
+            (Uint8)(64 + 191 * RandomFloat(rngState)),
+            (Uint8)(64 + 191 * RandomFloat(rngState)),
+            (Uint8)(64 + 191 * RandomFloat(rngState)),
+            255};
+        float specular = RandomFloat(rngState) < 0.5f ? -1.0f : 10.0f + 490.0f * RandomFloat(rngState);
+        spheres.push_back(Sphere(center, radius, color, specular, 0.6f * RandomFloat(rngState)));
+    }
+}
+
+// Scatters dim point lights over the scene for many-light tests. Unlimited range lights
+// share the main point light's intensity between them, ranged lights each get a fixed intensity.
+void Raytracer::AddExtraLights(int count) {
+    float radius = settings.extraLightRadius;
+    float intensity = radius > .0f ? EXTRA_LIGHT_RANGED_INTENSITY : 0.6f / count;
+    Uint32 rngState = 12345;
+    for (int i = 0; i < count; i++) {
+        glm::vec3 position = glm::vec3(
+            -6.0f + 12.0f * RandomFloat(rngState),
+            0.2f + 4.0f * RandomFloat(rngState),
+            10.0f * RandomFloat(rngState));
+        lights.push_back(Light(LightType::Point, intensity, position, glm::vec3(0), radius));
+    }
+}
+
+void Raytracer::BuildLightStructures() {
+    lightTree.Build(lights);
+    PrepareLights();
+    // Sized for the window, the largest canvas a frame renders
+    clusterGrid.Reserve(windowWidth, windowHeight);
+}
+
+// Splits the light list by type for this frame's shading
+void Raytracer::PrepareLights() {
+    PROFILE_ZONE("PrepareLights");
+    lightSet.Build(lights);
+}
+
+Raytracer::TraceKernel Raytracer::SelectTraceKernel() const {
+    unsigned features = 0;
+    if (settings.shadows) {
+        features |= TRACE_SHADOWS;
+    }
+    if (settings.specular) {
+        features |= TRACE_SPECULAR;
+    }
+    if (settings.reflections) {
+        features |= TRACE_REFLECTIONS;
+    }
+    static const TraceKernel kernels[TRACE_FEATURE_COMBINATIONS] = {
+        &Raytracer::TraceRay<0>,
+        &Raytracer::TraceRay<1>,
+        &Raytracer::TraceRay<2>,
+        &Raytracer::TraceRay<3>,
+        &Raytracer::TraceRay<4>,
+        &Raytracer::TraceRay<5>,
+        &Raytracer::TraceRay<6>,
+        &Raytracer::TraceRay<7>
+    };
+    return kernels[features];
+}
+
+// Sets the camera up for a width x height canvas and rebuilds the per-cluster lists of ranged lights for it
+void Raytracer::PrepareView(int width, int height) {
+    camera.Prepare(width, height);
+    if (lightSet.ranged.Count() == 0) {
+        return;
+    }
+    PROFILE_ZONE("LightClusters");
+    clusterGrid.Build(lightSet, camera);
+}
+
+bool Raytracer::SampleLights() const {
+    return settings.lightSamples > 0 && lightTree.LightCount() > LIGHT_TREE_MIN_LIGHTS;
+}
+
 void Raytracer::Run() {
     Setup();
+    if (!isRunning) {
+        return;
+    }
+    PROFILE_THREAD_NAME("main");
+    if (!settings.sceneOutputFile.empty()) {
+        WriteScene();
+    } else if (!settings.workerAddress.empty()) {
+        RunTileWorker();
+    } else if (settings.Animating()) {
+        RunAnimation();
+    } else if (settings.benchmarkFrames > 0) {
+        RunBenchmark();
+    } else if (settings.lightingBenchmarkPoints > 0) {
+        RunLightingBenchmark();
+    } else {
+        // The main thread only pumps events and presents, tracing happens on the render thread
+        IgnoreThreadAllocations();
+        lastInputTime = std::chrono::steady_clock::now();
+        renderThread = std::thread(&Raytracer::RenderLoop, this);
+        while (isRunning) {
+            ProcessInput();
+            Present();
+        }
+        renderThread.join();
+        if (tileFarm) {
+            tileFarm->PrintStats();
+        }
+        if (sharedFrames) {
+            sharedFrames->PrintStats();
+        }
+    }
+    WriteTrace();
+}
+
+// FNV-1a over everything that decides a tile's pixels besides the request itself, so coordinator
+// and workers can check they were started with the same scene
+Uint64 Raytracer::SceneHash() const {
+    Uint64 hash = 14695981039346656037ull;
+    auto add = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    for (const Sphere& sphere : spheres) {
+        float values[9] = {sphere.center.x, sphere.center.y, sphere.center.z, sphere.radius,
+                           sphere.albedo.r, sphere.albedo.g, sphere.albedo.b, sphere.specular, sphere.reflective};
+        add(values, sizeof(values));
+    }
+    for (const Light& light : lights) {
+        float values[9] = {(float)light.type, light.intensity, light.position.x, light.position.y, light.position.z,
+                           light.direction.x, light.direction.y, light.direction.z, light.radius};
+        add(values, sizeof(values));
+    }
+    int shading[6] = {settings.recursionDepth, settings.shadows, settings.specular, settings.reflections,
+                      settings.ssaaSamples, settings.lightSamples};
+    add(shading, sizeof(shading));
+    add(&settings.fov, sizeof(settings.fov));
+    return hash;
+}
+
+void Raytracer::StartTileFarm() {
+    tileFarm = std::make_unique<TileCoordinator>();
+    std::string error;
+    if (!tileFarm->Listen(settings.coordinatorAddress, windowWidth, windowHeight, TILE_SIZE, SceneHash(), error)) {
+        std::cout << "Tile farm: " << error << std::endl;
+        tileFarm.reset();
+        isRunning = false;
+        return;
+    }
+    localTiles.resize((size_t)((windowWidth + TILE_SIZE - 1) / TILE_SIZE) * ((windowHeight + TILE_SIZE - 1) / TILE_SIZE));
+    tileFarm->WaitForWorkers(settings.farmWorkers);
+}
+
+void Raytracer::StartSharedFrames() {
+    sharedFrames = std::make_unique<SharedFrameRing>();
+    std::string error;
+    if (!sharedFrames->Create(settings.sharedMemoryName, windowWidth, windowHeight, settings.sharedMemorySlots, error)) {
+        std::cout << "Shared memory: " << error << std::endl;
+        sharedFrames.reset();
+        isRunning = false;
+        return;
+    }
+    std::cout << "Publishing frames to shared memory " << settings.sharedMemoryName << " (" << settings.sharedMemorySlots
+              << " slots of " << windowWidth << "x" << windowHeight << ")" << std::endl;
+}
+
+// Worker side of the tile farm: traces the tiles the coordinator sends, with this process's own copy
+// of the scene, until the coordinator hangs up
+void Raytracer::RunTileWorker() {
+    PROFILE_THREAD_NAME("main");
+    Socket coordinator;
+    std::string error;
+    for (int attempt = 0; !coordinator.Connect(settings.workerAddress, error) && attempt < FARM_CONNECT_ATTEMPTS; attempt++) {
+        SDL_Delay(FARM_CONNECT_RETRY_MS);
+    }
+    TileHello hello = {TILE_PROTOCOL_VERSION, renderPool->ThreadCount(), SceneHash()};
+    if (!coordinator.Valid() || !SendTileMessage(coordinator, TILE_HELLO, hello)) {
+        std::cout << "Tile worker: " << error << std::endl;
+        return;
+    }
+    std::cout << "Tile worker: connected to " << settings.workerAddress << std::endl;
+
+    std::vector<TileRequest> batch;
+    batch.reserve(FARM_MAX_QUEUED_TILES);
+    std::vector<unsigned char> message(sizeof(TileMessageHeader) + sizeof(TileResult) + TILE_SIZE * TILE_SIZE * 3 * sizeof(float));
+    HdrFramebuffer target;
+    Uint64 tileCount = 0;
+    Uint64 pixelCount = 0;
+    auto start = FramePacer::Now();
+    bool connected = true;
+    while (connected) {
+        // Wait for a request, then take every other one already queued so they are traced in parallel
+        batch.clear();
+        do {
+            TileMessageHeader header;
+            TileRequest request;
+            connected = coordinator.ReceiveAll(&header, sizeof(header)) && header.type == TILE_REQUEST &&
+                        header.size == sizeof(request) && coordinator.ReceiveAll(&request, sizeof(request)) &&
+                        request.width > 0 && request.height > 0 && request.tileIndex >= 0;
+            if (connected) {
+                batch.push_back(request);
+            }
+        } while (connected && (int)batch.size() < FARM_MAX_QUEUED_TILES && coordinator.WaitReadable(0));
+
+        // Requests of one frame share their view, prepare it once per run of them
+        for (size_t begin = 0; begin < batch.size();) {
+            const TileRequest& first = batch[begin];
+            size_t end = begin + 1;
+            while (end < batch.size() && batch[end].frameIndex == first.frameIndex && batch[end].width == first.width &&
+                   batch[end].height == first.height) {
+                end++;
+            }
+            PrepareWorkerFrame(first, target);
+            int width = first.width;
+            int height = first.height;
+            int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+            int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+            renderPool->ParallelFor((int)(end - begin), [&](int i) {
+                if (batch[begin + i].tileIndex < tilesX * tilesY) {
+                    RenderTile(target, width, height, batch[begin + i].tileIndex);
+                }
+            });
+
+            for (size_t i = begin; i < end && connected; i++) {
+                int tileIndex = batch[i].tileIndex;
+                int x0 = (tileIndex % tilesX) * TILE_SIZE;
+                int y0 = (tileIndex / tilesX) * TILE_SIZE;
+                int x1 = glm::min(x0 + TILE_SIZE, width);
+                int y1 = glm::min(y0 + TILE_SIZE, height);
+                TileResult result = {batch[i].frameIndex, tileIndex, tileIndex < tilesX * tilesY ? (x1 - x0) * (y1 - y0) : 0};
+                TileMessageHeader header = {TILE_RESULT, (Uint32)(sizeof(result) + result.pixelCount * 3 * sizeof(float))};
+                std::memcpy(message.data(), &header, sizeof(header));
+                std::memcpy(message.data() + sizeof(header), &result, sizeof(result));
+                float* pixel = (float*)(message.data() + sizeof(header) + sizeof(result));
+                for (int y = y0; y < y1 && result.pixelCount > 0; y++) {
+                    for (int x = x0; x < x1; x++, pixel += 3) {
+                        glm::vec3 radiance = target.GetPixel(x, y);
+                        pixel[0] = radiance.r;
+                        pixel[1] = radiance.g;
+                        pixel[2] = radiance.b;
+                    }
+                }
+                connected = coordinator.SendAll(message.data(), sizeof(header) + header.size);
+                tileCount++;
+                pixelCount += (Uint64)result.pixelCount;
+            }
+            begin = end;
+        }
+    }
+
+    double seconds = FramePacer::SecondsSince(start);
+    std::cout << std::fixed << std::setprecision(2) << "Tile worker: coordinator closed the connection after "
+              << tileCount << " tiles in " << seconds << " s, " << pixelCount / seconds / 1e6 << " M pixels/s" << std::endl;
+}
+
+// Sets up the view of the request's frame, as RenderFrame does on the coordinator
+void Raytracer::PrepareWorkerFrame(const TileRequest& request, HdrFramebuffer& target) {
+    // The previous run of requests is traced and sent, so its frame memory can go
+    ReleaseFrameMemory();
+    frameIndex = request.frameIndex;
+    camera.SetPose(glm::vec3(request.origin[0], request.origin[1], request.origin[2]), request.yaw, request.pitch);
+    if (target.width != request.width || target.height != request.height) {
+        target.Resize(request.width, request.height);
+    }
+    traceKernel = SelectTraceKernel();
+    PrepareView(request.width, request.height);
+}
+
+const char* Raytracer::SceneName() const {
+    return settings.sceneFile.empty() ? SceneDistributionName(settings.sceneDistribution) : settings.sceneFile.c_str();
+}
+
+void Raytracer::WriteTrace() const {
+    if (settings.traceFile.empty()) {
+        return;
+    }
+    if (!PROFILING_ENABLED) {
+        std::cout << "No trace written, profiling zones are only recorded by make profile builds" << std::endl;
+        return;
+    }
+    if (WriteChromeTrace(settings.traceFile)) {
+        std::cout << "Trace written to " << settings.traceFile << std::endl;
+    } else {
+        std::cout << "Failed to write trace to " << settings.traceFile << std::endl;
+    }
+}
+
+void Raytracer::RenderLoop() {
+    PROFILE_THREAD_NAME("render");
+    framePacer.Reset();
     while (isRunning) {
-        ProcessInput();
         Update();
+        RenderTimedFrame();
+        // A fully refined image only changes with the view, so stop tracing until it does
+        if (settings.progressive && refiner.IsComplete()) {
+            WaitForViewChange();
+        }
+    }
+}
+
+void Raytracer::RenderTimedFrame() {
+    auto renderStart = FramePacer::Now();
+    Render();
+    renderTimes.AddSample(FramePacer::SecondsSince(renderStart) * 1000.0);
+}
+
+void Raytracer::RunBenchmark() {
+    int frameCount = settings.benchmarkFrames;
+    primaryRayCount = 0;
+    tracedPixelCount = 0;
+    FrameStats benchmarkTimes(frameCount);
+    Uint64 warmupAllocations = 0;
+    Uint64 steadyAllocations = 0;
+    Uint64 maxSteadyAllocations = 0;
+    RayCounters benchmarkRays;
+    wavefrontStats.Clear();
+    if (settings.wavefront) {
+        cacheMisses.Open();
+    }
+
+    if (!StartFrameOutput(settings.outputPattern, settings.targetFps > 0 ? settings.targetFps : FPS, IMAGE_WRITER_BUFFERS)) {
+        return;
+    }
+
+    auto benchmarkStart = FramePacer::Now();
+    framePacer.SetTargetFps(0);
+    framePacer.Reset();
+    for (int i = 0; i < frameCount; i++) {
+        Update();
+        auto renderStart = FramePacer::Now();
+        Render();
+        double renderMs = FramePacer::SecondsSince(renderStart) * 1000.0;
+        renderTimes.AddSample(renderMs);
+        benchmarkTimes.AddSample(renderMs);
+        benchmarkRays.Add(frameRays);
+        CaptureFrame((int)frameIndex);
+        if (frameIndex <= ALLOCATION_WARMUP_FRAMES) {
+            warmupAllocations += frameAllocations;
+        } else {
+            steadyAllocations += frameAllocations;
+            maxSteadyAllocations = glm::max(maxSteadyAllocations, frameAllocations);
+        }
+    }
+    double totalSeconds = FramePacer::SecondsSince(benchmarkStart);
+    FinishFrameOutput();
+    double primaryRays = (double)primaryRayCount;
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "Benchmark: " << frameCount << " frames at " << windowWidth << "x" << windowHeight
+              << " in " << totalSeconds << " s" << std::endl
+              << "  frame ms avg " << benchmarkTimes.Average()
+              << "  p50 " << benchmarkTimes.Percentile(50)
+              << "  p95 " << benchmarkTimes.Percentile(95)
+              << "  p99 " << benchmarkTimes.Percentile(99)
+              << "  max " << benchmarkTimes.Percentile(100) << std::endl
+              << "  scene: " << SceneName() << ", " << spheres.size() << " spheres, " << lights.size() << " lights, set up in "
+              << sceneSetupSeconds << " s, BVH built in " << bvhBuildSeconds << " s" << std::endl
+              << "  " << frameCount / totalSeconds << " FPS, "
+              << primaryRays / totalSeconds / 1e6 << " M primary rays/s" << std::endl;
+    if (AntiAliasing() && tracedPixelCount > 0) {
+        std::cout << "  " << primaryRays / tracedPixelCount << " samples per pixel" << std::endl;
+    }
+    Uint64 rayCount = benchmarkRays.RayCount();
+    std::cout << "  rays per frame: " << (double)benchmarkRays.rays[RAY_PRIMARY] / frameCount << " primary, "
+              << (double)benchmarkRays.rays[RAY_REFLECTION] / frameCount << " reflection, "
+              << (double)benchmarkRays.rays[RAY_SHADOW] / frameCount << " shadow, up to "
+              << benchmarkRays.maxBounce << " bounces" << std::endl;
+    if (rayCount > 0) {
+        std::cout << "  per ray: " << (double)benchmarkRays.sphereTests / rayCount << " sphere tests, "
+                  << (double)benchmarkRays.nodeVisits / rayCount << " BVH nodes" << std::endl;
+    }
+    int steadyFrames = frameCount - (int)glm::min((Uint32)frameCount, ALLOCATION_WARMUP_FRAMES);
+    std::cout << "  heap allocations: " << warmupAllocations << " in the first " << frameCount - steadyFrames << " frames";
+    if (steadyFrames > 0) {
+        std::cout << ", then " << (double)steadyAllocations / steadyFrames << " per frame (max " << maxSteadyAllocations << ")";
+    }
+    std::cout << std::endl
+              << "  frame arenas " << ThreadArenaReservedBytes() / 1024.0 / 1024.0 << " MiB in "
+              << ThreadArenaGrowCount() << " blocks" << std::endl;
+    if (imageWriter) {
+        imageWriter->PrintStats();
+    }
+    if (frameStream) {
+        frameStream->PrintStats();
+    }
+    if (sharedFrames) {
+        sharedFrames->PrintStats();
+    }
+    if (tileFarm) {
+        tileFarm->PrintStats();
+    }
+    if (settings.wavefront) {
+        wavefrontStats.Print(frameCount);
+        if (!cacheMisses.Available()) {
+            std::cout << "  cache misses not counted (" << cacheMisses.Error() << ")" << std::endl;
+        }
+    }
+}
+
+// Renders the --animate frame range as a pipeline: an update thread moves the scene of frame N+1
+// into a frame slot and refits its BVH, this thread traces frame N through Render, and the image
+// writer's or the stream's thread encodes and saves frame N-1. Slots go back to the update thread once
+// traced and image buffers back to the output once saved, so at most framesInFlight of each exist, and
+// none of the stages allocates once they are sized. Frame N renders the same whatever range it is part of.
+void Raytracer::RunAnimation() {
+    int first = settings.animationFirst;
+    int frameCount = settings.animationLast - first + 1;
+    int slotCount = settings.framesInFlight;
+    // Frames go to files unless they are only streamed
+    std::string pattern = settings.outputPattern.empty() && settings.streamTarget.empty() ? ANIMATION_OUTPUT : settings.outputPattern;
+    if (!StartFrameOutput(pattern, settings.animationFps, slotCount)) {
+        return;
+    }
+
+    // The update thread works from copies, since the tracing stage swaps each frame's scene in
+    std::vector<Sphere> restSpheres = spheres;
+    glm::vec3 restOrigin = cameraPosition;
+    std::vector<AnimationFrame> slots(slotCount);
+    // One extra entry for the nullptr that ends the stage
+    AnimationQueue freeFrames(slotCount + 1);
+    AnimationQueue updatedFrames(slotCount + 1);
+    for (AnimationFrame& slot : slots) {
+        slot.spheres.resize(spheres.size());
+        slot.sphereBvh = sphereBvh;
+        freeFrames.Push(&slot);
+    }
+
+    FrameStats traceTimes(frameCount);
+    double updateSeconds = 0.0;
+    auto animationStart = FramePacer::Now();
+    std::thread updateThread(&Raytracer::UpdateAnimation, this, std::cref(restSpheres), restOrigin,
+        std::ref(freeFrames), std::ref(updatedFrames), std::ref(updateSeconds));
+
+    framePacer.SetTargetFps(0);
+    framePacer.Reset();
+    // Render numbers the frame it traces frameIndex + 1
+    frameIndex = (Uint32)first;
+    allocationWarmupEnd = frameIndex + ALLOCATION_WARMUP_FRAMES;
+    while (AnimationFrame* frame = updatedFrames.Pop()) {
+        spheres.swap(frame->spheres);
+        std::swap(sphereBvh, frame->sphereBvh);
+        {
+            std::lock_guard<std::mutex> lock(viewMutex);
+            cameraPosition = frame->origin;
+            // The scene moved too, so --accumulate starts over every frame
+            viewVersion++;
+        }
+        frameIndex = (Uint32)frame->frame;
+        Update();
+        auto renderStart = FramePacer::Now();
         Render();
+        double renderMs = FramePacer::SecondsSince(renderStart) * 1000.0;
+        renderTimes.AddSample(renderMs);
+        traceTimes.AddSample(renderMs);
+        spheres.swap(frame->spheres);
+        std::swap(sphereBvh, frame->sphereBvh);
+        CaptureFrame(frame->frame);
+        freeFrames.Push(frame);
+    }
+    updateThread.join();
+    FinishFrameOutput();
+    cameraPosition = restOrigin;
+    double totalSeconds = FramePacer::SecondsSince(animationStart);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "Animation: frames " << first << " to " << settings.animationLast << " at " << windowWidth << "x" << windowHeight
+              << " in " << totalSeconds << " s, " << frameCount / totalSeconds << " frames/s, "
+              << slotCount << " in flight" << std::endl
+              << "  per frame ms: update " << updateSeconds * 1000.0 / frameCount
+              << "  trace avg " << traceTimes.Average() << " p95 " << traceTimes.Percentile(95) << std::endl;
+    if (imageWriter) {
+        imageWriter->PrintStats();
+    }
+    if (frameStream) {
+        frameStream->PrintStats();
     }
+    if (sharedFrames) {
+        sharedFrames->PrintStats();
+    }
+}
+
+void Raytracer::UpdateAnimation(const std::vector<Sphere>& restSpheres, glm::vec3 restOrigin, AnimationQueue& freeFrames, AnimationQueue& updatedFrames, double& seconds) {
+    IgnoreThreadAllocations();
+    PROFILE_THREAD_NAME("animation update");
+    for (int frame = settings.animationFirst; frame <= settings.animationLast; frame++) {
+        AnimationFrame* slot = freeFrames.Pop();
+        PROFILE_ZONE("AnimationUpdate");
+        auto updateStart = FramePacer::Now();
+        float time = (float)frame / settings.animationFps;
+        slot->frame = frame;
+        AnimateSpheres(restSpheres, time, slot->spheres);
+        if (!slot->sphereBvh.Empty()) {
+            slot->sphereBvh.Refit(slot->spheres);
+        }
+        slot->origin = AnimateCamera(restOrigin, time);
+        seconds += FramePacer::SecondsSince(updateStart);
+        updatedFrames.Push(slot);
+    }
+    updatedFrames.Push(nullptr);
+}
+
+// Sets up the outputs asked for: files named after pattern (if not empty) and the --stream video,
+// each with bufferCount frame buffers. Returns false if the stream can't be opened.
+bool Raytracer::StartFrameOutput(const std::string& pattern, int fps, int bufferCount) {
+    ImageFormat format;
+    if (ImageFormatFromPath(pattern, format)) {
+        imageWriter = std::make_unique<ImageWriter>(pattern, format, windowWidth, windowHeight, bufferCount, IMAGE_WRITER_THREADS);
+    }
+    if (!settings.streamTarget.empty()) {
+        frameStream = std::make_unique<FrameStream>(settings.streamFormat, windowWidth, windowHeight, fps, bufferCount);
+        std::string error;
+        if (!frameStream->Open(settings.streamTarget, error)) {
+            std::cout << "Failed to open the frame stream: " << error << std::endl;
+            frameStream.reset();
+            imageWriter.reset();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copies the frame just rendered into a buffer of each output: the tone mapped image, or for HDR
+// file formats the radiance it was mapped from. Encoding and writing happen on the outputs' threads.
+void Raytracer::CaptureFrame(int frame) {
+    PROFILE_ZONE("CaptureFrame");
+    if (!imageWriter && !frameStream) {
+        return;
+    }
+    const Framebuffer& image = LatestFrame();
+    if (imageWriter) {
+        ImageJob& job = imageWriter->Acquire();
+        job.frame = frame;
+        if (imageWriter->Hdr()) {
+            const HdrFramebuffer& source = settings.accumulate ? accumulatedFrame : hdrFrame;
+            std::copy(source.pixels.begin(), source.pixels.end(), job.radiance.pixels.begin());
+            job.radianceScale = settings.accumulate ? settings.exposure / accumulatedFrames : settings.exposure;
+        } else {
+            std::copy(image.pixels.begin(), image.pixels.end(), job.image.pixels.begin());
+        }
+        imageWriter->Submit(job);
+    }
+    if (frameStream) {
+        Framebuffer& target = frameStream->Acquire();
+        std::copy(image.pixels.begin(), image.pixels.end(), target.pixels.begin());
+        frameStream->Submit(target);
+    }
+}
+
+// Waits for the outputs to write every captured frame, keeping them around for their statistics
+void Raytracer::FinishFrameOutput() {
+    if (imageWriter) {
+        imageWriter->Finish();
+    }
+    if (frameStream) {
+        frameStream->Finish();
+    }
+}
+
+// Times the type-split light kernels against the per-light reference loop, on shading points
+// gathered from random primary rays of the default view
+void Raytracer::RunLightingBenchmark() {
+    struct ShadingSample {
+        glm::vec3 P;
+        glm::vec3 N;
+        glm::vec3 V;
+        float s;
+    };
+    int pointCount = settings.lightingBenchmarkPoints;
+    std::vector<ShadingSample> samples;
+    samples.reserve(pointCount);
+    Uint32 rngState = 777;
+    camera.Prepare(windowWidth, windowHeight);
+    glm::vec3 O = camera.Position();
+    for (int attempt = 0; (int)samples.size() < pointCount && attempt < pointCount * 16; attempt++) {
+        float sX = RandomFloat(rngState) * windowWidth;
+        float sY = RandomFloat(rngState) * windowHeight;
+        glm::vec3 D = camera.PrimaryDirection(sX, sY);
+        float t;
+        std::optional<Sphere> sphere;
+        ClosestIntersection(O, D, PRIMARY_RAY_TMIN, FLT_MAX, t, sphere);
+        if (sphere) {
+            glm::vec3 P = O + t * D;
+            samples.push_back({P, glm::normalize(P - sphere->center), -D, sphere->specular});
+        }
+    }
+    if (samples.empty()) {
+        std::cout << "Lighting benchmark: no shading points hit the scene" << std::endl;
+        return;
+    }
+
+    // Best of several passes, every light evaluated so both loops compute the same sum
+    int lightSamples = settings.lightSamples;
+    settings.lightSamples = 0;
+    std::vector<float> reference(samples.size());
+    std::vector<float> split(samples.size());
+    double referenceSeconds = DBL_MAX;
+    double splitSeconds = DBL_MAX;
+    for (int pass = 0; pass < LIGHTING_BENCHMARK_PASSES; pass++) {
+        PROFILE_ZONE("LightingBenchmarkPass");
+        auto start = FramePacer::Now();
+        for (size_t k = 0; k < samples.size(); k++) {
+            reference[k] = ComputeLightingReference(samples[k].P, samples[k].N, samples[k].V, samples[k].s);
+        }
+        referenceSeconds = glm::min(referenceSeconds, FramePacer::SecondsSince(start));
+
+        start = FramePacer::Now();
+        for (size_t k = 0; k < samples.size(); k++) {
+            RayContext context = {(Uint32)k, -1};
+            split[k] = ComputeLighting(samples[k].P, samples[k].N, samples[k].V, samples[k].s, context);
+        }
+        splitSeconds = glm::min(splitSeconds, FramePacer::SecondsSince(start));
+    }
+    settings.lightSamples = lightSamples;
+
+    float maxDifference = .0f;
+    for (size_t k = 0; k < samples.size(); k++) {
+        maxDifference = glm::max(maxDifference, glm::abs(reference[k] - split[k]));
+    }
+    double perPoint = 1e9 / samples.size();
+    std::cout << std::fixed << std::setprecision(2)
+              << "Lighting benchmark: " << samples.size() << " shading points, "
+              << lightSet.directional.Count() << " directional, " << lightSet.point.Count() << " point, "
+              << lightSet.ranged.Count() << " ranged lights" << std::endl
+              << "  reference loop " << referenceSeconds * perPoint << " ns/point" << std::endl
+              << "  split kernels  " << splitSeconds * perPoint << " ns/point ("
+              << referenceSeconds / splitSeconds << "x)" << std::endl
+              << std::scientific << "  max difference " << maxDifference << std::endl;
 }
 
 void Raytracer::ProcessInput() {
@@ -86,159 +820,936 @@ void Raytracer::ProcessInput() {
                 break;
         }
     }
+
+    auto now = std::chrono::steady_clock::now();
+    float deltaTime = std::chrono::duration<float>(now - lastInputTime).count();
+    lastInputTime = now;
+
+    // WASD moves in the horizontal plane the camera faces, Q/E down and up, the arrow keys turn it
+    const Uint8* keys = SDL_GetKeyboardState(nullptr);
+    glm::vec3 move = glm::vec3(
+        (float)keys[SDL_SCANCODE_D] - (float)keys[SDL_SCANCODE_A],
+        (float)keys[SDL_SCANCODE_E] - (float)keys[SDL_SCANCODE_Q],
+        (float)keys[SDL_SCANCODE_W] - (float)keys[SDL_SCANCODE_S]);
+    glm::vec2 turn = glm::vec2(
+        (float)keys[SDL_SCANCODE_RIGHT] - (float)keys[SDL_SCANCODE_LEFT],
+        (float)keys[SDL_SCANCODE_UP] - (float)keys[SDL_SCANCODE_DOWN]);
+    if (move != glm::vec3(0) || turn != glm::vec2(0)) {
+        std::lock_guard<std::mutex> lock(viewMutex);
+        cameraYaw += turn.x * CAMERA_TURN_SPEED * deltaTime;
+        cameraPitch = glm::clamp(cameraPitch + turn.y * CAMERA_TURN_SPEED * deltaTime, -CAMERA_MAX_PITCH, CAMERA_MAX_PITCH);
+        if (move != glm::vec3(0)) {
+            glm::vec3 forward = glm::vec3(glm::sin(cameraYaw), 0.0f, glm::cos(cameraYaw));
+            glm::vec3 right = glm::vec3(forward.z, 0.0f, -forward.x);
+            move = glm::normalize(move);
+            cameraPosition += (move.x * right + move.y * glm::vec3(0, 1, 0) + move.z * forward) * CAMERA_SPEED * deltaTime;
+        }
+        viewVersion++;
+        viewChanged.notify_all();
+    }
+    if (!isRunning) {
+        viewChanged.notify_all();
+    }
+}
+
+void Raytracer::SetView(glm::vec3 position, float yaw, float pitch) {
+    std::lock_guard<std::mutex> lock(viewMutex);
+    cameraPosition = position;
+    cameraYaw = yaw;
+    cameraPitch = pitch;
+    viewVersion++;
+    viewChanged.notify_all();
+}
+
+void Raytracer::SyncView() {
+    std::lock_guard<std::mutex> lock(viewMutex);
+    camera.SetPose(cameraPosition, cameraYaw, cameraPitch);
+    frameViewVersion = viewVersion;
+}
+
+// Returns once the view differs from the one the last frame was rendered with, the window closes or
+// REFINED_IDLE_MS pass, whichever comes first
+void Raytracer::WaitForViewChange() {
+    PROFILE_ZONE("Idle");
+    std::unique_lock<std::mutex> lock(viewMutex);
+    viewChanged.wait_for(lock, std::chrono::milliseconds(REFINED_IDLE_MS), [this] {
+        return viewVersion != frameViewVersion || !isRunning;
+    });
 }
 
 void Raytracer::Update() {
-    int timeToWait = MS_PER_FRAME - (SDL_GetTicks() - elapsedTime);
-    if (timeToWait > 0 && timeToWait <= MS_PER_FRAME) {
-        SDL_Delay(timeToWait); 
+    double deltaTime;
+    {
+        PROFILE_ZONE("FramePacing");
+        deltaTime = framePacer.WaitForNextFrame();
     }
+    frameTimes.AddSample(deltaTime * 1000.0);
 
-    double deltaTime = (SDL_GetTicks() - elapsedTime) / 1000.0;
-    std::cout << "FPS: " << 1 / deltaTime << std::endl;
-
-    elapsedTime = SDL_GetTicks();
+    timeSinceReport += deltaTime;
+    if (timeSinceReport >= STATS_REPORT_INTERVAL) {
+        ReportFrameStats();
+        timeSinceReport = 0.0;
+    }
 
     //lights[1].position += glm::vec3(0, glm::sin(elapsedTime), 0);
 }
 
+void Raytracer::ReportFrameStats() {
+    double averageFrameTime = frameTimes.Average();
+    std::cout << std::fixed << std::setprecision(2)
+              << "Frame ms avg " << averageFrameTime
+              << "  p50 " << frameTimes.Percentile(50)
+              << "  p95 " << frameTimes.Percentile(95)
+              << "  p99 " << frameTimes.Percentile(99)
+              << "  | render ms avg " << renderTimes.Average();
+    if (settings.progressive) {
+        std::cout << "  | refining " << (refiner.IsComplete() ? "done" : std::to_string(refiner.BlockSize()) + "x" + std::to_string(refiner.BlockSize()));
+    } else if (settings.dynamicResolution) {
+        std::cout << "  | scale " << dynamicResolution.Scale();
+    }
+    if (AntiAliasing() && reportPixels > 0) {
+        std::cout << "  | " << (double)reportSamples / reportPixels << " spp";
+    }
+    reportSamples = 0;
+    reportPixels = 0;
+    std::cout << "  | " << (averageFrameTime > 0.0 ? 1000.0 / averageFrameTime : 0.0) << " FPS" << std::endl;
+}
+
+// Transient containers take their memory from the per-thread frame arenas, which are rewound here,
+// and every other buffer is sized during the first frames. From then on a frame never touches the heap.
 void Raytracer::Render() {
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
+    PROFILE_ZONE("Render");
+    Uint64 allocationsBefore = HeapAllocationCount();
+    ReleaseFrameMemory();
+    RenderFrame();
+    frameRays = CollectRayCounters();
+    frameAllocations = HeapAllocationCount() - allocationsBefore;
+    assert(frameIndex <= allocationWarmupEnd || frameAllocations == 0);
+}
+
+const Framebuffer& Raytracer::LatestFrame() {
+    frames.AcquireLatest();
+    return frames.Front();
+}
+
+void Raytracer::ReleaseFrameMemory() {
+    wavefront.ReleaseFrameMemory();
+    raySorter.ReleaseFrameMemory();
+    clusterGrid.ReleaseFrameMemory();
+    ResetThreadArenas();
+}
+
+void Raytracer::RenderFrame() {
+    SyncView();
+    PrepareLights();
+    traceKernel = SelectTraceKernel();
+    frameIndex++;
+    if (settings.progressive) {
+        RenderProgressive();
+        return;
+    }
 
-    glm::vec3 origin = glm::vec3(0);
-    for (int x = -windowWidth/2; x <= windowWidth/2; x++) {
-        for (int y = -windowHeight/2; y <= windowHeight/2; y++) {
-            glm::vec3 rayDir = CanvasToViewport(x, y);
-            SDL_Color color = TraceRay(origin, rayDir, (float)viewportDepth, FLT_MAX, RECURSION_DEPTH);
-            PutPixel(x, y, color);
+    Framebuffer& target = frames.Back();
+    if (!settings.dynamicResolution) {
+        TraceFrame(hdrFrame, windowWidth, windowHeight);
+        if (settings.accumulate) {
+            AccumulateFrame(windowWidth, windowHeight);
+            toneMapper.Configure(settings.toneMapOperator, settings.exposure / accumulatedFrames);
+            ToneMapFrame(accumulatedFrame, windowWidth, windowHeight, target);
+        } else {
+            ToneMapFrame(hdrFrame, windowWidth, windowHeight, target);
         }
+        PublishFrame();
+        return;
     }
 
-    SDL_RenderPresent(renderer);
+    float scale = dynamicResolution.Scale();
+    int width = glm::max(1, (int)(windowWidth * scale + 0.5f));
+    int height = glm::max(1, (int)(windowHeight * scale + 0.5f));
+
+    auto traceStart = FramePacer::Now();
+    TraceFrame(hdrFrame, width, height);
+    double traceMs = FramePacer::SecondsSince(traceStart) * 1000.0;
+
+    ToneMapFrame(hdrFrame, width, height, scaledFrame);
+    UpscaleFrame(width, height, target);
+    PublishFrame();
+    dynamicResolution.Update(traceMs, FrameBudgetMs());
+}
+
+// Hands the finished back buffer to the presenter, after copying it out to the --shm readers
+void Raytracer::PublishFrame() {
+    if (sharedFrames) {
+        PROFILE_ZONE("PublishShared");
+        sharedFrames->Publish(frames.Back().pixels.data(), frameIndex);
+    }
+    frames.Publish();
+}
+
+// Adds hdrFrame to the running sum, restarting the sum whenever the view changes.
+// Averaging frames with fresh random numbers converges stochastic light sampling to the exact result.
+void Raytracer::AccumulateFrame(int width, int height) {
+    PROFILE_ZONE("Accumulate");
+    if (accumulatedViewVersion != frameViewVersion || accumulatedFrames == 0) {
+        accumulatedFrames = 0;
+        accumulatedViewVersion = frameViewVersion;
+    }
+    bool restart = accumulatedFrames == 0;
+    accumulatedFrames++;
+
+    int jobs = (height + TONEMAP_ROWS_PER_JOB - 1) / TONEMAP_ROWS_PER_JOB;
+    renderPool->ParallelFor(jobs, [&](int job) {
+        int rowEnd = glm::min((job + 1) * TONEMAP_ROWS_PER_JOB, height);
+        for (int y = job * TONEMAP_ROWS_PER_JOB; y < rowEnd; y++) {
+            glm::vec4* sum = &accumulatedFrame.pixels[(size_t)y * accumulatedFrame.width];
+            const glm::vec4* frame = &hdrFrame.pixels[(size_t)y * hdrFrame.width];
+            for (int x = 0; x < width; x++) {
+                sum[x] = restart ? frame[x] : sum[x] + frame[x];
+            }
+        }
+    });
+}
+
+void Raytracer::RenderProgressive() {
+    PROFILE_ZONE("Progressive");
+    if (refinerViewVersion != frameViewVersion) {
+        refiner.Restart();
+        refinerViewVersion = frameViewVersion;
+    }
+    if (refiner.IsComplete()) {
+        return;
+    }
+    // The cluster lists are in frame memory, so every frame that traces builds them again
+    PrepareView(windowWidth, windowHeight);
+
+    auto deadline = FramePacer::Now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double, std::milli>(FrameBudgetMs()));
+    primaryRayCount += refiner.Refine(*renderPool,
+        [this](int sX, int sY) { return TracePixel(sX, sY, windowWidth); },
+        deadline,
+        [this](const HdrFramebuffer& image) {
+            ToneMapFrame(image, windowWidth, windowHeight, frames.Back());
+            PublishFrame();
+        });
+}
+
+double Raytracer::FrameBudgetMs() const {
+    return settings.targetFps > 0 ? 1000.0 / settings.targetFps : (double)MS_PER_FRAME;
+}
+
+bool Raytracer::AntiAliasing() const {
+    return settings.aaMaxSamples > 1 || settings.ssaaSamples > 1;
+}
+
+// Progressive frames trace one ray per block, which has no per-pixel cost to show
+bool Raytracer::ShowHeatmap() const {
+    return settings.heatmapMaxCost > 0 && !settings.progressive;
+}
+
+void Raytracer::TraceFrame(HdrFramebuffer& target, int width, int height) {
+    PROFILE_ZONE("TraceFrame");
+    PrepareView(width, height);
+    // The heatmap charges each pixel the work of its own rays, which neither the wavefront's shared
+    // stages nor remote workers track
+    if (tileFarm && !ShowHeatmap()) {
+        TraceFarmFrame(target, width, height);
+    } else if (settings.wavefront && settings.ssaaSamples == 1 && !ShowHeatmap()) {
+        TraceWavefront(target, width, height);
+    } else {
+        int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        renderPool->ParallelFor(tilesX * tilesY, [&](int tileIndex) {
+            RenderTile(target, width, height, tileIndex);
+        });
+    }
+    Uint64 samples = (Uint64)width * height * settings.ssaaSamples;
+
+    if (settings.aaMaxSamples > 1 && settings.ssaaSamples == 1) {
+        PROFILE_ZONE("AdaptiveSampling");
+        // Captured by value, small enough for std::function to store without allocating
+        samples += adaptiveSampler.Refine(*renderPool, target, width, height, [this, width](int sX, int sY, glm::vec2 offset) {
+            return TracePixel(sX, sY, width, offset);
+        });
+    }
+
+    primaryRayCount += samples;
+    tracedPixelCount += (Uint64)width * height;
+    reportSamples += samples;
+    reportPixels += (Uint64)width * height;
+}
+
+// Traces one tile of a width x height canvas into the top-left of target
+void Raytracer::RenderTile(HdrFramebuffer& target, int width, int height, int tileIndex) {
+    PROFILE_ZONE("Tile");
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int x0 = (tileIndex % tilesX) * TILE_SIZE;
+    int y0 = (tileIndex / tilesX) * TILE_SIZE;
+    int x1 = glm::min(x0 + TILE_SIZE, width);
+    int y1 = glm::min(y0 + TILE_SIZE, height);
+
+    if (settings.ssaaSamples > 1) {
+        for (int sY = y0; sY < y1; sY++) {
+            for (int sX = x0; sX < x1; sX++) {
+                target.SetPixel(sX, sY, SupersamplePixel(sX, sY, width, settings.ssaaSamples));
+            }
+        }
+        return;
+    }
+
+    // The whole tile's primary rays at once, a packet of neighbouring pixels at a time
+    RayPacket packets[TILE_SIZE * TILE_SIZE / RAY_PACKET_WIDTH];
+    int packetsPerRow = camera.GenerateTile(x0, y0, x1 - x0, y1 - y0, packets);
+    for (int sY = y0; sY < y1; sY++) {
+        const RayPacket* row = &packets[(sY - y0) * packetsPerRow];
+        for (int sX = x0; sX < x1; sX++) {
+            int column = sX - x0;
+            target.SetPixel(sX, sY, TracePrimary(sX, sY, width, row[column / RAY_PACKET_WIDTH].Direction(column % RAY_PACKET_WIDTH)));
+        }
+    }
+}
+
+void Raytracer::TraceFarmFrame(HdrFramebuffer& target, int width, int height) {
+    FarmFrame frame = {frameIndex, width, height, camera.Position(), camera.Yaw(), camera.Pitch()};
+    int count = tileFarm->TraceFrame(frame, target, localTiles.data());
+    // Tracing locally for the first time sets up this thread's ray counters and frame arena
+    if (count > 0 && !tracedFarmTilesLocally) {
+        tracedFarmTilesLocally = true;
+        allocationWarmupEnd = frameIndex + ALLOCATION_WARMUP_FRAMES;
+    }
+    renderPool->ParallelFor(count, [&](int i) {
+        RenderTile(target, width, height, localTiles[i]);
+    });
+}
+
+Uint32 Raytracer::PixelSeed(int sX, int sY, int width, glm::vec2 offset) const {
+    Uint32 seed = HashUint((Uint32)(sY * width + sX) ^ HashUint(frameIndex));
+    return HashUint(seed ^ (Uint32)((offset.x + 0.5f) * 65536.0f) ^ ((Uint32)((offset.y + 0.5f) * 65536.0f) << 16));
+}
+
+// Wavefront alternative to tracing tile by tile: a batch of primary rays goes through intersection,
+// compaction by material, shading and shadow rays as separate stages, each parallel over the batch,
+// and the reflection rays shading emits become the next batch until none are left.
+// Radiance is summed per light rather than per hit, so results match TracePixel up to float rounding.
+void Raytracer::TraceWavefront(HdrFramebuffer& target, int width, int height) {
+    int pixelCount = width * height;
+    for (int begin = 0; begin < pixelCount; begin += WAVEFRONT_BATCH_SIZE) {
+        int count = glm::min(WAVEFRONT_BATCH_SIZE, pixelCount - begin);
+        WavefrontGenerate(target, width, begin, count);
+        RayCounters& counters = ThreadRayCounters();
+        counters.rays[RAY_PRIMARY] += count;
+        for (int bounce = 0; !wavefront.rays.empty(); bounce++) {
+            WavefrontIntersect(target);
+            WavefrontCompact();
+            int jobs = WavefrontShade(target, bounce);
+            WavefrontShadows(target, jobs);
+            WavefrontGather(jobs);
+            if (!wavefront.rays.empty()) {
+                counters.rays[RAY_REFLECTION] += wavefront.rays.size();
+                counters.maxBounce = glm::max(counters.maxBounce, bounce + 1);
+            }
+        }
+    }
+}
+
+// Primary rays for pixels [begin, begin + count) of the canvas, clearing their radiance
+void Raytracer::WavefrontGenerate(HdrFramebuffer& target, int width, int begin, int count) {
+    PROFILE_ZONE("Generate");
+    auto start = FramePacer::Now();
+    std::vector<WavefrontRay>& rays = wavefront.rays;
+    rays.resize(count);
+    bool clustered = lightSet.ranged.Count() > 0;
+    int jobs = (count + WAVEFRONT_JOB_SIZE - 1) / WAVEFRONT_JOB_SIZE;
+    renderPool->ParallelFor(jobs, [&](int job) {
+        int end = glm::min((job + 1) * WAVEFRONT_JOB_SIZE, count);
+        for (int i = job * WAVEFRONT_JOB_SIZE; i < end; i++) {
+            int sX = (begin + i) % width;
+            int sY = (begin + i) / width;
+            WavefrontRay& ray = rays[i];
+            ray.origin = camera.Position();
+            ray.tMin = PRIMARY_RAY_TMIN;
+            ray.direction = camera.PrimaryDirection((float)sX, (float)sY);
+            ray.throughput = 1.0f;
+            ray.pixel = sY * target.width + sX;
+            ray.clusterTile = clustered ? clusterGrid.TileIndex(sX, sY) : -1;
+            ray.rngState = PixelSeed(sX, sY, width, glm::vec2(0));
+            target.pixels[ray.pixel] = glm::vec4(0, 0, 0, 1);
+        }
+    });
+    wavefrontStats.Add(WAVEFRONT_GENERATE, FramePacer::SecondsSince(start), count);
+}
+
+void Raytracer::WavefrontIntersect(HdrFramebuffer& target) {
+    PROFILE_ZONE("Intersect");
+    auto start = FramePacer::Now();
+    const std::vector<WavefrontRay>& rays = wavefront.rays;
+    int count = (int)rays.size();
+    wavefront.hitSpheres.resize(count);
+    wavefront.hitDistances.resize(count);
+    cacheMisses.Start();
+    int jobs = (count + WAVEFRONT_JOB_SIZE - 1) / WAVEFRONT_JOB_SIZE;
+    renderPool->ParallelFor(jobs, [&](int job) {
+        PROFILE_ZONE("IntersectJob");
+        int end = glm::min((job + 1) * WAVEFRONT_JOB_SIZE, count);
+        for (int i = job * WAVEFRONT_JOB_SIZE; i < end; i++) {
+            const WavefrontRay& ray = rays[i];
+            wavefront.hitSpheres[i] = ClosestSphere(ray.origin, ray.direction, ray.tMin, FLT_MAX, wavefront.hitDistances[i]);
+            if (wavefront.hitSpheres[i] < 0) {
+                target.pixels[ray.pixel] += glm::vec4(ray.throughput * BACKGROUND_COLOR, 0.0f);
+            }
+        }
+    });
+    wavefrontStats.Add(WAVEFRONT_INTERSECT, FramePacer::SecondsSince(start), count);
+    if (cacheMisses.Available()) {
+        wavefrontStats.AddMisses(WAVEFRONT_INTERSECT, cacheMisses.Stop());
+    }
+}
+
+// Drops misses and groups the hits by material with a counting sort: every job counts its hits per
+// material, and after a prefix sum over jobs scatters them to its own range, so hits keep ray order
+void Raytracer::WavefrontCompact() {
+    PROFILE_ZONE("Compact");
+    auto start = FramePacer::Now();
+    auto material = [&](int sphere) {
+        return settings.specular && spheres[sphere].specular != -1.0f ? WAVEFRONT_PHONG : WAVEFRONT_DIFFUSE;
+    };
+
+    int count = (int)wavefront.rays.size();
+    int jobs = (count + WAVEFRONT_JOB_SIZE - 1) / WAVEFRONT_JOB_SIZE;
+    std::vector<int>& jobHitBegin = wavefront.jobHitBegin;
+    jobHitBegin.assign(jobs * WAVEFRONT_MATERIAL_COUNT, 0);
+    renderPool->ParallelFor(jobs, [&](int job) {
+        int* counts = &jobHitBegin[job * WAVEFRONT_MATERIAL_COUNT];
+        int end = glm::min((job + 1) * WAVEFRONT_JOB_SIZE, count);
+        for (int i = job * WAVEFRONT_JOB_SIZE; i < end; i++) {
+            if (wavefront.hitSpheres[i] >= 0) {
+                counts[material(wavefront.hitSpheres[i])]++;
+            }
+        }
+    });
+    int sum = 0;
+    for (int m = 0; m < WAVEFRONT_MATERIAL_COUNT; m++) {
+        wavefront.materialBegin[m] = sum;
+        for (int job = 0; job < jobs; job++) {
+            int hits = jobHitBegin[job * WAVEFRONT_MATERIAL_COUNT + m];
+            jobHitBegin[job * WAVEFRONT_MATERIAL_COUNT + m] = sum;
+            sum += hits;
+        }
+    }
+    wavefront.materialBegin[WAVEFRONT_MATERIAL_COUNT] = sum;
+    wavefront.hits.resize(sum);
+    renderPool->ParallelFor(jobs, [&](int job) {
+        int* cursors = &jobHitBegin[job * WAVEFRONT_MATERIAL_COUNT];
+        int end = glm::min((job + 1) * WAVEFRONT_JOB_SIZE, count);
+        for (int i = job * WAVEFRONT_JOB_SIZE; i < end; i++) {
+            int sphere = wavefront.hitSpheres[i];
+            if (sphere >= 0) {
+                wavefront.hits[cursors[material(sphere)]++] = {i, sphere, wavefront.hitDistances[i]};
+            }
+        }
+    });
+    wavefrontStats.Add(WAVEFRONT_COMPACT, FramePacer::SecondsSince(start), count);
+}
+
+// Shades every hit, one material at a time. Returns the number of jobs whose output queues were filled.
+int Raytracer::WavefrontShade(HdrFramebuffer& target, int bounce) {
+    PROFILE_ZONE("Shade");
+    auto start = FramePacer::Now();
+    int jobBegin[WAVEFRONT_MATERIAL_COUNT + 1];
+    jobBegin[0] = 0;
+    for (int m = 0; m < WAVEFRONT_MATERIAL_COUNT; m++) {
+        int hits = wavefront.materialBegin[m + 1] - wavefront.materialBegin[m];
+        jobBegin[m + 1] = jobBegin[m] + (hits + WAVEFRONT_JOB_SIZE - 1) / WAVEFRONT_JOB_SIZE;
+    }
+    wavefront.PrepareJobs(jobBegin[WAVEFRONT_MATERIAL_COUNT]);
+
+    for (int m = 0; m < WAVEFRONT_MATERIAL_COUNT; m++) {
+        renderPool->ParallelFor(jobBegin[m + 1] - jobBegin[m], [&](int job) {
+            int begin = wavefront.materialBegin[m] + job * WAVEFRONT_JOB_SIZE;
+            int end = glm::min(begin + WAVEFRONT_JOB_SIZE, wavefront.materialBegin[m + 1]);
+            int queue = jobBegin[m] + job;
+            if (m == WAVEFRONT_PHONG) {
+                if (settings.shadows) {
+                    ShadeWavefrontHits<true, true>(target, begin, end, bounce, queue);
+                } else {
+                    ShadeWavefrontHits<true, false>(target, begin, end, bounce, queue);
+                }
+            } else if (settings.shadows) {
+                ShadeWavefrontHits<false, true>(target, begin, end, bounce, queue);
+            } else {
+                ShadeWavefrontHits<false, false>(target, begin, end, bounce, queue);
+            }
+        });
+    }
+    wavefrontStats.Add(WAVEFRONT_SHADE, FramePacer::SecondsSince(start), wavefront.hits.size());
+    return jobBegin[WAVEFRONT_MATERIAL_COUNT];
+}
+
+// Adds ambient light directly and queues a shadow ray per contributing light and a reflection ray per
+// reflective hit. A pixel has at most one ray per bounce, so no other job touches its radiance.
+template <bool Specular, bool Shadows>
+void Raytracer::ShadeWavefrontHits(HdrFramebuffer& target, int begin, int end, int bounce, int job) {
+    PROFILE_ZONE("ShadeJob");
+    FrameVector<ShadowRay>& shadowRays = wavefront.jobShadowRays[job];
+    FrameVector<WavefrontRay>& reflectionRays = wavefront.jobReflectionRays[job];
+    for (int h = begin; h < end; h++) {
+        const WavefrontHit& hit = wavefront.hits[h];
+        const WavefrontRay& ray = wavefront.rays[hit.ray];
+        const Sphere& sphere = spheres[hit.sphere];
+
+        glm::vec3 P = ray.origin + hit.t * ray.direction;
+        glm::vec3 N = glm::normalize(P - sphere.center);
+        ShadingPoint point = {P, N, -ray.direction, 1.0f / glm::length(ray.direction), sphere.specular};
+        RayContext context = {ray.rngState, ray.clusterTile};
+
+        float r = sphere.reflective;
+        bool reflect = settings.reflections && bounce < settings.recursionDepth && r > .0f;
+        // Radiance reaching the pixel per unit of light intensity at this point
+        glm::vec3 weight = sphere.albedo * (ray.throughput * (reflect ? 1.0f - r : 1.0f));
+        glm::vec4& pixel = target.pixels[ray.pixel];
+        pixel += glm::vec4(weight * lightSet.ambient, 0.0f);
+        GatherLights<Specular>(point, context, [&](glm::vec3 L, float tMax, const LightBatch& batch, int k) {
+            glm::vec3 radiance = weight * BatchContribution<Specular>(batch, k, point.s);
+            if (Shadows) {
+                shadowRays.push_back({P, tMax, L, ray.pixel, radiance});
+            } else {
+                pixel += glm::vec4(radiance, 0.0f);
+            }
+        });
+
+        if (reflect) {
+            reflectionRays.push_back({P, 0.01f, ReflectRay(-ray.direction, N), ray.throughput * r, ray.pixel, -1, context.rngState});
+        }
+    }
+}
+
+void Raytracer::WavefrontShadows(HdrFramebuffer& target, int jobs) {
+    PROFILE_ZONE("Shadows");
+    if (settings.sortRays) {
+        WavefrontSortedShadows(target, jobs);
+        return;
+    }
+
+    auto start = FramePacer::Now();
+    cacheMisses.Start();
+    std::atomic<Uint64> shadowRayCount{0};
+    renderPool->ParallelFor(jobs, [&](int job) {
+        PROFILE_ZONE("ShadowJob");
+        const FrameVector<ShadowRay>& shadowRays = wavefront.jobShadowRays[job];
+        for (const ShadowRay& shadowRay : shadowRays) {
+            if (!Occluded(shadowRay.origin, shadowRay.direction, 0.001f, shadowRay.tMax)) {
+                target.pixels[shadowRay.pixel] += glm::vec4(shadowRay.radiance, 0.0f);
+            }
+        }
+        shadowRayCount += shadowRays.size();
+    });
+    wavefrontStats.Add(WAVEFRONT_SHADOW, FramePacer::SecondsSince(start), shadowRayCount);
+    if (cacheMisses.Available()) {
+        wavefrontStats.AddMisses(WAVEFRONT_SHADOW, cacheMisses.Stop());
+    }
+}
+
+// Flattens every job's shadow rays in parallel and traces them in sorted order, then adds the radiance of the
+// unoccluded ones job by job, so each pixel is still only ever written by a single job
+void Raytracer::WavefrontSortedShadows(HdrFramebuffer& target, int jobs) {
+    PROFILE_ZONE("Shadows");
+    auto start = FramePacer::Now();
+    FrameVector<ShadowRay>& shadowRays = wavefront.shadowRays;
+    FrameVector<int>& jobShadowBegin = wavefront.jobShadowBegin;
+    jobShadowBegin.resize(jobs + 1);
+    int count = 0;
+    for (int job = 0; job < jobs; job++) {
+        jobShadowBegin[job] = count;
+        count += (int)wavefront.jobShadowRays[job].size();
+    }
+    jobShadowBegin[jobs] = count;
+    shadowRays.resize(count);
+    renderPool->ParallelFor(jobs, [&](int job) {
+        std::copy(wavefront.jobShadowRays[job].begin(), wavefront.jobShadowRays[job].end(), shadowRays.begin() + jobShadowBegin[job]);
+    });
+    const FrameVector<int>& order = raySorter.Sort(*renderPool, shadowRays.data(), count);
+    wavefrontStats.Add(WAVEFRONT_SORT, FramePacer::SecondsSince(start), count);
+
+    start = FramePacer::Now();
+    cacheMisses.Start();
+    FrameVector<unsigned char>& visible = wavefront.shadowVisible;
+    visible.resize(count);
+    int traceJobs = (count + WAVEFRONT_JOB_SIZE - 1) / WAVEFRONT_JOB_SIZE;
+    renderPool->ParallelFor(traceJobs, [&](int job) {
+        PROFILE_ZONE("ShadowJob");
+        int end = glm::min((job + 1) * WAVEFRONT_JOB_SIZE, count);
+        for (int i = job * WAVEFRONT_JOB_SIZE; i < end; i++) {
+            const ShadowRay& shadowRay = shadowRays[order[i]];
+            visible[order[i]] = !Occluded(shadowRay.origin, shadowRay.direction, 0.001f, shadowRay.tMax);
+        }
+    });
+    renderPool->ParallelFor(jobs, [&](int job) {
+        for (int i = jobShadowBegin[job]; i < jobShadowBegin[job + 1]; i++) {
+            if (visible[i]) {
+                target.pixels[shadowRays[i].pixel] += glm::vec4(shadowRays[i].radiance, 0.0f);
+            }
+        }
+    });
+    wavefrontStats.Add(WAVEFRONT_SHADOW, FramePacer::SecondsSince(start), count);
+    if (cacheMisses.Available()) {
+        wavefrontStats.AddMisses(WAVEFRONT_SHADOW, cacheMisses.Stop());
+    }
+}
+
+// Collects the reflection rays of every shading job into the next batch, each job copying its own
+// at an offset from a prefix sum over the queue sizes
+void Raytracer::WavefrontGather(int jobs) {
+    PROFILE_ZONE("Gather");
+    auto start = FramePacer::Now();
+    std::vector<WavefrontRay>& rays = wavefront.rays;
+    std::vector<int>& jobRayBegin = wavefront.jobRayBegin;
+    jobRayBegin.resize(jobs + 1);
+    jobRayBegin[0] = 0;
+    for (int job = 0; job < jobs; job++) {
+        jobRayBegin[job + 1] = jobRayBegin[job] + (int)wavefront.jobReflectionRays[job].size();
+    }
+    rays.resize(jobRayBegin[jobs]);
+    renderPool->ParallelFor(jobs, [&](int job) {
+        std::copy(wavefront.jobReflectionRays[job].begin(), wavefront.jobReflectionRays[job].end(), rays.begin() + jobRayBegin[job]);
+    });
+    wavefrontStats.Add(WAVEFRONT_GATHER, FramePacer::SecondsSince(start), rays.size());
+
+    if (settings.sortRays && rays.size() > 1) {
+        start = FramePacer::Now();
+        int count = (int)rays.size();
+        const FrameVector<int>& order = raySorter.Sort(*renderPool, rays.data(), count);
+        std::vector<WavefrontRay>& sortedRays = wavefront.sortedRays;
+        sortedRays.resize(count);
+        int copyJobs = (count + WAVEFRONT_JOB_SIZE - 1) / WAVEFRONT_JOB_SIZE;
+        renderPool->ParallelFor(copyJobs, [&](int job) {
+            int end = glm::min((job + 1) * WAVEFRONT_JOB_SIZE, count);
+            for (int i = job * WAVEFRONT_JOB_SIZE; i < end; i++) {
+                sortedRays[i] = rays[order[i]];
+            }
+        });
+        rays.swap(sortedRays);
+        wavefrontStats.Add(WAVEFRONT_SORT, FramePacer::SecondsSince(start), count);
+    }
 }
 
-void Raytracer::PutPixel(int x, int y, SDL_Color color) {
-    int sX = windowWidth / 2 + x;
-    int sY = windowHeight / 2 - y;
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-    SDL_RenderDrawPoint(renderer, sX, sY);
+// Traces the primary ray through screen pixel (sX, sY) of the canvas the camera is prepared for,
+// which is width pixels wide, offset within the pixel by a fraction of a pixel
+glm::vec3 Raytracer::TracePixel(int sX, int sY, int width, glm::vec2 offset) {
+    return TracePrimary(sX, sY, width, camera.PrimaryDirection(sX + offset.x, sY + offset.y), offset);
+}
+
+// Traces pixel (sX, sY)'s primary ray with the given direction from the camera
+glm::vec3 Raytracer::TracePrimary(int sX, int sY, int width, glm::vec3 direction, glm::vec2 offset) {
+    RayContext context;
+    context.rngState = PixelSeed(sX, sY, width, offset);
+    context.clusterTile = lightSet.ranged.Count() == 0 ? -1 : clusterGrid.TileIndex(sX, sY);
+    RayCounters& counters = ThreadRayCounters();
+    counters.rays[RAY_PRIMARY]++;
+    if (!ShowHeatmap()) {
+        return (this->*traceKernel)(camera.Position(), direction, PRIMARY_RAY_TMIN, FLT_MAX, settings.recursionDepth, context);
+    }
+    Uint64 costBefore = counters.Cost();
+    glm::vec3 color = (this->*traceKernel)(camera.Position(), direction, PRIMARY_RAY_TMIN, FLT_MAX, settings.recursionDepth, context);
+    heatmap.AddCost(sX, sY, counters.Cost() - costBefore);
+    return color;
 }
 
-glm::vec3 Raytracer::CanvasToViewport(int x, int y) {
-    float vX = (float)x * (float)viewportWidth / (float)windowWidth;
-    float vY = (float)y * (float)viewportHeight / (float)windowHeight;
-    float vZ = (float)viewportDepth;
-    return glm::vec3(vX, vY, vZ);
+glm::vec3 Raytracer::SupersamplePixel(int sX, int sY, int width, int samples) {
+    glm::vec3 sum = glm::vec3(0);
+    for (int i = 0; i < samples; i++) {
+        sum += TracePixel(sX, sY, width, AdaptiveSampler::SampleOffset(i));
+    }
+    return sum / (float)samples;
 }
 
-SDL_Color Raytracer::TraceRay(glm::vec3 O, glm::vec3 D, float tMin, float tMax, unsigned short recursionDepth) {
-    float closestT;
-    std::optional<Sphere> closestSphere;
-    ClosestIntersection(O, D, tMin, tMax, closestT, closestSphere);
-    if (!closestSphere) {
-         return BACKGROUND_COLOR;
-    }                  
+void Raytracer::ToneMapFrame(const HdrFramebuffer& source, int width, int height, Framebuffer& target) {
+    PROFILE_ZONE("ToneMap");
+    int jobs = (height + TONEMAP_ROWS_PER_JOB - 1) / TONEMAP_ROWS_PER_JOB;
+    renderPool->ParallelFor(jobs, [&](int job) {
+        int rowBegin = job * TONEMAP_ROWS_PER_JOB;
+        int rowEnd = glm::min(rowBegin + TONEMAP_ROWS_PER_JOB, height);
+        if (ShowHeatmap()) {
+            // Shown in place of the image, and cleared for the next frame
+            heatmap.MapRows(target, width, rowBegin, rowEnd);
+            heatmap.ClearRows(width, rowBegin, rowEnd);
+        } else {
+            toneMapper.MapRows(source, target, width, rowBegin, rowEnd);
+        }
+    });
+}
 
-    glm::vec3 P = O + closestT * D;
-    glm::vec3 N = P - closestSphere->center;
-    N = glm::normalize(N);
-    float lightIntensityAtPoint = ComputeLighting(P, N, -D, closestSphere->specular);
-    SDL_Color colorAtPoint = closestSphere->color;
-    colorAtPoint.r = glm::clamp(colorAtPoint.r * lightIntensityAtPoint, 0.0f, 255.0f);
-    colorAtPoint.g = glm::clamp(colorAtPoint.g * lightIntensityAtPoint, 0.0f, 255.0f);
-    colorAtPoint.b = glm::clamp(colorAtPoint.b * lightIntensityAtPoint, 0.0f, 255.0f);
+void Raytracer::UpscaleFrame(int sourceWidth, int sourceHeight, Framebuffer& target) {
+    PROFILE_ZONE("Upscale");
+    upscaler.Prepare(sourceWidth, sourceHeight, target.width, target.height);
+    int jobs = (target.height + UPSCALE_ROWS_PER_JOB - 1) / UPSCALE_ROWS_PER_JOB;
+    renderPool->ParallelFor(jobs, [&](int job) {
+        int rowBegin = job * UPSCALE_ROWS_PER_JOB;
+        int rowEnd = glm::min(rowBegin + UPSCALE_ROWS_PER_JOB, target.height);
+        upscaler.UpscaleRows(scaledFrame, target, rowBegin, rowEnd, settings.upscaleFilter);
+    });
+}
 
-    float r = closestSphere->reflective;
-    if (recursionDepth <= 0 || r <= .0f) {
-        return colorAtPoint;    
+void Raytracer::Present() {
+    if (!frames.AcquireLatest()) {
+        // Nothing new to show, sleep until input arrives or the next frame might be ready
+        SDL_WaitEventTimeout(nullptr, PRESENT_POLL_MS);
+        return;
     }
 
-    glm::vec3 R = ReflectRay(-D, N);
-    SDL_Color reflectedColor = TraceRay(P, R, 0.01f, FLT_MAX, recursionDepth - 1); 
+    PROFILE_ZONE("Present");
+    const Framebuffer& front = frames.Front();
+    SDL_UpdateTexture(frameTexture, nullptr, front.pixels.data(), front.Pitch());
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, frameTexture, nullptr, nullptr);
+    SDL_RenderPresent(renderer);
+}
+
+// One kernel per feature set, picked once per frame by SelectTraceKernel, with disabled features compiled out.
+// Reflections are followed in a loop rather than by recursion: each hit adds its own color scaled by
+// the throughput of the path so far, (1 - r) of it, and passes r on to the reflected ray.
+template <unsigned Features>
+glm::vec3 Raytracer::TraceRay(glm::vec3 O, glm::vec3 D, float tMin, float tMax, int maxBounces, RayContext& context) {
+    constexpr bool Shadows = (Features & TRACE_SHADOWS) != 0;
+    constexpr bool Specular = (Features & TRACE_SPECULAR) != 0;
+    constexpr bool Reflections = (Features & TRACE_REFLECTIONS) != 0;
+
+    glm::vec3 color = glm::vec3(0);
+    float throughput = 1.0f;
+    for (int bounce = 0; ; bounce++) {
+        float closestT;
+        int closestIndex = ClosestSphere(O, D, tMin, tMax, closestT);
+        if (closestIndex < 0) {
+            return color + throughput * BACKGROUND_COLOR;
+        }
+        const Sphere& closestSphere = spheres[closestIndex];
+
+        glm::vec3 P = O + closestT * D;
+        glm::vec3 N = glm::normalize(P - closestSphere.center);
+        ShadingPoint point = {P, N, -D, 1.0f / glm::length(D), closestSphere.specular};
+        float lightIntensityAtPoint;
+        if (Specular && point.s != -1.0f) {
+            lightIntensityAtPoint = ShadeLights<Specular, Shadows>(point, context);
+        } else {
+            lightIntensityAtPoint = ShadeLights<false, Shadows>(point, context);
+        }
+        context.clusterTile = -1;
+        glm::vec3 colorAtPoint = closestSphere.albedo * lightIntensityAtPoint;
+
+        float r = closestSphere.reflective;
+        if (!Reflections || bounce >= maxBounces || r <= .0f) {
+            return color + throughput * colorAtPoint;
+        }
+        color += throughput * (1.0f - r) * colorAtPoint;
+        throughput *= r;
+        RayCounters& counters = ThreadRayCounters();
+        counters.rays[RAY_REFLECTION]++;
+        counters.maxBounce = glm::max(counters.maxBounce, bounce + 1);
 
-    colorAtPoint.r = colorAtPoint.r * (1.0f - r) + reflectedColor.r * r;
-    colorAtPoint.g = colorAtPoint.g * (1.0f - r) + reflectedColor.g * r;
-    colorAtPoint.b = colorAtPoint.b * (1.0f - r) + reflectedColor.b * r;
-    return colorAtPoint;
+        O = P;
+        D = ReflectRay(-D, N);
+        tMin = 0.01f;
+        tMax = FLT_MAX;
+    }
 }
 
 void Raytracer::ClosestIntersection(glm::vec3 O, glm::vec3 D, float tMin, float tMax, float& closestT, std::optional<Sphere>& closestSphere) {
-    closestT = tMax;
+    int index = ClosestSphere(O, D, tMin, tMax, closestT);
+    if (index >= 0) {
+        closestSphere = spheres[index];
+    }
+}
 
-    for (auto sphere : spheres) {
+// Index of the closest sphere hit within (tMin, tMax), or -1
+int Raytracer::ClosestSphere(glm::vec3 O, glm::vec3 D, float tMin, float tMax, float& closestT) {
+    if (!sphereBvh.Empty()) {
+        return sphereBvh.Closest(spheres, O, D, tMin, tMax, closestT);
+    }
+    closestT = tMax;
+    int closest = -1;
+    ThreadRayCounters().sphereTests += spheres.size();
+    for (int index = 0; index < (int)spheres.size(); index++) {
         float t1, t2 = .0f;
-        IntersectRaySphere(O, D, sphere, t1, t2);
+        IntersectRaySphere(O, D, spheres[index], t1, t2);
         if (t1 > tMin && t1 < tMax && t1 < closestT) {
             closestT = t1;
-            closestSphere = sphere;
+            closest = index;
         }
         if (t2 > tMin && t2 < tMax && t2 < closestT) {
             closestT = t2;
-            closestSphere = sphere;
+            closest = index;
         }
     }
+    return closest;
 }
 
-void Raytracer::IntersectRaySphere(glm::vec3 O, glm::vec3 D, Sphere sphere, float& t1, float& t2) {
-    float r = sphere.radius;
-    glm::vec3 CO = O - sphere.center;
-    
-    float a = glm::dot(D, D);
-    float b = 2.0f * glm::dot(CO, D);
-    float c = glm::dot(CO, CO) - r * r;
+void Raytracer::IntersectRaySphere(glm::vec3 O, glm::vec3 D, const Sphere& sphere, float& t1, float& t2) {
+    sphere.Intersect(O, D, t1, t2);
+}
 
-    float discriminant = b * b - 4.0f * a * c;
-    if (discriminant < .0f) {
-        t1 = t2 = FLT_MAX;
-        return;
+bool Raytracer::Occluded(glm::vec3 O, glm::vec3 D, float tMin, float tMax) {
+    RayCounters& counters = ThreadRayCounters();
+    counters.rays[RAY_SHADOW]++;
+    if (!sphereBvh.Empty()) {
+        return sphereBvh.AnyHit(spheres, O, D, tMin, tMax);
+    }
+    for (size_t index = 0; index < spheres.size(); index++) {
+        float t1, t2;
+        IntersectRaySphere(O, D, spheres[index], t1, t2);
+        if ((t1 > tMin && t1 < tMax) || (t2 > tMin && t2 < tMax)) {
+            counters.sphereTests += index + 1;
+            return true;
+        }
     }
+    counters.sphereTests += spheres.size();
+    return false;
+}
 
-    t1 = (-b + glm::sqrt(discriminant)) / (2.0f * a);
-    t2 = (-b - glm::sqrt(discriminant)) / (2.0f * a);
+float Raytracer::ComputeLighting(glm::vec3 P, glm::vec3 N, glm::vec3 V, float s, RayContext& context) {
+    ShadingPoint point = {P, N, V, 1.0f / glm::length(V), s};
+    if (s != -1.0f) {
+        return ShadeLights<true, true>(point, context);
+    }
+    return ShadeLights<false, true>(point, context);
 }
 
-float Raytracer::ComputeLighting(glm::vec3 P, glm::vec3 N, glm::vec3 V, float s) {
-    float i = .0f;
-    float tMax;
-    for (auto light : lights) {
-        if (light.type == LightType::Ambient) {
-            i += light.intensity;
-        } else {
-            glm::vec3 L;
-            if (light.type == LightType::Point) {
-                L = light.position - P;
-                tMax = 1.0f;
+// Shades with ambient light plus every light that survives its shadow ray
+template <bool Specular, bool Shadows>
+float Raytracer::ShadeLights(const ShadingPoint& point, RayContext& context) {
+    float i = lightSet.ambient;
+    GatherLights<Specular>(point, context, [&](glm::vec3 L, float tMax, const LightBatch& batch, int k) {
+        if (!Shadows || !Occluded(point.P, L, 0.001f, tMax)) {
+            i += BatchContribution<Specular>(batch, k, point.s);
+        }
+    });
+    return i;
+}
+
+// Each light type goes through its own kernel in batches, then visit(L, tMax, batch, k) is called for
+// every light of the batch that contributes anything, with the shadow ray P + t * L, t in (0.001, tMax)
+// it still has to pass. Point light shadow rays end at the light. Ambient light is left to the caller.
+template <bool Specular, typename Visit>
+void Raytracer::GatherLights(const ShadingPoint& point, RayContext& context, Visit&& visit) {
+    glm::vec3 P = point.P;
+    LightBatch batch;
+
+    auto visitBatch = [&](const LightArrays& batchLights, bool directional) {
+        for (int k = 0; k < batch.count; k++) {
+            if (batch.diffuse[k] <= .0f && batch.specularCosine[k] <= .0f) {
+                continue;
+            }
+            int light = batch.light[k];
+            glm::vec3 L = glm::vec3(batchLights.x[light], batchLights.y[light], batchLights.z[light]);
+            if (directional) {
+                visit(L, FLT_MAX, batch, k);
             } else {
-                L = light.direction;
-                tMax = FLT_MAX;
+                visit(L - P, 1.0f, batch, k);
             }
+        }
+    };
+
+    const LightArrays& directional = lightSet.directional;
+    for (int begin = 0; begin < directional.Count(); begin += LIGHT_BATCH_SIZE) {
+        DirectionalBatch<Specular>(directional, begin, glm::min(LIGHT_BATCH_SIZE, directional.Count() - begin), point, batch);
+        visitBatch(directional, true);
+    }
 
-            // Shadow check
-            float shadowT;
-            std::optional<Sphere> shadowSphere;
-            ClosestIntersection(P, L, 0.001f, tMax, shadowT, shadowSphere);
-            if (shadowSphere) {
+    if (!SampleLights()) {
+        const LightArrays& points = lightSet.point;
+        for (int begin = 0; begin < points.Count(); begin += LIGHT_BATCH_SIZE) {
+            PointBatch<Specular>(points, begin, glm::min(LIGHT_BATCH_SIZE, points.Count() - begin), point, batch);
+            visitBatch(points, false);
+        }
+    } else {
+        // Many point lights: evaluate a fixed number picked by the light tree, weighted by their selection
+        // probability so the estimate stays unbiased. The noise averages out with --accumulate.
+        for (int sample = 0; sample < settings.lightSamples; sample++) {
+            float pdf;
+            int index = lightTree.Sample(P, point.N, RandomFloat(context.rngState), pdf);
+            if (index < 0) {
                 continue;
             }
-
-            // Diffuse
-            float nDotL = glm::dot(N, L);
-            if (nDotL > .0f) {
-                i += light.intensity * nDotL / (glm::length(N) * glm::length(L));
+            const Light& light = lights[index];
+            glm::vec3 L = light.position - P;
+            glm::vec3 direction = L / glm::length(L);
+            PhongTerms<Specular>(point, direction.x, direction.y, direction.z, light.intensity / (pdf * settings.lightSamples), batch, 0);
+            batch.light[0] = index;
+            batch.count = 1;
+            if (batch.diffuse[0] > .0f || batch.specularCosine[0] > .0f) {
+                visit(L, 1.0f, batch, 0);
             }
+        }
+    }
 
-            // Specular
-            if (s != -1.0f) {
-                glm::vec3 R = ReflectRay(L, N);
-                float rDotV = glm::dot(R, V);
-                if (rDotV > .0f) {
-                    i += light.intensity * glm::pow(rDotV / (glm::length(R) * glm::length(V)), s);
-                }
+    // Ranged lights: primary hits only look at their cluster's list, secondary hits at every ranged light,
+    // where the kernel zeroes out of range lights so they never cast a shadow ray
+    const LightArrays& ranged = lightSet.ranged;
+    int count = ranged.Count();
+    const int* clusterLights = nullptr;
+    if (context.clusterTile >= 0) {
+        clusterLights = clusterGrid.Lights(context.clusterTile, P, count);
+    }
+    for (int begin = 0; begin < count; begin += LIGHT_BATCH_SIZE) {
+        RangedBatch<Specular>(ranged, clusterLights, begin, glm::min(LIGHT_BATCH_SIZE, count - begin), point, batch);
+        visitBatch(ranged, false);
+    }
+}
+
+float Raytracer::ComputeLightingReference(glm::vec3 P, glm::vec3 N, glm::vec3 V, float s) {
+    float i = .0f;
+    for (const Light& light : lights) {
+        i += LightContribution(light, P, N, V, s);
+    }
+    return i;
+}
+
+float Raytracer::LightContribution(const Light& light, glm::vec3 P, glm::vec3 N, glm::vec3 V, float s) {
+    if (light.type == LightType::Ambient) {
+        return light.intensity;
+    }
+
+    float i = .0f;
+    glm::vec3 L;
+    float tMax;
+    float attenuation = 1.0f;
+    if (light.type == LightType::Point) {
+        L = light.position - P;
+        tMax = 1.0f;
+        if (light.radius > .0f) {
+            // Smooth window reaching zero at the radius, (1 - (d/r)^4)^2
+            float distanceRatioSquared = glm::dot(L, L) / (light.radius * light.radius);
+            if (distanceRatioSquared >= 1.0f) {
+                return .0f;
             }
+            float window = 1.0f - distanceRatioSquared * distanceRatioSquared;
+            attenuation = window * window;
         }
+    } else {
+        L = light.direction;
+        tMax = FLT_MAX;
     }
-    return i;
+
+    // Shadow check
+    float shadowT;
+    std::optional<Sphere> shadowSphere;
+    ClosestIntersection(P, L, 0.001f, tMax, shadowT, shadowSphere);
+    if (shadowSphere) {
+        return .0f;
+    }
+
+    // Diffuse
+    float nDotL = glm::dot(N, L);
+    if (nDotL > .0f) {
+        i += light.intensity * nDotL / (glm::length(N) * glm::length(L));
+    }
+
+    // Specular
+    if (s != -1.0f) {
+        glm::vec3 R = ReflectRay(L, N);
+        float rDotV = glm::dot(R, V);
+        if (rDotV > .0f) {
+            i += light.intensity * glm::pow(rDotV / (glm::length(R) * glm::length(V)), s);
+        }
+    }
+    return i * attenuation;
 }
 
 glm::vec3 Raytracer::ReflectRay(glm::vec3 R, glm::vec3 N) {
@@ -246,6 +1757,12 @@ glm::vec3 Raytracer::ReflectRay(glm::vec3 R, glm::vec3 N) {
 }
 
 void Raytracer::Destroy() {
+    renderPool.reset();
+    sharedFrames.reset();
+    if (!window) {
+        return;
+    }
+    SDL_DestroyTexture(frameTexture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
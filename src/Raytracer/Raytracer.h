@@ -3,86 +3,261 @@
 
 #include <glm/glm.hpp>
 #include <SDL2/SDL.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <thread>
+#include "../Acceleration/SphereBvh.h"
+#include "../Animation/Animation.h"
+#include "../Camera/Camera.h"
+#include "../Distributed/TileFarm.h"
+#include "../Framebuffer/Framebuffer.h"
+#include "../Framebuffer/ToneMapper.h"
+#include "../Lighting/ClusterGrid.h"
+#include "../Lighting/LightKernels.h"
+#include "../Lighting/LightSet.h"
+#include "../Lighting/LightTree.h"
+#include "../Output/FrameStream.h"
+#include "../Output/ImageWriter.h"
+#include "../Output/SharedFrameRing.h"
+#include "../Progressive/ProgressiveRefiner.h"
+#include "../Sampling/AdaptiveSampler.h"
+#include "../Scaling/DynamicResolution.h"
+#include "../Scaling/Upscaler.h"
+#include "../Scene/Light.h"
+#include "../Scene/Sphere.h"
+#include "../Settings/Settings.h"
+#include "../Statistics/Heatmap.h"
+#include "../Statistics/RayCounters.h"
+#include "../Threading/BoundedQueue.h"
+#include "../Threading/ThreadPool.h"
+#include "../Timing/FramePacer.h"
+#include "../Timing/CacheMissCounter.h"
+#include "../Timing/FrameStats.h"
+#include "../Wavefront/RaySorter.h"
+#include "../Wavefront/Wavefront.h"
+#include "RayContext.h"
 
-const int FPS = 30;
-const int MS_PER_FRAME = 1000 / FPS;
-const SDL_Color BACKGROUND_COLOR = {0, 0, 0, 255};
-const unsigned short RECURSION_DEPTH = 1;
+const glm::vec3 BACKGROUND_COLOR = glm::vec3(0.0f);
+const int TILE_SIZE = 32;
+const int PRESENT_POLL_MS = 1;
+// Longest the render thread sleeps at a time once progressive refinement is done, waiting for the view to move
+const int REFINED_IDLE_MS = 100;
+const double STATS_REPORT_INTERVAL = 1.0;
+const int UPSCALE_ROWS_PER_JOB = 16;
+const int TONEMAP_ROWS_PER_JOB = 16;
+const float CAMERA_SPEED = 2.0f;
+// Radians per second the arrow keys turn the camera, and how far it can look up or down
+const float CAMERA_TURN_SPEED = 1.5f;
+const float CAMERA_MAX_PITCH = 1.5f;
+// Below this many point lights every light is evaluated, above it they are sampled through the light tree
+const int LIGHT_TREE_MIN_LIGHTS = 16;
+const float EXTRA_LIGHT_RANGED_INTENSITY = 0.3f;
+const int LIGHTING_BENCHMARK_PASSES = 5;
+// Frames allowed to size buffers before Render must stop allocating from the heap
+const Uint32 ALLOCATION_WARMUP_FRAMES = 2;
 
-struct Sphere {
-    glm::vec3 center;
-    float radius;
-    SDL_Color color;
-    float specular;
-    float reflective;
-
-    Sphere(){};
-
-    Sphere(glm::vec3 center, float radius, SDL_Color color, float specular = -1, float reflective = .0f) {
-        this->center = center;
-        this->radius = radius;
-        this->color = color;
-        this->specular = specular;
-        this->reflective = reflective;
-    }
-};
-
-enum LightType {
-    Ambient,
-    Point,
-    Directional
-};
-
-struct Light {
-    LightType type;
-    float intensity;
-    glm::vec3 position;
-    glm::vec3 direction;
-    float specular;
-
-    Light() {};
-
-    Light(LightType type, float intensity, glm::vec3 position, glm::vec3 direction) {
-        this->type = type;
-        this->intensity = intensity;
-        this->position = position;
-        this->direction = direction;
-    }
+// Shading features the trace kernels are specialized on
+enum TraceFeatures : unsigned {
+    TRACE_SHADOWS = 1,
+    TRACE_SPECULAR = 2,
+    TRACE_REFLECTIONS = 4,
+    TRACE_FEATURE_COMBINATIONS = 8
 };
 
 class Raytracer {
+    public:
+        using TraceKernel = glm::vec3 (Raytracer::*)(glm::vec3 O, glm::vec3 D, float tMin, float tMax, int maxBounces, RayContext& context);
+
     private:
-        SDL_Window* window;
-        SDL_Renderer* renderer;
-        bool isRunning;
-        int elapsedTime;
+        // Scene of one --animate frame, from its update until it has been traced
+        struct AnimationFrame {
+            int frame = 0;
+            std::vector<Sphere> spheres;
+            SphereBvh sphereBvh;
+            glm::vec3 origin = glm::vec3(0);
+        };
+        // Frames are handed between stages by pointer, nullptr ends the stage
+        using AnimationQueue = BoundedQueue<AnimationFrame*>;
+
+        Settings settings;
+        SDL_Window* window = nullptr;
+        SDL_Renderer* renderer = nullptr;
+        SDL_Texture* frameTexture = nullptr;
+        std::atomic<bool> isRunning{false};
+        FramePacer framePacer;
+        FrameStats frameTimes;
+        FrameStats renderTimes;
+        double timeSinceReport = 0.0;
+        Uint64 primaryRayCount = 0;
+        Uint64 tracedPixelCount = 0;
+        // Pixels and primary rays through TraceFrame since the last report, for samples per pixel
+        Uint64 reportPixels = 0;
+        Uint64 reportSamples = 0;
         std::vector<Sphere> spheres;
+        // Empty for scenes small enough to loop over every sphere
+        SphereBvh sphereBvh;
         std::vector<Light> lights;
+        LightTree lightTree;
+        // Lights split by type for the shading kernels. Unlimited point lights are evaluated directly
+        // or through lightTree, ranged point lights are culled per cluster through clusterGrid.
+        LightSet lightSet;
+        ClusterGrid clusterGrid;
+        // TraceRay instantiation for this frame's features
+        TraceKernel traceKernel = nullptr;
+        Uint32 frameIndex = 0;
+        // Time Setup took to load or generate the scene, and to build its BVH
+        double sceneSetupSeconds = 0.0;
+        double bvhBuildSeconds = 0.0;
+        // Heap allocations made while rendering the last frame, which must be none after this frame
+        Uint64 frameAllocations = 0;
+        Uint32 allocationWarmupEnd = ALLOCATION_WARMUP_FRAMES;
+        // Every thread's ray counts for the last frame
+        RayCounters frameRays;
+        Heatmap heatmap;
+        TripleBuffer frames;
+        // Linear radiance the frame is traced into before tone mapping
+        HdrFramebuffer hdrFrame;
+        // Running sum of frames rendered from the current view, for --accumulate
+        HdrFramebuffer accumulatedFrame;
+        int accumulatedFrames = 0;
+        unsigned accumulatedViewVersion = 0;
+        ToneMapper toneMapper;
+        // Full window sized so resolution changes never reallocate, only the top-left region is used
+        Framebuffer scaledFrame;
+        DynamicResolution dynamicResolution;
+        Upscaler upscaler;
+        ProgressiveRefiner refiner;
+        AdaptiveSampler adaptiveSampler;
+        WavefrontQueues wavefront;
+        WavefrontStats wavefrontStats;
+        RaySorter raySorter;
+        // Opened by --benchmark for the wavefront's traversal stages
+        CacheMissCounter cacheMisses;
+        // Starts out of date so the first frame (re)starts refinement
+        unsigned refinerViewVersion = ~0u;
+
+        // Written by the input thread, copied by the render thread at the start of every frame
+        std::mutex viewMutex;
+        // Signalled when viewVersion changes or the window closes
+        std::condition_variable viewChanged;
+        glm::vec3 cameraPosition = glm::vec3(0);
+        float cameraYaw = 0.0f;
+        float cameraPitch = 0.0f;
+        unsigned viewVersion = 0;
+        std::chrono::steady_clock::time_point lastInputTime;
+
+        // Snapshot of the view the current frame is rendered with, prepared by PrepareView for the
+        // canvas being traced
+        Camera camera;
+        unsigned frameViewVersion = 0;
+        std::unique_ptr<ThreadPool> renderPool;
+        // Set with --coordinator, tiles left over when every worker is lost are traced locally
+        std::unique_ptr<TileCoordinator> tileFarm;
+        std::vector<int> localTiles;
+        bool tracedFarmTilesLocally = false;
+        std::thread renderThread;
+        // Where --animate and --benchmark send finished frames, both optional
+        std::unique_ptr<ImageWriter> imageWriter;
+        std::unique_ptr<FrameStream> frameStream;
+        // Set with --shm, gets every frame the presenter does
+        std::unique_ptr<SharedFrameRing> sharedFrames;
+
+        void RenderLoop();
+        void RenderTimedFrame();
+        void RunBenchmark();
+        void RunLightingBenchmark();
+        void RunAnimation();
+        void UpdateAnimation(const std::vector<Sphere>& restSpheres, glm::vec3 restOrigin, AnimationQueue& freeFrames, AnimationQueue& updatedFrames, double& seconds);
+        bool StartFrameOutput(const std::string& pattern, int fps, int bufferCount);
+        void CaptureFrame(int frame);
+        void FinishFrameOutput();
+        void StartSharedFrames();
+        void PublishFrame();
+        void WriteTrace() const;
+        void WriteScene() const;
+        void StartTileFarm();
+        void RunTileWorker();
+        void PrepareWorkerFrame(const TileRequest& request, HdrFramebuffer& target);
+        Uint64 SceneHash() const;
+        const char* SceneName() const;
+        void ReportFrameStats();
+        void SyncView();
+        void WaitForViewChange();
+        void AddDefaultScene();
+        void GenerateScene();
+        void AddExtraLights(int count);
+        void AddExtraSpheres(int count);
+        void BuildLightStructures();
+        void PrepareLights();
+        TraceKernel SelectTraceKernel() const;
+        bool SampleLights() const;
+        void PrepareView(int width, int height);
+        void ReleaseFrameMemory();
+        void RenderFrame();
+        void AccumulateFrame(int width, int height);
+        void RenderProgressive();
+        Uint32 PixelSeed(int sX, int sY, int width, glm::vec2 offset) const;
+        glm::vec3 TracePixel(int sX, int sY, int width, glm::vec2 offset = glm::vec2(0));
+        glm::vec3 TracePrimary(int sX, int sY, int width, glm::vec3 direction, glm::vec2 offset = glm::vec2(0));
+        glm::vec3 SupersamplePixel(int sX, int sY, int width, int samples);
+        bool AntiAliasing() const;
+        bool ShowHeatmap() const;
+        void TraceFrame(HdrFramebuffer& target, int width, int height);
+        void RenderTile(HdrFramebuffer& target, int width, int height, int tileIndex);
+        void TraceFarmFrame(HdrFramebuffer& target, int width, int height);
+        void TraceWavefront(HdrFramebuffer& target, int width, int height);
+        void WavefrontGenerate(HdrFramebuffer& target, int width, int begin, int count);
+        void WavefrontIntersect(HdrFramebuffer& target);
+        void WavefrontCompact();
+        int WavefrontShade(HdrFramebuffer& target, int bounce);
+        template <bool Specular, bool Shadows>
+        void ShadeWavefrontHits(HdrFramebuffer& target, int begin, int end, int bounce, int job);
+        void WavefrontShadows(HdrFramebuffer& target, int jobs);
+        void WavefrontSortedShadows(HdrFramebuffer& target, int jobs);
+        void WavefrontGather(int jobs);
+        void ToneMapFrame(const HdrFramebuffer& source, int width, int height, Framebuffer& target);
+        void UpscaleFrame(int sourceWidth, int sourceHeight, Framebuffer& target);
+        double FrameBudgetMs() const;
+        void Present();
+        template <bool Specular, bool Shadows>
+        float ShadeLights(const ShadingPoint& point, RayContext& context);
+        template <bool Specular, typename Visit>
+        void GatherLights(const ShadingPoint& point, RayContext& context, Visit&& visit);
 
     public:
         Raytracer() = default;
         ~Raytracer() = default;
-        void Initialize();
+        void Initialize(const Settings& settings);
         void Setup();
         void Run();
         void Destroy();
         void ProcessInput();
         void Update();
         void Render();
-        void PutPixel(int x, int y, SDL_Color color);
-        glm::vec3 CanvasToViewport(int x, int y);
-        SDL_Color TraceRay(glm::vec3 O, glm::vec3 D, float tMin, float tMax, unsigned short recursionDepth);
-        void IntersectRaySphere(glm::vec3 O, glm::vec3 D, Sphere sphere, float& t1, float& t2);
-        float ComputeLighting(glm::vec3 P, glm::vec3 N, glm::vec3 V, float s);
+        // Newest finished frame, for callers rendering headless through Update and Render
+        const Framebuffer& LatestFrame();
+        // Moves the camera the next frame renders from, as the input handling does
+        void SetView(glm::vec3 position, float yaw, float pitch);
+        // Heap allocations the last Render made
+        Uint64 FrameAllocations() const { return frameAllocations; }
+        template <unsigned Features>
+        glm::vec3 TraceRay(glm::vec3 O, glm::vec3 D, float tMin, float tMax, int maxBounces, RayContext& context);
+        void IntersectRaySphere(glm::vec3 O, glm::vec3 D, const Sphere& sphere, float& t1, float& t2);
+        float ComputeLighting(glm::vec3 P, glm::vec3 N, glm::vec3 V, float s, RayContext& context);
+        // Per-light loop over the unsplit light list, kept as the baseline for --bench-lighting
+        float ComputeLightingReference(glm::vec3 P, glm::vec3 N, glm::vec3 V, float s);
+        float LightContribution(const Light& light, glm::vec3 P, glm::vec3 N, glm::vec3 V, float s);
         void ClosestIntersection(glm::vec3 O, glm::vec3 D, float tMin, float tMax, float& closestT, std::optional<Sphere>& closestSphere);
+        int ClosestSphere(glm::vec3 O, glm::vec3 D, float tMin, float tMax, float& closestT);
+        bool Occluded(glm::vec3 O, glm::vec3 D, float tMin, float tMax);
         glm::vec3 ReflectRay(glm::vec3 R, glm::vec3 N);
 
         int windowWidth;
         int windowHeight;
-        int viewportWidth;
-        int viewportHeight;
-        int viewportDepth;
 
 };
 
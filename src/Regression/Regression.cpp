@@ -0,0 +1,184 @@
+#include "Regression.h"
+#include "../Framebuffer/PpmFile.h"
+#include "../Raytracer/Raytracer.h"
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+struct RegressionScene {
+    const char* name;
+    // Median frame time allowed in a release build
+    double budgetMs;
+    void (*configure)(Settings& settings);
+    // Camera of the first frame, it moves and turns back to the default view by the last one
+    glm::vec3 startPosition = glm::vec3(0);
+    float startYaw = 0.0f;
+};
+
+// Each scene exercises a different part of the renderer, so a change that breaks one path shows up
+// on its own line
+static const RegressionScene REGRESSION_SCENES[] = {
+    {"default", 20.0, [](Settings&) {}},
+    {"flat", 20.0, [](Settings& settings) {
+        settings.shadows = false;
+        settings.specular = false;
+        settings.reflections = false;
+    }},
+    {"reflections", 40.0, [](Settings& settings) { settings.recursionDepth = 6; }},
+    {"antialiased", 60.0, [](Settings& settings) { settings.aaMaxSamples = 8; }},
+    {"sampled_lights", 100.0, [](Settings& settings) {
+        settings.extraLights = 200;
+        settings.toneMapOperator = ToneMapOperator::Reinhard;
+    }},
+    {"ranged_lights", 60.0, [](Settings& settings) {
+        settings.extraLights = 200;
+        settings.extraLightRadius = 1.5f;
+        settings.toneMapOperator = ToneMapOperator::Aces;
+    }},
+    // The camera walks in among ranged lights, so more of them reach each cluster every frame,
+    // which must not allocate
+    {"moving_camera", 60.0, [](Settings& settings) {
+        settings.extraLights = 300;
+        settings.extraLightRadius = 2.0f;
+    }, glm::vec3(0, 0, -6), -0.6f},
+    {"accumulated", 100.0, [](Settings& settings) {
+        settings.extraLights = 200;
+        settings.accumulate = true;
+    }},
+    {"spheres", 150.0, [](Settings& settings) {
+        settings.extraSpheres = 2000;
+        settings.recursionDepth = 2;
+    }},
+};
+
+ImageComparison CompareImages(const Framebuffer& expected, const Framebuffer& actual, int tolerance, Framebuffer& diff) {
+    ImageComparison comparison;
+    diff.Resize(expected.width, expected.height);
+    double squaredError = 0.0;
+    for (size_t i = 0; i < expected.pixels.size(); i++) {
+        Uint32 a = expected.pixels[i];
+        Uint32 b = actual.pixels[i];
+        int pixelDifference = 0;
+        for (int shift = 0; shift <= 16; shift += 8) {
+            int difference = std::abs((int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF));
+            squaredError += (double)difference * difference;
+            pixelDifference = glm::max(pixelDifference, difference);
+        }
+        comparison.maxChannelDifference = glm::max(comparison.maxChannelDifference, pixelDifference);
+
+        if (pixelDifference > tolerance) {
+            comparison.changedPixels++;
+            diff.pixels[i] = 0xFFFF0000;
+        } else if (pixelDifference > 0) {
+            diff.pixels[i] = 0xFFFFFF00;
+        } else {
+            Uint32 luma = (((a >> 16) & 0xFF) * 54 + ((a >> 8) & 0xFF) * 183 + (a & 0xFF) * 19) >> 10;
+            diff.pixels[i] = 0xFF000000 | (luma << 16) | (luma << 8) | luma;
+        }
+    }
+
+    double meanSquaredError = squaredError / (3.0 * expected.pixels.size());
+    comparison.psnr = meanSquaredError > 0.0
+        ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError)
+        : std::numeric_limits<double>::infinity();
+    return comparison;
+}
+
+// Renders REGRESSION_FRAMES frames, returning the median render time, the last frame in image and the
+// heap allocations of the frames after the warmup in steadyAllocations
+static double RenderScene(const RegressionScene& scene, const Settings& settings, Framebuffer& image, Uint64& steadyAllocations) {
+    Raytracer raytracer;
+    raytracer.Initialize(settings);
+    raytracer.Setup();
+    FrameStats times(REGRESSION_FRAMES);
+    steadyAllocations = 0;
+    for (int frame = 0; frame < REGRESSION_FRAMES; frame++) {
+        if (scene.startPosition != glm::vec3(0) || scene.startYaw != 0.0f) {
+            float remaining = 1.0f - (float)frame / (REGRESSION_FRAMES - 1);
+            raytracer.SetView(scene.startPosition * remaining, scene.startYaw * remaining, 0.0f);
+        }
+        raytracer.Update();
+        auto renderStart = FramePacer::Now();
+        raytracer.Render();
+        times.AddSample(FramePacer::SecondsSince(renderStart) * 1000.0);
+        if (frame >= (int)ALLOCATION_WARMUP_FRAMES) {
+            steadyAllocations += raytracer.FrameAllocations();
+        }
+    }
+    image = raytracer.LatestFrame();
+    raytracer.Destroy();
+    return times.Percentile(50);
+}
+
+bool RunRegressionSuite(const Settings& settings) {
+    const std::string& directory = settings.regressionDirectory;
+    int failures = 0;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const RegressionScene& scene : REGRESSION_SCENES) {
+        Settings sceneSettings;
+        sceneSettings.headless = true;
+        sceneSettings.windowWidth = REGRESSION_IMAGE_SIZE;
+        sceneSettings.windowHeight = REGRESSION_IMAGE_SIZE;
+        sceneSettings.targetFps = 0;
+        sceneSettings.wavefront = settings.wavefront;
+        sceneSettings.sortRays = settings.sortRays;
+        scene.configure(sceneSettings);
+
+        Framebuffer image;
+        Uint64 steadyAllocations = 0;
+        double frameMs = RenderScene(scene, sceneSettings, image, steadyAllocations);
+        std::string goldenPath = directory + "/" + scene.name + ".ppm";
+        std::cout << "  " << std::left << std::setw(16) << scene.name << std::right;
+
+        if (settings.updateGoldenImages) {
+            bool written = WritePpm(goldenPath, image);
+            failures += !written;
+            std::cout << (written ? "written to " : "FAILED to write ") << goldenPath << std::endl;
+            continue;
+        }
+
+        Framebuffer golden;
+        if (!ReadPpm(goldenPath, golden) || golden.width != image.width || golden.height != image.height) {
+            failures++;
+            std::cout << "FAIL  no " << image.width << "x" << image.height << " golden image at " << goldenPath
+                      << " (create it with --regress-update)" << std::endl;
+            continue;
+        }
+
+        Framebuffer diff;
+        ImageComparison comparison = CompareImages(golden, image, REGRESSION_CHANNEL_TOLERANCE, diff);
+        bool imageMatches = comparison.changedPixels <= REGRESSION_MAX_CHANGED_SHARE * golden.pixels.size() &&
+                            comparison.psnr >= REGRESSION_MIN_PSNR;
+        bool withinBudget = frameMs <= scene.budgetMs;
+        bool allocationFree = steadyAllocations == 0;
+        failures += !imageMatches || !withinBudget || !allocationFree;
+
+        std::cout << (imageMatches && withinBudget && allocationFree ? "ok  " : "FAIL")
+                  << "  PSNR " << std::setw(6) << comparison.psnr << " dB, "
+                  << std::setw(5) << comparison.changedPixels << " changed pixels (max difference "
+                  << comparison.maxChannelDifference << "), "
+                  << std::setw(7) << frameMs << " ms of " << scene.budgetMs << " ms budget";
+        if (!allocationFree) {
+            std::cout << ", " << steadyAllocations << " heap allocations after the warmup";
+        }
+        std::cout << std::endl;
+        if (!imageMatches) {
+            std::string actualPath = directory + "/" + scene.name + ".actual.ppm";
+            std::string diffPath = directory + "/" + scene.name + ".diff.ppm";
+            WritePpm(actualPath, image);
+            WritePpm(diffPath, diff);
+            std::cout << "        wrote " << actualPath << " and " << diffPath << std::endl;
+        }
+    }
+
+    int sceneCount = (int)(sizeof(REGRESSION_SCENES) / sizeof(REGRESSION_SCENES[0]));
+    if (settings.updateGoldenImages) {
+        std::cout << sceneCount - failures << " of " << sceneCount << " golden images written" << std::endl;
+    } else if (failures > 0) {
+        std::cout << failures << " of " << sceneCount << " regression scenes failed" << std::endl;
+    } else {
+        std::cout << "All " << sceneCount << " regression scenes passed" << std::endl;
+    }
+    return failures == 0;
+}
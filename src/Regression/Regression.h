@@ -0,0 +1,34 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include "../Framebuffer/Framebuffer.h"
+#include "../Settings/Settings.h"
+
+const int REGRESSION_IMAGE_SIZE = 160;
+// Frames rendered per scene, the image is the last one and the time the median
+const int REGRESSION_FRAMES = 4;
+// Channel difference (0-255) above which a pixel counts as changed
+const int REGRESSION_CHANNEL_TOLERANCE = 2;
+// Share of changed pixels a scene may have, for edge pixels that flip under different float contraction
+const double REGRESSION_MAX_CHANGED_SHARE = 0.002;
+const double REGRESSION_MIN_PSNR = 45.0;
+
+struct ImageComparison {
+    int maxChannelDifference = 0;
+    int changedPixels = 0;
+    // Peak signal-to-noise ratio over all channels in dB, infinite for identical images
+    double psnr = 0.0;
+};
+
+// Compares two images of the same size. diff shows changed pixels in red and pixels that differ within
+// tolerance in yellow, over a dimmed copy of expected.
+ImageComparison CompareImages(const Framebuffer& expected, const Framebuffer& actual, int tolerance, Framebuffer& diff);
+
+// Renders each reference scene headless and compares it with its golden image in
+// settings.regressionDirectory, or rewrites the golden images with settings.updateGoldenImages.
+// The scenes fix resolution, content and shading features; the tracing path options (--wavefront,
+// --sort-rays) carry over, so every path is checked against the same images. Returns false if any
+// scene differs, misses its time budget or allocates from the heap after its warmup frames.
+bool RunRegressionSuite(const Settings& settings);
+
+#endif
@@ -0,0 +1,120 @@
+#include "AdaptiveSampler.h"
+
+static const int ROWS_PER_JOB = 8;
+// Samples a flagged pixel always gets before its variance is trusted
+static const int MIN_SAMPLES = 4;
+// Stop once the standard error of the pixel's luminance falls below threshold / ERROR_DIVISOR
+static const float ERROR_DIVISOR = 8.0f;
+
+static inline float Luminance(glm::vec3 color) {
+    return 0.299f * color.r + 0.587f * color.g + 0.114f * color.b;
+}
+
+// Radiance clamped to the displayable range and scaled to 0..255, the units the threshold is given in
+static inline glm::vec3 DisplayValue(glm::vec3 radiance) {
+    return glm::clamp(radiance, 0.0f, 1.0f) * 255.0f;
+}
+
+static inline float ContrastBetween(glm::vec4 a, glm::vec4 b) {
+    glm::vec3 difference = glm::abs(DisplayValue(glm::vec3(a)) - DisplayValue(glm::vec3(b)));
+    return glm::max(difference.r, glm::max(difference.g, difference.b));
+}
+
+void AdaptiveSampler::Configure(float threshold, int maxSamples) {
+    this->threshold = threshold;
+    this->maxSamples = maxSamples;
+}
+
+void AdaptiveSampler::Resize(int width, int height) {
+    mask.assign((size_t)width * height, 0);
+    jobSamples.reserve((height + ROWS_PER_JOB - 1) / ROWS_PER_JOB);
+}
+
+// R2 low-discrepancy sequence, shifted so the first sample sits on the pixel's original ray
+glm::vec2 AdaptiveSampler::SampleOffset(int index) {
+    const float a1 = 0.7548776662f;
+    const float a2 = 0.5698402910f;
+    return glm::fract(glm::vec2(0.5f) + (float)index * glm::vec2(a1, a2)) - glm::vec2(0.5f);
+}
+
+bool AdaptiveSampler::NeedsSamples(const HdrFramebuffer& image, int width, int height, int x, int y) const {
+    static const int neighbours[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    glm::vec4 center = image.pixels[(size_t)y * image.width + x];
+    for (const auto& offset : neighbours) {
+        int nX = x + offset[0];
+        int nY = y + offset[1];
+        if (nX < 0 || nY < 0 || nX >= width || nY >= height) {
+            continue;
+        }
+        if (ContrastBetween(center, image.pixels[(size_t)nY * image.width + nX]) > threshold) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Uint64 AdaptiveSampler::RefineRows(HdrFramebuffer& image, int width, int rowBegin, int rowEnd, const SampleFunction& sample) const {
+    Uint64 extraSamples = 0;
+    float maxError = threshold / ERROR_DIVISOR;
+
+    for (int y = rowBegin; y < rowEnd; y++) {
+        for (int x = 0; x < width; x++) {
+            if (!mask[(size_t)y * image.width + x]) {
+                continue;
+            }
+
+            // Welford's running mean / variance over display luminance, radiance averaged alongside
+            glm::vec3 first = image.GetPixel(x, y);
+            glm::vec3 radianceSum = first;
+            float mean = Luminance(DisplayValue(first));
+            float m2 = 0.0f;
+            int n = 1;
+            while (n < maxSamples) {
+                glm::vec3 radiance = sample(x, y, SampleOffset(n));
+                radianceSum += radiance;
+                n++;
+
+                float luminance = Luminance(DisplayValue(radiance));
+                float delta = luminance - mean;
+                mean += delta / n;
+                m2 += delta * (luminance - mean);
+                if (n >= MIN_SAMPLES && glm::sqrt(m2 / ((n - 1) * n)) < maxError) {
+                    break;
+                }
+            }
+            extraSamples += n - 1;
+
+            image.SetPixel(x, y, radianceSum / (float)n);
+        }
+    }
+    return extraSamples;
+}
+
+Uint64 AdaptiveSampler::Refine(ThreadPool& pool, HdrFramebuffer& image, int width, int height, const SampleFunction& sample) {
+    if (maxSamples <= 1) {
+        return 0;
+    }
+
+    // Flag pixels first, so the contrast test only ever sees single-sample neighbours
+    int jobs = (height + ROWS_PER_JOB - 1) / ROWS_PER_JOB;
+    pool.ParallelFor(jobs, [&](int job) {
+        int rowEnd = glm::min((job + 1) * ROWS_PER_JOB, height);
+        for (int y = job * ROWS_PER_JOB; y < rowEnd; y++) {
+            for (int x = 0; x < width; x++) {
+                mask[(size_t)y * image.width + x] = NeedsSamples(image, width, height, x, y);
+            }
+        }
+    });
+
+    jobSamples.resize(jobs);
+    pool.ParallelFor(jobs, [&](int job) {
+        int rowEnd = glm::min((job + 1) * ROWS_PER_JOB, height);
+        jobSamples[job] = RefineRows(image, width, job * ROWS_PER_JOB, rowEnd, sample);
+    });
+
+    Uint64 extraSamples = 0;
+    for (int job = 0; job < jobs; job++) {
+        extraSamples += jobSamples[job];
+    }
+    return extraSamples;
+}
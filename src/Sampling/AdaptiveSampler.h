@@ -0,0 +1,38 @@
+#ifndef ADAPTIVESAMPLER_H
+#define ADAPTIVESAMPLER_H
+
+#include "../Framebuffer/Framebuffer.h"
+#include "../Threading/ThreadPool.h"
+#include <functional>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Anti-aliasing that only spends extra rays where they matter. Pixels whose one-sample color differs from a
+// neighbour by more than the threshold (in 0..255 display units) get more samples, until the running standard error of their mean is
+// small or the sample limit is reached. Flat regions keep their single sample.
+class AdaptiveSampler {
+    public:
+        // Returns the radiance for pixel (x, y) sampled at the given sub-pixel offset
+        using SampleFunction = std::function<glm::vec3(int x, int y, glm::vec2 offset)>;
+
+    private:
+        std::vector<Uint8> mask;
+        std::vector<Uint64> jobSamples;
+        float threshold = 24.0f;
+        int maxSamples = 16;
+
+        bool NeedsSamples(const HdrFramebuffer& image, int width, int height, int x, int y) const;
+        Uint64 RefineRows(HdrFramebuffer& image, int width, int rowBegin, int rowEnd, const SampleFunction& sample) const;
+
+    public:
+        void Configure(float threshold, int maxSamples);
+        void Resize(int width, int height);
+
+        // Refines the top-left width x height region of image in place, returns the number of extra samples taken
+        Uint64 Refine(ThreadPool& pool, HdrFramebuffer& image, int width, int height, const SampleFunction& sample);
+
+        // Offset of the index-th sample within a pixel, in [-0.5, 0.5). Sample 0 is the pixel's primary ray.
+        static glm::vec2 SampleOffset(int index);
+};
+
+#endif
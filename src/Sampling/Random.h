@@ -0,0 +1,19 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <SDL2/SDL.h>
+
+// PCG based hash, good enough to decorrelate neighbouring pixel and frame seeds
+inline Uint32 HashUint(Uint32 value) {
+    Uint32 state = value * 747796405u + 2891336453u;
+    Uint32 word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Advances state and returns a uniform float in [0, 1)
+inline float RandomFloat(Uint32& state) {
+    state = HashUint(state);
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+#endif
@@ -0,0 +1,33 @@
+#include "DynamicResolution.h"
+#include <glm/glm.hpp>
+
+// Aim a little under the budget so upscaling and presentation still fit in the frame
+static const double BUDGET_HEADROOM = 0.85;
+// Fraction of the way to the ideal scale taken each frame, damps oscillation from noisy timings
+static const float SMOOTHING = 0.35f;
+// Changes smaller than this are ignored so the image doesn't shimmer from tiny resolution steps
+static const float DEAD_ZONE = 0.02f;
+
+DynamicResolution::DynamicResolution(float minScale, float maxScale) {
+    SetLimits(minScale, maxScale);
+}
+
+void DynamicResolution::SetLimits(float minScale, float maxScale) {
+    this->minScale = minScale;
+    this->maxScale = maxScale;
+    scale = glm::clamp(scale, minScale, maxScale);
+}
+
+float DynamicResolution::Update(double traceMs, double budgetMs) {
+    if (traceMs <= 0.0 || budgetMs <= 0.0) {
+        return scale;
+    }
+
+    float idealScale = scale * (float)glm::sqrt(budgetMs * BUDGET_HEADROOM / traceMs);
+    idealScale = glm::clamp(idealScale, minScale, maxScale);
+    float nextScale = scale + (idealScale - scale) * SMOOTHING;
+    if (glm::abs(nextScale - scale) >= DEAD_ZONE || idealScale == minScale || idealScale == maxScale) {
+        scale = glm::clamp(nextScale, minScale, maxScale);
+    }
+    return scale;
+}
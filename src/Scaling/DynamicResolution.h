@@ -0,0 +1,21 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+// Picks the internal render scale for the next frame from the measured trace time.
+// Trace cost is roughly proportional to pixel count, so the scale moves with the square root of the time ratio.
+class DynamicResolution {
+    private:
+        float scale = 1.0f;
+        float minScale;
+        float maxScale;
+
+    public:
+        explicit DynamicResolution(float minScale = 0.25f, float maxScale = 1.0f);
+
+        void SetLimits(float minScale, float maxScale);
+        float Scale() const { return scale; }
+        // traceMs was measured at the current scale, returns the scale to use for the next frame
+        float Update(double traceMs, double budgetMs);
+};
+
+#endif
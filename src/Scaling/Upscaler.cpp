@@ -0,0 +1,71 @@
+#include "Upscaler.h"
+#include <glm/glm.hpp>
+
+// How strongly luminance differences (0..255) suppress a tap in the edge-aware filter
+static const float EDGE_SHARPNESS = 0.05f;
+
+static inline float Luminance(Uint32 pixel) {
+    return 0.299f * ((pixel >> 16) & 0xFF) + 0.587f * ((pixel >> 8) & 0xFF) + 0.114f * (pixel & 0xFF);
+}
+
+static inline Uint32 BlendPixels(const Uint32 taps[4], const float weights[4]) {
+    float r = 0.0f, g = 0.0f, b = 0.0f;
+    for (int i = 0; i < 4; i++) {
+        r += weights[i] * ((taps[i] >> 16) & 0xFF);
+        g += weights[i] * ((taps[i] >> 8) & 0xFF);
+        b += weights[i] * (taps[i] & 0xFF);
+    }
+    return 0xFF000000 | ((Uint32)(r + 0.5f) << 16) | ((Uint32)(g + 0.5f) << 8) | (Uint32)(b + 0.5f);
+}
+
+void Upscaler::Prepare(int sourceWidth, int sourceHeight, int targetWidth, int targetHeight) {
+    this->sourceWidth = sourceWidth;
+    this->sourceHeight = sourceHeight;
+    this->targetWidth = targetWidth;
+    this->targetHeight = targetHeight;
+
+    column0.resize(targetWidth);
+    column1.resize(targetWidth);
+    columnWeight.resize(targetWidth);
+    float step = (float)sourceWidth / (float)targetWidth;
+    for (int x = 0; x < targetWidth; x++) {
+        float sourceX = glm::clamp((x + 0.5f) * step - 0.5f, 0.0f, (float)(sourceWidth - 1));
+        column0[x] = (int)sourceX;
+        column1[x] = glm::min(column0[x] + 1, sourceWidth - 1);
+        columnWeight[x] = sourceX - column0[x];
+    }
+}
+
+void Upscaler::UpscaleRows(const Framebuffer& source, Framebuffer& target, int rowBegin, int rowEnd, UpscaleFilter filter) const {
+    float step = (float)sourceHeight / (float)targetHeight;
+    for (int y = rowBegin; y < rowEnd; y++) {
+        float sourceY = glm::clamp((y + 0.5f) * step - 0.5f, 0.0f, (float)(sourceHeight - 1));
+        int row0 = (int)sourceY;
+        int row1 = glm::min(row0 + 1, sourceHeight - 1);
+        float fy = sourceY - row0;
+        const Uint32* sourceRow0 = &source.pixels[(size_t)row0 * source.width];
+        const Uint32* sourceRow1 = &source.pixels[(size_t)row1 * source.width];
+        Uint32* targetRow = &target.pixels[(size_t)y * target.width];
+
+        for (int x = 0; x < targetWidth; x++) {
+            float fx = columnWeight[x];
+            Uint32 taps[4] = {sourceRow0[column0[x]], sourceRow0[column1[x]], sourceRow1[column0[x]], sourceRow1[column1[x]]};
+            float weights[4] = {(1.0f - fx) * (1.0f - fy), fx * (1.0f - fy), (1.0f - fx) * fy, fx * fy};
+
+            if (filter == UpscaleFilter::EdgeAware) {
+                int nearest = (fx < 0.5f ? 0 : 1) + (fy < 0.5f ? 0 : 2);
+                float nearestLuminance = Luminance(taps[nearest]);
+                float total = 0.0f;
+                for (int i = 0; i < 4; i++) {
+                    weights[i] /= 1.0f + EDGE_SHARPNESS * glm::abs(Luminance(taps[i]) - nearestLuminance);
+                    total += weights[i];
+                }
+                for (int i = 0; i < 4; i++) {
+                    weights[i] /= total;
+                }
+            }
+
+            targetRow[x] = BlendPixels(taps, weights);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef UPSCALER_H
+#define UPSCALER_H
+
+#include "../Framebuffer/Framebuffer.h"
+#include <vector>
+
+enum class UpscaleFilter {
+    Bilinear,
+    // Bilinear weights scaled down for taps whose luminance differs from the nearest sample, keeps silhouettes sharp
+    EdgeAware
+};
+
+// Scales the top-left sourceWidth x sourceHeight region of a framebuffer up to the full size of another.
+// The per-column lookup tables are sized once for the target width, so changing the source size never allocates.
+class Upscaler {
+    private:
+        std::vector<int> column0;
+        std::vector<int> column1;
+        std::vector<float> columnWeight;
+        int sourceWidth = 0;
+        int sourceHeight = 0;
+        int targetWidth = 0;
+        int targetHeight = 0;
+
+    public:
+        void Prepare(int sourceWidth, int sourceHeight, int targetWidth, int targetHeight);
+        // Writes target rows [rowBegin, rowEnd), safe to call concurrently for disjoint row ranges
+        void UpscaleRows(const Framebuffer& source, Framebuffer& target, int rowBegin, int rowEnd, UpscaleFilter filter) const;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include <glm/glm.hpp>
+
+enum LightType {
+    Ambient,
+    Point,
+    Directional
+};
+
+struct Light {
+    LightType type;
+    float intensity;
+    glm::vec3 position;
+    glm::vec3 direction;
+    float specular;
+    // Point lights only: distance at which the light has faded out completely, 0 for unlimited range
+    float radius;
+
+    Light() {};
+
+    Light(LightType type, float intensity, glm::vec3 position, glm::vec3 direction, float radius = .0f) {
+        this->type = type;
+        this->intensity = intensity;
+        this->position = position;
+        this->direction = direction;
+        this->radius = radius;
+    }
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SPHERE_H
+#define SPHERE_H
+
+#include "../Framebuffer/ToneMapper.h"
+#include <SDL2/SDL.h>
+#include <cfloat>
+#include <glm/glm.hpp>
+
+struct Sphere {
+    glm::vec3 center;
+    float radius;
+    // Linear reflectance, decoded from the sRGB color the sphere is defined with
+    glm::vec3 albedo;
+    float specular;
+    float reflective;
+
+    Sphere(){};
+
+    Sphere(glm::vec3 center, float radius, SDL_Color color, float specular = -1, float reflective = .0f) {
+        this->center = center;
+        this->radius = radius;
+        this->albedo = glm::vec3(
+            ToneMapper::SrgbToLinear(color.r / 255.0f),
+            ToneMapper::SrgbToLinear(color.g / 255.0f),
+            ToneMapper::SrgbToLinear(color.b / 255.0f));
+        this->specular = specular;
+        this->reflective = reflective;
+    }
+
+    // Distances along O + tD at which the ray enters and leaves the sphere, FLT_MAX for both on a miss
+    void Intersect(glm::vec3 O, glm::vec3 D, float& t1, float& t2) const {
+        glm::vec3 CO = O - center;
+
+        float a = glm::dot(D, D);
+        float b = 2.0f * glm::dot(CO, D);
+        float c = glm::dot(CO, CO) - radius * radius;
+
+        float discriminant = b * b - 4.0f * a * c;
+        if (discriminant < .0f) {
+            t1 = t2 = FLT_MAX;
+            return;
+        }
+
+        t1 = (-b + glm::sqrt(discriminant)) / (2.0f * a);
+        t2 = (-b - glm::sqrt(discriminant)) / (2.0f * a);
+    }
+};
+
+#endif
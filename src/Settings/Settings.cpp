@@ -0,0 +1,291 @@
+#include "Settings.h"
+#include "../Output/ImageFile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static void PrintUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl
+              << "  --size WxH          Window / render resolution (default 640x640)" << std::endl
+              << "  --fps N             Target frame rate, 0 for unlimited (default " << FPS << ")" << std::endl
+              << "  --unlimited         Render as fast as possible, same as --fps 0" << std::endl
+              << "  --benchmark N       Render N frames headless as fast as possible and print frame time statistics" << std::endl
+              << "  --dynamic-resolution [MIN]" << std::endl
+              << "                      Scale the render resolution down to MIN (default 0.25) to hold the frame budget" << std::endl
+              << "  --upscale FILTER    Upscaling filter for dynamic resolution: bilinear or edge (default edge)" << std::endl
+              << "  --progressive       Refine the image coarse-to-fine (8x8 blocks down to pixels) within the frame budget" << std::endl
+              << "  --aa N              Adaptive anti-aliasing with up to N samples on high-contrast pixels" << std::endl
+              << "  --aa-threshold T    Neighbour color difference (0-255) that triggers extra samples (default 24)" << std::endl
+              << "  --ssaa N            Uniform supersampling with N samples on every pixel, for comparison" << std::endl
+              << "  --tonemap OP        HDR to display mapping: clamp, reinhard or aces (default clamp)" << std::endl
+              << "  --exposure E        Linear exposure multiplier applied before tone mapping (default 1)" << std::endl
+              << "  --light-samples N   Point lights sampled per shading point through the light tree when there are" << std::endl
+              << "                      many of them, 0 evaluates every light (default 4)" << std::endl
+              << "  --extra-lights N    Add N dim point lights to the scene" << std::endl
+              << "  --light-radius R    Give the extra lights a falloff radius R, culled per screen tile and depth slice" << std::endl
+              << "  --extra-spheres N   Scatter N small spheres over the scene" << std::endl
+              << "  --scene NAME        Generated scene instead of the default one: uniform, clustered, nested or" << std::endl
+              << "                      degenerate (overlapping, coincident, huge and tiny spheres)" << std::endl
+              << "  --scene-spheres N   Spheres of the generated scene, up to " << PROCEDURAL_MAX_SPHERES << " (default " << PROCEDURAL_SPHERES << ")" << std::endl
+              << "  --scene-lights N    Point lights of the generated scene (default " << PROCEDURAL_LIGHTS << ")" << std::endl
+              << "  --scene-seed N      Seed of the generated scene (default 1)" << std::endl
+              << "  --load-scene FILE   Load spheres and lights from a scene file written by --write-scene" << std::endl
+              << "  --write-scene FILE  Write the scene's spheres and lights to FILE and exit" << std::endl
+              << "  --fov DEGREES       Vertical field of view, " << CAMERA_MIN_FOV << ".." << CAMERA_MAX_FOV << " (default " << CAMERA_FOV << ")" << std::endl
+              << "  --accumulate        Average frames while the view is still" << std::endl
+              << "  --depth N           Reflection bounces, 0.." << MAX_RECURSION_DEPTH << " (default " << RECURSION_DEPTH << ")" << std::endl
+              << "  --no-shadows        Skip shadow rays" << std::endl
+              << "  --no-specular       Diffuse shading only" << std::endl
+              << "  --no-reflections    Skip reflection rays" << std::endl
+              << "  --wavefront         Trace frames stage by stage over ray batches (not with --progressive or --ssaa)" << std::endl
+              << "  --sort-rays         Sort wavefront secondary rays by direction octant and origin Morton code" << std::endl
+              << "  --heatmap [MAX]     Show per-pixel sphere tests plus BVH nodes in false color, red at MAX" << std::endl
+              << "                      (default 256), traced tile by tile (not with --progressive)" << std::endl
+              << "  --bench-lighting N  Time the light kernels against the per-light loop on N shading points and exit" << std::endl
+              << "  --regress DIR       Render the reference scenes headless, compare them with the golden images in DIR" << std::endl
+              << "                      and check their frame times against the scene budgets, then exit" << std::endl
+              << "  --regress-update    With --regress, rewrite the golden images instead of checking them" << std::endl
+              << "  --coordinator ADDR  Trace frame tiles on worker processes connecting to ADDR (host:port, port or" << std::endl
+              << "                      unix:/path), tile path only. Tiles of lost workers are traced locally." << std::endl
+              << "  --farm-workers N    Workers the coordinator waits for before the first frame (default 1)" << std::endl
+              << "  --worker ADDR       Trace tiles for the coordinator at ADDR, started with the same scene options" << std::endl
+              << "  --animate FIRST:LAST" << std::endl
+              << "                      Render frames FIRST to LAST of the built-in animation headless and exit, with" << std::endl
+              << "                      the next frame's scene update and the last frame's file write overlapping tracing" << std::endl
+              << "                      (not with --progressive, --dynamic-resolution or --coordinator)" << std::endl
+              << "  --animation-fps N   Animation frames per second of scene time (default " << ANIMATION_FPS << ")" << std::endl
+              << "  --output PATTERN    Save animation or benchmark frames on background threads, the first run of #" << std::endl
+              << "                      becomes the zero padded frame number and the extension picks ppm, png, or" << std::endl
+              << "                      linear pfm or exr (animation default " << ANIMATION_OUTPUT << ")" << std::endl
+              << "  --stream TARGET     Stream animation or benchmark frames as raw video to TARGET: - for stdout (log" << std::endl
+              << "                      messages go to stderr), a named pipe or a file" << std::endl
+              << "  --stream-format F   y4m (4:2:0, read by ffmpeg -i) or rgba (ffmpeg -f rawvideo -pix_fmt rgba)" << std::endl
+              << "                      (default y4m)" << std::endl
+              << "  --shm NAME          Publish every finished frame to the shared memory segment /NAME, a ring of" << std::endl
+              << "                      frames other processes read in place (see examples/ShmReader.cpp)" << std::endl
+              << "  --shm-slots N       Frames in the shared memory ring, 2.." << SHARED_RING_MAX_SLOTS << " (default " << SHARED_RING_SLOTS << ")" << std::endl
+              << "  --frames-in-flight N" << std::endl
+              << "                      Animation frames being updated, traced or written at once, 1.." << ANIMATION_MAX_FRAMES_IN_FLIGHT
+              << " (default " << ANIMATION_FRAMES_IN_FLIGHT << ")" << std::endl
+              << "  --trace FILE        Write profiled zones as Chrome trace JSON on exit (make profile builds)" << std::endl;
+}
+
+static bool ParseFloat(const char* text, float& value) {
+    char* end;
+    float parsed = std::strtof(text, &end);
+    if (end == text || *end != '\0') {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+static bool ParseInt(const char* text, int& value) {
+    char* end;
+    long parsed = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0') {
+        return false;
+    }
+    value = (int)parsed;
+    return true;
+}
+
+bool ParseSettings(int argc, char const* argv[], Settings& settings) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+
+        if (std::strcmp(arg, "--size") == 0 && value) {
+            ok = std::sscanf(value, "%dx%d", &settings.windowWidth, &settings.windowHeight) == 2 &&
+                 settings.windowWidth > 0 && settings.windowHeight > 0;
+            i++;
+        } else if (std::strcmp(arg, "--fps") == 0 && value) {
+            ok = ParseInt(value, settings.targetFps) && settings.targetFps >= 0;
+            i++;
+        } else if (std::strcmp(arg, "--unlimited") == 0) {
+            settings.targetFps = 0;
+        } else if (std::strcmp(arg, "--benchmark") == 0 && value) {
+            ok = ParseInt(value, settings.benchmarkFrames) && settings.benchmarkFrames > 0;
+            i++;
+        } else if (std::strcmp(arg, "--dynamic-resolution") == 0) {
+            settings.dynamicResolution = true;
+            if (value && value[0] != '-') {
+                ok = ParseFloat(value, settings.minRenderScale) && settings.minRenderScale > 0.0f && settings.minRenderScale <= 1.0f;
+                i++;
+            }
+        } else if (std::strcmp(arg, "--progressive") == 0) {
+            settings.progressive = true;
+        } else if (std::strcmp(arg, "--aa") == 0 && value) {
+            ok = ParseInt(value, settings.aaMaxSamples) && settings.aaMaxSamples >= 1;
+            i++;
+        } else if (std::strcmp(arg, "--aa-threshold") == 0 && value) {
+            ok = ParseFloat(value, settings.aaThreshold) && settings.aaThreshold >= 0.0f;
+            i++;
+        } else if (std::strcmp(arg, "--ssaa") == 0 && value) {
+            ok = ParseInt(value, settings.ssaaSamples) && settings.ssaaSamples >= 1;
+            i++;
+        } else if (std::strcmp(arg, "--tonemap") == 0 && value) {
+            if (std::strcmp(value, "clamp") == 0) {
+                settings.toneMapOperator = ToneMapOperator::Clamp;
+            } else if (std::strcmp(value, "reinhard") == 0) {
+                settings.toneMapOperator = ToneMapOperator::Reinhard;
+            } else if (std::strcmp(value, "aces") == 0) {
+                settings.toneMapOperator = ToneMapOperator::Aces;
+            } else {
+                ok = false;
+            }
+            i++;
+        } else if (std::strcmp(arg, "--exposure") == 0 && value) {
+            ok = ParseFloat(value, settings.exposure) && settings.exposure > 0.0f;
+            i++;
+        } else if (std::strcmp(arg, "--light-samples") == 0 && value) {
+            ok = ParseInt(value, settings.lightSamples) && settings.lightSamples >= 0;
+            i++;
+        } else if (std::strcmp(arg, "--extra-lights") == 0 && value) {
+            ok = ParseInt(value, settings.extraLights) && settings.extraLights >= 0;
+            i++;
+        } else if (std::strcmp(arg, "--light-radius") == 0 && value) {
+            ok = ParseFloat(value, settings.extraLightRadius) && settings.extraLightRadius >= 0.0f;
+            i++;
+        } else if (std::strcmp(arg, "--extra-spheres") == 0 && value) {
+            ok = ParseInt(value, settings.extraSpheres) && settings.extraSpheres >= 0;
+            i++;
+        } else if (std::strcmp(arg, "--scene") == 0 && value) {
+            ok = ParseSceneDistribution(value, settings.sceneDistribution);
+            i++;
+        } else if (std::strcmp(arg, "--scene-spheres") == 0 && value) {
+            ok = ParseInt(value, settings.sceneSpheres) && settings.sceneSpheres >= 0 && settings.sceneSpheres <= PROCEDURAL_MAX_SPHERES;
+            i++;
+        } else if (std::strcmp(arg, "--scene-lights") == 0 && value) {
+            ok = ParseInt(value, settings.sceneLights) && settings.sceneLights >= 0;
+            i++;
+        } else if (std::strcmp(arg, "--scene-seed") == 0 && value) {
+            int seed = 0;
+            ok = ParseInt(value, seed);
+            settings.sceneSeed = (unsigned)seed;
+            i++;
+        } else if (std::strcmp(arg, "--load-scene") == 0 && value) {
+            settings.sceneFile = value;
+            i++;
+        } else if (std::strcmp(arg, "--write-scene") == 0 && value) {
+            settings.sceneOutputFile = value;
+            i++;
+        } else if (std::strcmp(arg, "--fov") == 0 && value) {
+            ok = ParseFloat(value, settings.fov) && settings.fov >= CAMERA_MIN_FOV && settings.fov <= CAMERA_MAX_FOV;
+            i++;
+        } else if (std::strcmp(arg, "--accumulate") == 0) {
+            settings.accumulate = true;
+        } else if (std::strcmp(arg, "--depth") == 0 && value) {
+            ok = ParseInt(value, settings.recursionDepth) && settings.recursionDepth >= 0 && settings.recursionDepth <= MAX_RECURSION_DEPTH;
+            i++;
+        } else if (std::strcmp(arg, "--no-shadows") == 0) {
+            settings.shadows = false;
+        } else if (std::strcmp(arg, "--no-specular") == 0) {
+            settings.specular = false;
+        } else if (std::strcmp(arg, "--no-reflections") == 0) {
+            settings.reflections = false;
+        } else if (std::strcmp(arg, "--wavefront") == 0) {
+            settings.wavefront = true;
+        } else if (std::strcmp(arg, "--sort-rays") == 0) {
+            settings.sortRays = true;
+        } else if (std::strcmp(arg, "--heatmap") == 0) {
+            settings.heatmapMaxCost = HEATMAP_MAX_COST;
+            if (value && value[0] != '-') {
+                ok = ParseInt(value, settings.heatmapMaxCost) && settings.heatmapMaxCost > 0;
+                i++;
+            }
+        } else if (std::strcmp(arg, "--bench-lighting") == 0 && value) {
+            ok = ParseInt(value, settings.lightingBenchmarkPoints) && settings.lightingBenchmarkPoints > 0;
+            i++;
+        } else if (std::strcmp(arg, "--regress") == 0 && value) {
+            settings.regressionDirectory = value;
+            i++;
+        } else if (std::strcmp(arg, "--regress-update") == 0) {
+            settings.updateGoldenImages = true;
+        } else if (std::strcmp(arg, "--coordinator") == 0 && value) {
+            settings.coordinatorAddress = value;
+            i++;
+        } else if (std::strcmp(arg, "--farm-workers") == 0 && value) {
+            ok = ParseInt(value, settings.farmWorkers) && settings.farmWorkers >= 0;
+            i++;
+        } else if (std::strcmp(arg, "--worker") == 0 && value) {
+            settings.workerAddress = value;
+            i++;
+        } else if (std::strcmp(arg, "--animate") == 0 && value) {
+            ok = std::sscanf(value, "%d:%d", &settings.animationFirst, &settings.animationLast) == 2 &&
+                 settings.animationFirst >= 0 && settings.animationLast >= settings.animationFirst;
+            i++;
+        } else if (std::strcmp(arg, "--animation-fps") == 0 && value) {
+            ok = ParseInt(value, settings.animationFps) && settings.animationFps > 0;
+            i++;
+        } else if (std::strcmp(arg, "--output") == 0 && value) {
+            ImageFormat format;
+            settings.outputPattern = value;
+            ok = settings.outputPattern.find('#') != std::string::npos && ImageFormatFromPath(settings.outputPattern, format);
+            i++;
+        } else if (std::strcmp(arg, "--stream") == 0 && value) {
+            settings.streamTarget = value;
+            i++;
+        } else if (std::strcmp(arg, "--stream-format") == 0 && value) {
+            ok = ParseStreamFormat(value, settings.streamFormat);
+            i++;
+        } else if (std::strcmp(arg, "--shm") == 0 && value) {
+            settings.sharedMemoryName = value;
+            // One path component, with or without the leading slash
+            ok = settings.sharedMemoryName.find_first_not_of('/') != std::string::npos && settings.sharedMemoryName.find('/', 1) == std::string::npos;
+            i++;
+        } else if (std::strcmp(arg, "--shm-slots") == 0 && value) {
+            ok = ParseInt(value, settings.sharedMemorySlots) && settings.sharedMemorySlots >= 2 && settings.sharedMemorySlots <= SHARED_RING_MAX_SLOTS;
+            i++;
+        } else if (std::strcmp(arg, "--frames-in-flight") == 0 && value) {
+            ok = ParseInt(value, settings.framesInFlight) && settings.framesInFlight >= 1 && settings.framesInFlight <= ANIMATION_MAX_FRAMES_IN_FLIGHT;
+            i++;
+        } else if (std::strcmp(arg, "--trace") == 0 && value) {
+            settings.traceFile = value;
+            i++;
+        } else if (std::strcmp(arg, "--upscale") == 0 && value) {
+            if (std::strcmp(value, "bilinear") == 0) {
+                settings.upscaleFilter = UpscaleFilter::Bilinear;
+            } else if (std::strcmp(value, "edge") == 0) {
+                settings.upscaleFilter = UpscaleFilter::EdgeAware;
+            } else {
+                ok = false;
+            }
+            i++;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cout << "Invalid argument: " << arg << std::endl;
+            PrintUsage(argv[0]);
+            return false;
+        }
+    }
+    if (settings.updateGoldenImages && settings.regressionDirectory.empty()) {
+        std::cout << "--regress-update needs --regress DIR" << std::endl;
+        PrintUsage(argv[0]);
+        return false;
+    }
+    // Animation frames are traced in full from a scene only this process has
+    if (settings.Animating() && (settings.progressive || settings.dynamicResolution || !settings.coordinatorAddress.empty())) {
+        std::cout << "--animate can't be combined with --progressive, --dynamic-resolution or --coordinator" << std::endl;
+        PrintUsage(argv[0]);
+        return false;
+    }
+    if (!settings.streamTarget.empty() && !settings.Animating() && settings.benchmarkFrames == 0) {
+        std::cout << "--stream needs --animate or --benchmark" << std::endl;
+        PrintUsage(argv[0]);
+        return false;
+    }
+    // Linear output is the traced radiance, which those two replace by their own images
+    ImageFormat format;
+    if (ImageFormatFromPath(settings.outputPattern, format) && IsHdrFormat(format) && (settings.progressive || settings.dynamicResolution)) {
+        std::cout << "pfm and exr output can't be combined with --progressive or --dynamic-resolution" << std::endl;
+        PrintUsage(argv[0]);
+        return false;
+    }
+    return true;
+}
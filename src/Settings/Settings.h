@@ -0,0 +1,113 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include "../Animation/Animation.h"
+#include "../Camera/Camera.h"
+#include "../Framebuffer/ToneMapper.h"
+#include "../Output/FrameStream.h"
+#include "../Output/SharedFrameRing.h"
+#include "../Procedural/ProceduralScene.h"
+#include "../Scaling/Upscaler.h"
+#include <string>
+
+const int FPS = 30;
+const int MS_PER_FRAME = 1000 / FPS;
+const int RECURSION_DEPTH = 1;
+// Bounces are traced iteratively, so the limit only guards against runaway settings
+const int MAX_RECURSION_DEPTH = 64;
+const int HEATMAP_MAX_COST = 256;
+
+struct Settings {
+    int windowWidth = 640;
+    int windowHeight = 640;
+    // 0 renders as fast as possible
+    int targetFps = FPS;
+    // Frames to render headless before exiting, 0 opens the interactive window
+    int benchmarkFrames = 0;
+    // Adapt the internal render resolution each frame to stay within the frame budget
+    bool dynamicResolution = false;
+    float minRenderScale = 0.25f;
+    UpscaleFilter upscaleFilter = UpscaleFilter::EdgeAware;
+    // Refine coarse-to-fine within the frame budget instead of tracing every pixel each frame
+    bool progressive = false;
+    // Adaptive anti-aliasing: up to aaMaxSamples rays for pixels whose neighbours differ by more than aaThreshold (0..255)
+    int aaMaxSamples = 1;
+    float aaThreshold = 24.0f;
+    // Uniform supersampling with this many rays per pixel, for comparing against adaptive sampling
+    int ssaaSamples = 1;
+    ToneMapOperator toneMapOperator = ToneMapOperator::Clamp;
+    float exposure = 1.0f;
+    // Point lights evaluated per shading point once there are too many to loop over, 0 always evaluates all
+    int lightSamples = 4;
+    // Extra dim point lights scattered over the default scene, for many-light testing
+    int extraLights = 0;
+    // Falloff radius of the extra lights, 0 for unlimited range. Ranged lights are culled per screen cluster.
+    float extraLightRadius = 0.0f;
+    // Extra small spheres scattered over the default scene, intersected through a BVH
+    int extraSpheres = 0;
+    // Generated stress scene replacing the default one, with its sphere and light counts and seed
+    SceneDistribution sceneDistribution = SceneDistribution::Default;
+    int sceneSpheres = PROCEDURAL_SPHERES;
+    int sceneLights = PROCEDURAL_LIGHTS;
+    unsigned sceneSeed = 1;
+    // Scene file loaded instead of building a scene, empty for none
+    std::string sceneFile;
+    // Write the scene to this file after setting it up, then exit
+    std::string sceneOutputFile;
+    // Vertical field of view of the camera in degrees, the horizontal one follows from the window's aspect ratio
+    float fov = CAMERA_FOV;
+    // Average frames while the view is still, which converges sampled lighting (fixed resolution only)
+    bool accumulate = false;
+    // Reflection bounces, and shading features where each combination runs its own compiled trace kernel
+    int recursionDepth = RECURSION_DEPTH;
+    bool shadows = true;
+    bool specular = true;
+    bool reflections = true;
+    // Trace full frames as a wavefront of ray batches moving through separate stages, instead of per pixel
+    bool wavefront = false;
+    // Reorder secondary rays by direction and origin before intersecting them (wavefront only)
+    bool sortRays = false;
+    // Show per-pixel traversal cost in false color instead of the image, red at this cost, 0 for the image
+    int heatmapMaxCost = 0;
+    // Shading points for the headless lighting micro-benchmark, 0 disables it
+    int lightingBenchmarkPoints = 0;
+    // Directory of golden images to check the reference scenes against, empty to run normally
+    std::string regressionDirectory;
+    // Render the reference scenes into regressionDirectory instead of checking them
+    bool updateGoldenImages = false;
+    // Tile farm: serve frame tiles to worker processes on this address, waiting for farmWorkers of them
+    // before the first frame, or trace tiles for the coordinator at this address
+    std::string coordinatorAddress;
+    int farmWorkers = 1;
+    std::string workerAddress;
+    // Render frames animationFirst..animationLast of the built-in animation headless into files, with
+    // update, tracing and writing of consecutive frames overlapped and at most framesInFlight frames
+    // between them. animationFirst is -1 to run normally.
+    int animationFirst = -1;
+    int animationLast = -1;
+    int animationFps = ANIMATION_FPS;
+    int framesInFlight = ANIMATION_FRAMES_IN_FLIGHT;
+    // Files the animation or benchmark frames are saved to in the background, the first run of # becomes
+    // the frame number and the extension picks the format. Empty saves benchmark frames nowhere and
+    // animation frames to ANIMATION_OUTPUT.
+    std::string outputPattern;
+    // Raw video of the animation or benchmark frames, to "-" for stdout or to a named pipe or file
+    std::string streamTarget;
+    StreamFormat streamFormat = StreamFormat::Y4m;
+    // POSIX shared memory segment every finished frame is published to for other local processes,
+    // as a ring of sharedMemorySlots frames. Empty for none.
+    std::string sharedMemoryName;
+    int sharedMemorySlots = SHARED_RING_SLOTS;
+    // Never open a window, for programs that only call into the renderer (the benchmark suite)
+    bool headless = false;
+    // Chrome trace of the profiled zones written on exit, empty for none (needs a make profile build)
+    std::string traceFile;
+
+    bool Headless() const { return headless || benchmarkFrames > 0 || lightingBenchmarkPoints > 0 || !sceneOutputFile.empty() || !workerAddress.empty() || Animating(); }
+    bool Animating() const { return animationFirst >= 0; }
+};
+
+// Fills settings from the command line, returns false (after printing usage) on bad input
+bool ParseSettings(int argc, char const* argv[], Settings& settings);
+
+#endif
@@ -0,0 +1,46 @@
+#include "Heatmap.h"
+#include <algorithm>
+
+// Evenly spaced stops of the false color ramp
+static const glm::vec3 HEATMAP_STOPS[] = {
+    glm::vec3(0.0f, 0.0f, 0.3f),
+    glm::vec3(0.0f, 0.3f, 1.0f),
+    glm::vec3(0.0f, 0.9f, 0.9f),
+    glm::vec3(0.1f, 0.9f, 0.1f),
+    glm::vec3(1.0f, 0.9f, 0.0f),
+    glm::vec3(1.0f, 0.0f, 0.0f)
+};
+static const int HEATMAP_STOP_COUNT = sizeof(HEATMAP_STOPS) / sizeof(HEATMAP_STOPS[0]);
+
+void Heatmap::Configure(int maxCost) {
+    this->maxCost = std::max(maxCost, 1);
+}
+
+void Heatmap::Resize(int width, int height) {
+    this->width = width;
+    cost.assign((size_t)width * height, 0);
+}
+
+void Heatmap::ClearRows(int width, int rowBegin, int rowEnd) {
+    for (int y = rowBegin; y < rowEnd; y++) {
+        std::fill_n(&cost[(size_t)y * this->width], width, 0u);
+    }
+}
+
+void Heatmap::MapRows(Framebuffer& target, int width, int rowBegin, int rowEnd) const {
+    for (int y = rowBegin; y < rowEnd; y++) {
+        const Uint32* rowCost = &cost[(size_t)y * this->width];
+        Uint32* row = &target.pixels[(size_t)y * target.width];
+        for (int x = 0; x < width; x++) {
+            row[x] = Color((float)rowCost[x] / (float)maxCost);
+        }
+    }
+}
+
+// Heat in [0, 1] along the ramp, clamped outside it
+Uint32 Heatmap::Color(float heat) {
+    float position = glm::clamp(heat, 0.0f, 1.0f) * (HEATMAP_STOP_COUNT - 1);
+    int stop = std::min((int)position, HEATMAP_STOP_COUNT - 2);
+    glm::vec3 color = glm::mix(HEATMAP_STOPS[stop], HEATMAP_STOPS[stop + 1], position - (float)stop);
+    return 0xFF000000 | ((Uint32)(color.r * 255.0f + 0.5f) << 16) | ((Uint32)(color.g * 255.0f + 0.5f) << 8) | (Uint32)(color.b * 255.0f + 0.5f);
+}
@@ -0,0 +1,30 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include "../Framebuffer/Framebuffer.h"
+#include <vector>
+
+// Debug view of where tracing is expensive: the traversal cost of every pixel (sphere tests plus BVH
+// nodes, over all of its rays) shown in false color, from dark blue for nothing through green to
+// red at maxCost and above.
+class Heatmap {
+    private:
+        int width = 0;
+        int maxCost = 256;
+        // Cost per pixel, in rows of the width given to Resize
+        std::vector<Uint32> cost;
+
+    public:
+        void Configure(int maxCost);
+        void Resize(int width, int height);
+        // Only the tracing job that owns pixel (x, y) adds to it
+        void AddCost(int x, int y, Uint64 amount) { cost[(size_t)y * width + x] += (Uint32)amount; }
+        // Zeroes the first width pixels of rows [rowBegin, rowEnd)
+        void ClearRows(int width, int rowBegin, int rowEnd);
+        // Colors the first width pixels of rows [rowBegin, rowEnd), safe to call concurrently for disjoint rows
+        void MapRows(Framebuffer& target, int width, int rowBegin, int rowEnd) const;
+
+        static Uint32 Color(float heat);
+};
+
+#endif
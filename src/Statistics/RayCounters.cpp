@@ -0,0 +1,33 @@
+#include "RayCounters.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Counters belong to the registry rather than to their thread, so collecting never reads a destroyed one
+static std::mutex countersMutex;
+static std::vector<std::unique_ptr<RayCounters>> counters;
+
+void RayCounters::Add(const RayCounters& other) {
+    for (int kind = 0; kind < RAY_KIND_COUNT; kind++) {
+        rays[kind] += other.rays[kind];
+    }
+    sphereTests += other.sphereTests;
+    nodeVisits += other.nodeVisits;
+    maxBounce = maxBounce > other.maxBounce ? maxBounce : other.maxBounce;
+}
+
+RayCounters* RegisterThreadRayCounters() {
+    std::lock_guard<std::mutex> lock(countersMutex);
+    counters.push_back(std::make_unique<RayCounters>());
+    return counters.back().get();
+}
+
+RayCounters CollectRayCounters() {
+    std::lock_guard<std::mutex> lock(countersMutex);
+    RayCounters total;
+    for (auto& threadCounters : counters) {
+        total.Add(*threadCounters);
+        threadCounters->Clear();
+    }
+    return total;
+}
@@ -0,0 +1,46 @@
+#ifndef RAYCOUNTERS_H
+#define RAYCOUNTERS_H
+
+#include <SDL2/SDL.h>
+
+enum RayKind {
+    RAY_PRIMARY,
+    RAY_REFLECTION,
+    RAY_SHADOW,
+    RAY_KIND_COUNT
+};
+
+// Work done tracing, counted by each thread into its own RayCounters and summed once per frame,
+// so counting is a plain increment with no atomics or shared cache lines.
+struct RayCounters {
+    Uint64 rays[RAY_KIND_COUNT] = {};
+    // Ray-sphere tests and BVH node bounds tested, over every kind of ray
+    Uint64 sphereTests = 0;
+    Uint64 nodeVisits = 0;
+    // Deepest reflection bounce reached
+    int maxBounce = 0;
+
+    Uint64 RayCount() const { return rays[RAY_PRIMARY] + rays[RAY_REFLECTION] + rays[RAY_SHADOW]; }
+    // Traversal work, the quantity the heatmap shows
+    Uint64 Cost() const { return sphereTests + nodeVisits; }
+    void Add(const RayCounters& other);
+    void Clear() { *this = RayCounters(); }
+};
+
+RayCounters* RegisterThreadRayCounters();
+
+// The calling thread's counters, registered on its first call. Only the owning thread writes them.
+// Inline with a constant initialized thread_local, so the hot path is a TLS load and a null check.
+inline RayCounters& ThreadRayCounters() {
+    static thread_local RayCounters* counters = nullptr;
+    if (!counters) {
+        counters = RegisterThreadRayCounters();
+    }
+    return *counters;
+}
+
+// Sums and clears every thread's counters. Only call while no other thread is tracing, such as
+// between frames, when the thread pool's handoff has made the workers' counts visible.
+RayCounters CollectRayCounters();
+
+#endif
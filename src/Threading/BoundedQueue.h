@@ -0,0 +1,46 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Fixed capacity FIFO between pipeline stages on different threads. Push blocks while the queue is
+// full and Pop while it is empty, so a fast producer is held back instead of queueing without bound.
+// The ring is sized once by the constructor, passing items never allocates.
+template <typename T>
+class BoundedQueue {
+    private:
+        std::vector<T> items;
+        int head = 0;
+        int count = 0;
+        std::mutex mutex;
+        std::condition_variable notFull;
+        std::condition_variable notEmpty;
+
+    public:
+        explicit BoundedQueue(int capacity) : items(capacity) {}
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        void Push(T item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this] { return count < (int)items.size(); });
+            items[(head + count) % items.size()] = std::move(item);
+            count++;
+            notEmpty.notify_one();
+        }
+
+        T Pop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this] { return count > 0; });
+            T item = std::move(items[head]);
+            head = (head + 1) % (int)items.size();
+            count--;
+            notFull.notify_one();
+            return item;
+        }
+};
+
+#endif
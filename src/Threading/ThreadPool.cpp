@@ -0,0 +1,86 @@
+#include "ThreadPool.h"
+#include "../Profiling/Profiler.h"
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+    for (unsigned i = 1; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::ThreadCount() const {
+    return (unsigned)workers.size() + 1;
+}
+
+void ThreadPool::Run(int count, JobFunction function, const void* job) {
+    if (count <= 0) {
+        return;
+    }
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++) {
+            function(job, i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobFunction = function;
+        this->job = job;
+        jobCount = count;
+        nextIndex.store(0, std::memory_order_relaxed);
+        busyWorkers = (int)workers.size();
+        generation++;
+    }
+    jobAvailable.notify_all();
+
+    RunJobItems();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    jobFinished.wait(lock, [this] { return busyWorkers == 0; });
+    jobFunction = nullptr;
+    this->job = nullptr;
+}
+
+void ThreadPool::RunJobItems() {
+    int i;
+    while ((i = nextIndex.fetch_add(1, std::memory_order_relaxed)) < jobCount) {
+        jobFunction(job, i);
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    PROFILE_THREAD_NAME("worker");
+    unsigned seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        RunJobItems();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busyWorkers--;
+        }
+        jobFinished.notify_one();
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+    private:
+        using JobFunction = void (*)(const void* job, int i);
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable jobAvailable;
+        std::condition_variable jobFinished;
+        JobFunction jobFunction = nullptr;
+        const void* job = nullptr;
+        std::atomic<int> nextIndex{0};
+        int jobCount = 0;
+        int busyWorkers = 0;
+        unsigned generation = 0;
+        bool stopping = false;
+
+        void WorkerLoop();
+        void RunJobItems();
+        void Run(int count, JobFunction function, const void* job);
+
+        template <typename Job>
+        static void Invoke(const void* job, int i) {
+            (*static_cast<const Job*>(job))(i);
+        }
+
+    public:
+        // threadCount includes the calling thread, which always helps out in ParallelFor
+        explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency());
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Calls job(i) for every i in [0, count) and blocks until all calls have returned. The job is
+        // referenced rather than copied into a std::function, which would allocate for larger lambdas.
+        template <typename Job>
+        void ParallelFor(int count, const Job& job) {
+            Run(count, &ThreadPool::Invoke<Job>, &job);
+        }
+        unsigned ThreadCount() const;
+};
+
+#endif
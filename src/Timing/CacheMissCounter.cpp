@@ -0,0 +1,84 @@
+#include "CacheMissCounter.h"
+#include <cstring>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstdlib>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+CacheMissCounter::~CacheMissCounter() {
+    Close();
+}
+
+bool CacheMissCounter::Open() {
+    Close();
+#ifdef __linux__
+    DIR* tasks = opendir("/proc/self/task");
+    if (!tasks) {
+        error = "cannot list threads";
+        return false;
+    }
+
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+
+    while (dirent* entry = readdir(tasks)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        pid_t thread = (pid_t)std::atoi(entry->d_name);
+        int descriptor = (int)syscall(SYS_perf_event_open, &attributes, thread, -1, -1, 0);
+        if (descriptor < 0) {
+            error = std::string("perf_event_open: ") + std::strerror(errno);
+            closedir(tasks);
+            Close();
+            return false;
+        }
+        descriptors.push_back(descriptor);
+    }
+    closedir(tasks);
+    return !descriptors.empty();
+#else
+    error = "hardware counters are only read on Linux";
+    return false;
+#endif
+}
+
+void CacheMissCounter::Close() {
+#ifdef __linux__
+    for (int descriptor : descriptors) {
+        close(descriptor);
+    }
+#endif
+    descriptors.clear();
+}
+
+Uint64 CacheMissCounter::Read() const {
+    Uint64 total = 0;
+#ifdef __linux__
+    for (int descriptor : descriptors) {
+        Uint64 value = 0;
+        if (read(descriptor, &value, sizeof(value)) == sizeof(value)) {
+            total += value;
+        }
+    }
+#endif
+    return total;
+}
+
+void CacheMissCounter::Start() {
+    startValue = Read();
+}
+
+Uint64 CacheMissCounter::Stop() {
+    return Available() ? Read() - startValue : 0;
+}
@@ -0,0 +1,36 @@
+#ifndef CACHEMISSCOUNTER_H
+#define CACHEMISSCOUNTER_H
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+
+// Hardware cache-miss counter over every thread of the process, through perf_event_open on Linux.
+// Where counters are unavailable (other platforms, containers, VMs without a PMU) Open fails with a
+// reason and Start/Stop do nothing, so callers can measure unconditionally.
+class CacheMissCounter {
+    private:
+        std::vector<int> descriptors;
+        std::string error;
+        Uint64 startValue = 0;
+
+        Uint64 Read() const;
+
+    public:
+        CacheMissCounter() = default;
+        ~CacheMissCounter();
+        CacheMissCounter(const CacheMissCounter&) = delete;
+        CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+        // Opens a counter on each thread that currently exists, so call it once worker threads are running
+        bool Open();
+        void Close();
+        bool Available() const { return !descriptors.empty(); }
+        const std::string& Error() const { return error; }
+
+        void Start();
+        // Misses since Start, 0 when unavailable
+        Uint64 Stop();
+};
+
+#endif
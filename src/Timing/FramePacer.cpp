@@ -0,0 +1,47 @@
+#include "FramePacer.h"
+#include <thread>
+
+static const std::chrono::microseconds SPIN_THRESHOLD(1500);
+
+FramePacer::FramePacer(int targetFps) {
+    SetTargetFps(targetFps);
+    Reset();
+}
+
+void FramePacer::SetTargetFps(int targetFps) {
+    unlimited = targetFps <= 0;
+    period = unlimited ? Clock::duration::zero() : std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+}
+
+void FramePacer::Reset() {
+    lastFrame = Clock::now();
+    nextDeadline = lastFrame + period;
+}
+
+double FramePacer::WaitForNextFrame() {
+    if (!unlimited) {
+        Clock::time_point now = Clock::now();
+        if (nextDeadline - now > SPIN_THRESHOLD) {
+            std::this_thread::sleep_until(nextDeadline - SPIN_THRESHOLD);
+        }
+        while (Clock::now() < nextDeadline) {
+            std::this_thread::yield();
+        }
+
+        // Schedule against the ideal timeline, but don't try to catch up after a long frame
+        nextDeadline += period;
+        now = Clock::now();
+        if (nextDeadline < now) {
+            nextDeadline = now + period;
+        }
+    }
+
+    Clock::time_point now = Clock::now();
+    double deltaTime = std::chrono::duration<double>(now - lastFrame).count();
+    lastFrame = now;
+    return deltaTime;
+}
+
+double FramePacer::SecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
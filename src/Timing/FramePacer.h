@@ -0,0 +1,30 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <chrono>
+
+// Paces frames against a monotonic clock. Sleeps for the bulk of the wait and
+// spins for the last stretch, since OS sleeps overshoot by a millisecond or more.
+class FramePacer {
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        Clock::time_point lastFrame;
+        Clock::time_point nextDeadline;
+        Clock::duration period;
+        bool unlimited;
+
+    public:
+        explicit FramePacer(int targetFps = 0);
+
+        // 0 means unlimited: frames are never delayed
+        void SetTargetFps(int targetFps);
+        void Reset();
+        // Blocks until the next frame slot is due and returns the seconds elapsed since the previous call
+        double WaitForNextFrame();
+        // Seconds elapsed since the given point, for timing work inside a frame
+        static double SecondsSince(Clock::time_point start);
+        static Clock::time_point Now() { return Clock::now(); }
+};
+
+#endif
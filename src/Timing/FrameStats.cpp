@@ -0,0 +1,41 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <cmath>
+
+FrameStats::FrameStats(size_t capacity) {
+    samples.resize(capacity);
+    scratch.reserve(capacity);
+}
+
+void FrameStats::AddSample(double milliseconds) {
+    samples[nextSample] = milliseconds;
+    nextSample = (nextSample + 1) % samples.size();
+    sampleCount = std::min(sampleCount + 1, samples.size());
+}
+
+void FrameStats::Clear() {
+    nextSample = 0;
+    sampleCount = 0;
+}
+
+double FrameStats::Average() const {
+    if (sampleCount == 0) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (size_t i = 0; i < sampleCount; i++) {
+        sum += samples[i];
+    }
+    return sum / sampleCount;
+}
+
+double FrameStats::Percentile(double p) {
+    if (sampleCount == 0) {
+        return 0.0;
+    }
+    scratch.assign(samples.begin(), samples.begin() + sampleCount);
+    size_t rank = (size_t)std::ceil(p / 100.0 * sampleCount);
+    size_t index = std::min(rank > 0 ? rank - 1 : 0, sampleCount - 1);
+    std::nth_element(scratch.begin(), scratch.begin() + index, scratch.end());
+    return scratch[index];
+}
@@ -0,0 +1,26 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <cstddef>
+#include <vector>
+
+// Rolling window of frame times in milliseconds
+class FrameStats {
+    private:
+        std::vector<double> samples;
+        std::vector<double> scratch;
+        size_t nextSample = 0;
+        size_t sampleCount = 0;
+
+    public:
+        explicit FrameStats(size_t capacity = 256);
+
+        void AddSample(double milliseconds);
+        void Clear();
+        size_t Count() const { return sampleCount; }
+        double Average() const;
+        // Nearest-rank percentile over the current window, p in [0, 100]
+        double Percentile(double p);
+};
+
+#endif
@@ -0,0 +1,63 @@
+#include "RaySorter.h"
+#include <algorithm>
+
+// Inserts two zero bits between each of the low 10 bits
+Uint32 RaySorter::SpreadBits(Uint32 value) {
+    value &= 0x3ff;
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+// Stable LSD radix sort of keys, carrying order along. Each pass counts buckets per job, and a prefix
+// sum over buckets, then jobs, gives every job the offsets it scatters its keys to in parallel.
+void RaySorter::RadixSort(ThreadPool& pool, int keyBits) {
+    const int bucketCount = 1 << RAY_SORT_RADIX_BITS;
+    const Uint64 mask = bucketCount - 1;
+    int count = (int)keys.size();
+    int jobs = (count + RAY_SORT_JOB_SIZE - 1) / RAY_SORT_JOB_SIZE;
+    scratchKeys.resize(count);
+    scratchOrder.resize(count);
+    jobOffsets.resize(jobs * bucketCount);
+
+    for (int shift = 0; shift < keyBits; shift += RAY_SORT_RADIX_BITS) {
+        pool.ParallelFor(jobs, [&](int job) {
+            int* offsets = &jobOffsets[job * bucketCount];
+            std::fill(offsets, offsets + bucketCount, 0);
+            int end = glm::min((job + 1) * RAY_SORT_JOB_SIZE, count);
+            for (int i = job * RAY_SORT_JOB_SIZE; i < end; i++) {
+                offsets[(keys[i] >> shift) & mask]++;
+            }
+        });
+        int sum = 0;
+        for (int bucket = 0; bucket < bucketCount; bucket++) {
+            for (int job = 0; job < jobs; job++) {
+                int bucketSize = jobOffsets[job * bucketCount + bucket];
+                jobOffsets[job * bucketCount + bucket] = sum;
+                sum += bucketSize;
+            }
+        }
+        pool.ParallelFor(jobs, [&](int job) {
+            int* offsets = &jobOffsets[job * bucketCount];
+            int end = glm::min((job + 1) * RAY_SORT_JOB_SIZE, count);
+            for (int i = job * RAY_SORT_JOB_SIZE; i < end; i++) {
+                int target = offsets[(keys[i] >> shift) & mask]++;
+                scratchKeys[target] = keys[i];
+                scratchOrder[target] = order[i];
+            }
+        });
+        keys.swap(scratchKeys);
+        order.swap(scratchOrder);
+    }
+}
+
+void RaySorter::ReleaseFrameMemory() {
+    ReleaseFrameVector(keys);
+    ReleaseFrameVector(scratchKeys);
+    ReleaseFrameVector(order);
+    ReleaseFrameVector(scratchOrder);
+    ReleaseFrameVector(jobBounds);
+    ReleaseFrameVector(jobOffsets);
+}
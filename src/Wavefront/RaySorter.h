@@ -0,0 +1,83 @@
+#ifndef RAYSORTER_H
+#define RAYSORTER_H
+
+#include <glm/glm.hpp>
+#include <SDL2/SDL.h>
+#include <cfloat>
+#include <vector>
+#include "../Memory/FrameArena.h"
+#include "../Threading/ThreadPool.h"
+
+// Bits per axis of the origin Morton code, on top of which sit the 3 direction octant bits
+const int RAY_SORT_MORTON_BITS = 10;
+const int RAY_SORT_RADIX_BITS = 11;
+// Rays handed to one thread pool job, each with its own histogram per radix pass
+const int RAY_SORT_JOB_SIZE = 8192;
+
+// Orders rays by direction octant, then by the Morton code of their origin within the bounds of all
+// origins, so rays that start close together and head the same way are intersected back to back
+// and traverse the same BVH nodes while they are still in cache. Keys and permutations live in
+// frame memory. Every pass runs on the thread pool over blocks of RAY_SORT_JOB_SIZE rays.
+class RaySorter {
+    private:
+        FrameVector<Uint64> keys;
+        FrameVector<Uint64> scratchKeys;
+        FrameVector<int> order;
+        FrameVector<int> scratchOrder;
+        // Origin bounds of each job's rays, then each job's bucket offsets within a radix pass
+        FrameVector<glm::vec3> jobBounds;
+        FrameVector<int> jobOffsets;
+
+        static Uint32 SpreadBits(Uint32 value);
+        void RadixSort(ThreadPool& pool, int keyBits);
+
+    public:
+        // Permutation of rays[0, count) in sorted order. Ray needs origin and direction members.
+        template <typename Ray>
+        const FrameVector<int>& Sort(ThreadPool& pool, const Ray* rays, int count);
+        // Drops the sort buffers, before the frame arenas are reset
+        void ReleaseFrameMemory();
+};
+
+template <typename Ray>
+const FrameVector<int>& RaySorter::Sort(ThreadPool& pool, const Ray* rays, int count) {
+    int jobs = (count + RAY_SORT_JOB_SIZE - 1) / RAY_SORT_JOB_SIZE;
+    jobBounds.resize(2 * jobs);
+    pool.ParallelFor(jobs, [&](int job) {
+        glm::vec3 jobMin = glm::vec3(FLT_MAX);
+        glm::vec3 jobMax = glm::vec3(-FLT_MAX);
+        int end = glm::min((job + 1) * RAY_SORT_JOB_SIZE, count);
+        for (int i = job * RAY_SORT_JOB_SIZE; i < end; i++) {
+            jobMin = glm::min(jobMin, rays[i].origin);
+            jobMax = glm::max(jobMax, rays[i].origin);
+        }
+        jobBounds[2 * job] = jobMin;
+        jobBounds[2 * job + 1] = jobMax;
+    });
+    glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+    glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+    for (int job = 0; job < jobs; job++) {
+        boundsMin = glm::min(boundsMin, jobBounds[2 * job]);
+        boundsMax = glm::max(boundsMax, jobBounds[2 * job + 1]);
+    }
+    const float cells = (float)((1 << RAY_SORT_MORTON_BITS) - 1);
+    glm::vec3 scale = cells / glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+
+    keys.resize(count);
+    order.resize(count);
+    pool.ParallelFor(jobs, [&](int job) {
+        int end = glm::min((job + 1) * RAY_SORT_JOB_SIZE, count);
+        for (int i = job * RAY_SORT_JOB_SIZE; i < end; i++) {
+            glm::vec3 cell = (rays[i].origin - boundsMin) * scale;
+            Uint64 morton = SpreadBits((Uint32)cell.x) | (SpreadBits((Uint32)cell.y) << 1) | (SpreadBits((Uint32)cell.z) << 2);
+            glm::vec3 direction = rays[i].direction;
+            Uint64 octant = (direction.x < 0.0f ? 1 : 0) | (direction.y < 0.0f ? 2 : 0) | (direction.z < 0.0f ? 4 : 0);
+            keys[i] = (octant << (3 * RAY_SORT_MORTON_BITS)) | morton;
+            order[i] = i;
+        }
+    });
+    RadixSort(pool, 3 * RAY_SORT_MORTON_BITS + 3);
+    return order;
+}
+
+#endif
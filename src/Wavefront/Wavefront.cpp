@@ -0,0 +1,85 @@
+#include "Wavefront.h"
+#include <iomanip>
+#include <iostream>
+
+static const char* STAGE_NAMES[WAVEFRONT_STAGE_COUNT] = {"generate", "intersect", "compact", "gather", "sort", "shade", "shadow"};
+
+void WavefrontQueues::Reserve() {
+    rays.reserve(WAVEFRONT_BATCH_SIZE);
+    hitSpheres.reserve(WAVEFRONT_BATCH_SIZE);
+    hitDistances.reserve(WAVEFRONT_BATCH_SIZE);
+    hits.reserve(WAVEFRONT_BATCH_SIZE);
+    sortedRays.reserve(WAVEFRONT_BATCH_SIZE);
+    // Each material's hits round up to whole jobs, so a batch never has more shading jobs than this
+    int maxJobs = WAVEFRONT_BATCH_SIZE / WAVEFRONT_JOB_SIZE + WAVEFRONT_MATERIAL_COUNT;
+    jobShadowRays.reserve(maxJobs);
+    jobReflectionRays.reserve(maxJobs);
+    jobHitBegin.reserve((WAVEFRONT_BATCH_SIZE / WAVEFRONT_JOB_SIZE) * WAVEFRONT_MATERIAL_COUNT);
+    jobRayBegin.reserve(maxJobs + 1);
+}
+
+void WavefrontQueues::PrepareJobs(int jobs) {
+    if ((int)jobShadowRays.size() < jobs) {
+        jobShadowRays.resize(jobs);
+        jobReflectionRays.resize(jobs);
+    }
+    for (int job = 0; job < jobs; job++) {
+        jobShadowRays[job].clear();
+        jobReflectionRays[job].clear();
+    }
+}
+
+void WavefrontQueues::ReleaseFrameMemory() {
+    for (size_t job = 0; job < jobShadowRays.size(); job++) {
+        ReleaseFrameVector(jobShadowRays[job]);
+        ReleaseFrameVector(jobReflectionRays[job]);
+    }
+    ReleaseFrameVector(shadowRays);
+    ReleaseFrameVector(jobShadowBegin);
+    ReleaseFrameVector(shadowVisible);
+}
+
+void WavefrontStats::Add(WavefrontStage stage, double seconds, Uint64 items) {
+    stageSeconds[stage] += seconds;
+    stageItems[stage] += items;
+}
+
+void WavefrontStats::AddMisses(WavefrontStage stage, Uint64 misses) {
+    stageMisses[stage] += misses;
+    missesCounted = true;
+}
+
+void WavefrontStats::Clear() {
+    for (int stage = 0; stage < WAVEFRONT_STAGE_COUNT; stage++) {
+        stageSeconds[stage] = 0.0;
+        stageItems[stage] = 0;
+        stageMisses[stage] = 0;
+    }
+    missesCounted = false;
+}
+
+void WavefrontStats::Print(int frames) const {
+    double totalSeconds = 0.0;
+    for (int stage = 0; stage < WAVEFRONT_STAGE_COUNT; stage++) {
+        totalSeconds += stageSeconds[stage];
+    }
+    if (frames <= 0 || totalSeconds <= 0.0) {
+        return;
+    }
+
+    std::cout << std::fixed << std::setprecision(2) << "  wavefront stages, ms per frame:" << std::endl;
+    for (int stage = 0; stage < WAVEFRONT_STAGE_COUNT; stage++) {
+        double seconds = stageSeconds[stage];
+        std::cout << "    " << std::left << std::setw(10) << STAGE_NAMES[stage] << std::right
+                  << std::setw(8) << seconds * 1000.0 / frames
+                  << std::setw(7) << 100.0 * seconds / totalSeconds << "%  "
+                  << std::setw(10) << stageItems[stage] / frames << " items";
+        if (seconds > 0.0) {
+            std::cout << "  " << std::setw(7) << stageItems[stage] / seconds / 1e6 << " M/s";
+        }
+        if (missesCounted && stageMisses[stage] > 0 && stageItems[stage] > 0) {
+            std::cout << "  " << std::setw(6) << (double)stageMisses[stage] / stageItems[stage] << " cache misses/item";
+        }
+        std::cout << std::endl;
+    }
+}
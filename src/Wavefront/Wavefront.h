@@ -0,0 +1,107 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <glm/glm.hpp>
+#include <SDL2/SDL.h>
+#include <vector>
+#include "../Memory/FrameArena.h"
+
+// Paths are traced in batches of this many pixels, each stage running in parallel over the batch
+const int WAVEFRONT_BATCH_SIZE = 1 << 16;
+// Items handed to one thread pool job within a stage
+const int WAVEFRONT_JOB_SIZE = 1024;
+
+struct WavefrontRay {
+    glm::vec3 origin;
+    float tMin;
+    glm::vec3 direction;
+    // Share of this path segment's radiance that reaches the pixel, the product of reflectivities so far
+    float throughput;
+    // Index into the target framebuffer
+    int pixel;
+    int clusterTile;
+    Uint32 rngState;
+};
+
+struct WavefrontHit {
+    int ray;
+    int sphere;
+    float t;
+};
+
+// Adds radiance to pixel unless something lies between origin and origin + tMax * direction
+struct ShadowRay {
+    glm::vec3 origin;
+    float tMax;
+    glm::vec3 direction;
+    int pixel;
+    glm::vec3 radiance;
+};
+
+// Hits are shaded grouped by material so each shading job runs a single kernel
+enum WavefrontMaterial {
+    WAVEFRONT_DIFFUSE,
+    WAVEFRONT_PHONG,
+    WAVEFRONT_MATERIAL_COUNT
+};
+
+enum WavefrontStage {
+    WAVEFRONT_GENERATE,
+    WAVEFRONT_INTERSECT,
+    WAVEFRONT_COMPACT,
+    WAVEFRONT_GATHER,
+    WAVEFRONT_SORT,
+    WAVEFRONT_SHADE,
+    WAVEFRONT_SHADOW,
+    WAVEFRONT_STAGE_COUNT
+};
+
+// Buffers reused across batches and frames, so the pipeline stops allocating once warmed up. The
+// queues whose length depends on the scene live in frame memory and are released every frame.
+struct WavefrontQueues {
+    std::vector<WavefrontRay> rays;
+    // Closest sphere and distance per ray, sphere -1 for a miss
+    std::vector<int> hitSpheres;
+    std::vector<float> hitDistances;
+    // Hits grouped by material, those of material m start at materialBegin[m]
+    std::vector<WavefrontHit> hits;
+    int materialBegin[WAVEFRONT_MATERIAL_COUNT + 1] = {};
+    // Output of each shading job, so jobs never share a queue
+    std::vector<FrameVector<ShadowRay>> jobShadowRays;
+    std::vector<FrameVector<WavefrontRay>> jobReflectionRays;
+    // Where each job of the compact stage writes the hits of each material, job j's for material m at
+    // j * WAVEFRONT_MATERIAL_COUNT + m, and where each shading job's reflection rays go in the next batch
+    std::vector<int> jobHitBegin;
+    std::vector<int> jobRayBegin;
+
+    // Scratch for ray sorting: all jobs' shadow rays in one array, jobShadowBegin[j] indexing those of
+    // job j, with their visibility, and the reflection rays in sorted order
+    FrameVector<ShadowRay> shadowRays;
+    FrameVector<int> jobShadowBegin;
+    FrameVector<unsigned char> shadowVisible;
+    std::vector<WavefrontRay> sortedRays;
+
+    // Sizes the per-batch buffers for a full batch up front
+    void Reserve();
+    void PrepareJobs(int jobs);
+    // Drops every queue held in frame memory, before the frame arenas are reset
+    void ReleaseFrameMemory();
+};
+
+// Time and items processed per stage, summed over frames
+class WavefrontStats {
+    private:
+        double stageSeconds[WAVEFRONT_STAGE_COUNT] = {};
+        Uint64 stageItems[WAVEFRONT_STAGE_COUNT] = {};
+        // Hardware cache misses, where they were counted
+        Uint64 stageMisses[WAVEFRONT_STAGE_COUNT] = {};
+        bool missesCounted = false;
+
+    public:
+        void Add(WavefrontStage stage, double seconds, Uint64 items);
+        void AddMisses(WavefrontStage stage, Uint64 misses);
+        void Clear();
+        void Print(int frames) const;
+};
+
+#endif
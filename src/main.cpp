@@ -1,10 +1,26 @@
 #include "Raytracer/Raytracer.h"
+#include "Regression/Regression.h"
+#include <iostream>
 
 int main(int argc, char const *argv[])
 {
+    Settings settings;
+    if (!ParseSettings(argc, argv, settings)) {
+        return 1;
+    }
+
+    // Video on stdout leaves the log messages to stderr
+    if (settings.streamTarget == "-") {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    if (!settings.regressionDirectory.empty()) {
+        return RunRegressionSuite(settings) ? 0 : 1;
+    }
+
     Raytracer raytracer;
 
-    raytracer.Initialize();
+    raytracer.Initialize(settings);
     raytracer.Run();
     raytracer.Destroy();
 